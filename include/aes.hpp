@@ -0,0 +1,253 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes.hpp
+ *
+ * Description:
+ *   Header-only C++20 interface to the cipher. Aes<KeyBits> fixes the key
+ *   size, and with it the round count and schedule length, at compile time;
+ *   the mode and direction are template arguments as well, so a call
+ *   resolves to a single C entry point with constant arguments and no
+ *   branching of its own.
+ *
+ * Details:
+ *   - Contexts are move-only and wipe their key schedule when destroyed or
+ *     moved from.
+ *   - Bulk methods take std::span and never allocate: they work in place,
+ *     or copy into the caller's output buffer once and work there.
+ *   - caes::tables regenerates the lookup tables of aes_tables.c from the
+ *     field arithmetic in constexpr functions, so they can be used in
+ *     constant expressions.
+ *   - Everything goes through aes_mode(), so the C++ path picks up the
+ *     interleave setting, the bulk path and the metrics exactly as the
+ *     command-line tool does.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_HPP
+#define AES_HPP
+
+#if __cplusplus < 202002L
+#error "aes.hpp requires C++20 (std::span)"
+#endif
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "aes_modes.h"
+
+namespace caes {
+
+/* --------------------------------------------------------------------------
+ * Compile-time Tables
+ * -------------------------------------------------------------------------- */
+
+namespace tables {
+
+/**
+ * @brief Multiply by x in GF(2^8) modulo the AES polynomial.
+ */
+constexpr uint8_t xtime(uint8_t a) {
+    return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1B : 0x00));
+}
+
+/**
+ * @brief Powers of the generator 0x03; exp[255] wraps back to 1 as in AES_E.
+ */
+constexpr std::array<uint8_t, 256> make_exp() {
+    std::array<uint8_t, 256> e{};
+    e[0] = 0x01;
+    for (int i = 1; i < 256; i++)
+        e[i] = (uint8_t)(e[i - 1] ^ xtime(e[i - 1]));
+    return e;
+}
+
+/**
+ * @brief Discrete logarithms base 0x03; log[0] is 0 as in AES_L.
+ */
+constexpr std::array<uint8_t, 256> make_log() {
+    std::array<uint8_t, 256> e = make_exp();
+    std::array<uint8_t, 256> l{};
+    for (int i = 0; i < 255; i++)
+        l[e[i]] = (uint8_t)i;
+    return l;
+}
+
+/**
+ * @brief S-box: multiplicative inverse followed by the affine transform.
+ */
+constexpr std::array<uint8_t, 256> make_sbox() {
+    std::array<uint8_t, 256> e = make_exp();
+    std::array<uint8_t, 256> l = make_log();
+    std::array<uint8_t, 256> s{};
+    for (int x = 0; x < 256; x++) {
+        uint8_t inv = x ? e[255 - l[x]] : 0;
+        uint8_t y = inv;
+        for (int r = 1; r < 5; r++)
+            y ^= (uint8_t)((inv << r) | (inv >> (8 - r)));
+        s[x] = (uint8_t)(y ^ 0x63);
+    }
+    return s;
+}
+
+constexpr std::array<uint8_t, 256> make_inv_sbox() {
+    std::array<uint8_t, 256> s = make_sbox();
+    std::array<uint8_t, 256> inv{};
+    for (int x = 0; x < 256; x++)
+        inv[s[x]] = (uint8_t)x;
+    return inv;
+}
+
+/**
+ * @brief Round constants x^(i-1), stored in the top byte as in AES_RCON.
+ */
+constexpr std::array<uint32_t, 15> make_rcon() {
+    std::array<uint32_t, 15> r{};
+    uint8_t c = 0x01;
+    for (int i = 0; i < 15; i++) {
+        r[i] = (uint32_t)c << 24;
+        c = xtime(c);
+    }
+    return r;
+}
+
+/**
+ * @brief MixColumns matrix: each row is the first rotated right by its index.
+ */
+constexpr std::array<std::array<uint8_t, 4>, 4> make_mix(std::array<uint8_t, 4> first) {
+    std::array<std::array<uint8_t, 4>, 4> m{};
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            m[row][col] = first[(col - row + 4) % 4];
+    return m;
+}
+
+inline constexpr std::array<uint8_t, 256> exp = make_exp();
+inline constexpr std::array<uint8_t, 256> log = make_log();
+inline constexpr std::array<uint8_t, 256> sbox = make_sbox();
+inline constexpr std::array<uint8_t, 256> inv_sbox = make_inv_sbox();
+inline constexpr std::array<uint32_t, 15> rcon = make_rcon();
+inline constexpr std::array<std::array<uint8_t, 4>, 4> mul_e = make_mix({ 0x02, 0x03, 0x01, 0x01 });
+inline constexpr std::array<std::array<uint8_t, 4>, 4> mul_d = make_mix({ 0x0E, 0x0B, 0x0D, 0x09 });
+
+} // namespace tables
+
+/* --------------------------------------------------------------------------
+ * Cipher Context
+ * -------------------------------------------------------------------------- */
+
+template <Op_mode Mode>
+inline constexpr bool needs_iv = Mode != ECB;
+
+template <Op_mode Mode>
+inline constexpr bool whole_blocks = Mode == ECB || Mode == CBC;
+
+template <int KeyBits>
+class Aes {
+    static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256,
+            "AES keys are 128, 192 or 256 bits");
+
+public:
+    static constexpr int key_len = KeyBits / 8;
+    static constexpr int num_rounds = key_len / 4 + 6;
+    static constexpr int len_ekey = 16 * (num_rounds + 1);
+
+    using Key = std::span<const uint8_t, key_len>;
+    using Block = std::span<uint8_t, 16>;
+    using Iv = std::span<uint8_t, 16>;
+
+    explicit Aes(Key key) {
+        expand_key(const_cast<uint8_t*>(key.data()), key_len, ekey.data());
+    }
+
+    ~Aes() { wipe(); }
+
+    Aes(const Aes&) = delete;
+    Aes& operator=(const Aes&) = delete;
+
+    /**
+     * @brief Take over another context's schedule; the source is left wiped.
+     */
+    Aes(Aes&& other) noexcept : ekey(other.ekey) { other.wipe(); }
+
+    Aes& operator=(Aes&& other) noexcept {
+        if (this != &other) {
+            ekey = other.ekey;
+            other.wipe();
+        }
+        return *this;
+    }
+
+    void encrypt_block(Block block) { aes(block.data(), ekey.data(), key_len, true); }
+    void decrypt_block(Block block) { aes(block.data(), ekey.data(), key_len, false); }
+
+    /**
+     * @brief Encrypt data in place. ECB and CBC need whole blocks; the
+     *        stream modes take any length. iv is advanced for the next call.
+     */
+    template <Op_mode Mode> requires needs_iv<Mode>
+    void encrypt(std::span<uint8_t> data, Iv iv) { run<Mode, true>(data, iv.data()); }
+
+    template <Op_mode Mode> requires needs_iv<Mode>
+    void decrypt(std::span<uint8_t> data, Iv iv) { run<Mode, false>(data, iv.data()); }
+
+    template <Op_mode Mode = ECB> requires (!needs_iv<Mode>)
+    void encrypt(std::span<uint8_t> data) { run<Mode, true>(data, nullptr); }
+
+    template <Op_mode Mode = ECB> requires (!needs_iv<Mode>)
+    void decrypt(std::span<uint8_t> data) { run<Mode, false>(data, nullptr); }
+
+    /**
+     * @brief Out-of-place variants: in is copied to out, which must be at
+     *        least as long, and out is processed in place. in and out may
+     *        be the same buffer.
+     */
+    template <Op_mode Mode> requires needs_iv<Mode>
+    void encrypt(std::span<const uint8_t> in, std::span<uint8_t> out, Iv iv) {
+        run<Mode, true>(stage(in, out), iv.data());
+    }
+
+    template <Op_mode Mode> requires needs_iv<Mode>
+    void decrypt(std::span<const uint8_t> in, std::span<uint8_t> out, Iv iv) {
+        run<Mode, false>(stage(in, out), iv.data());
+    }
+
+    template <Op_mode Mode = ECB> requires (!needs_iv<Mode>)
+    void encrypt(std::span<const uint8_t> in, std::span<uint8_t> out) {
+        run<Mode, true>(stage(in, out), nullptr);
+    }
+
+    template <Op_mode Mode = ECB> requires (!needs_iv<Mode>)
+    void decrypt(std::span<const uint8_t> in, std::span<uint8_t> out) {
+        run<Mode, false>(stage(in, out), nullptr);
+    }
+
+private:
+    alignas(16) std::array<uint8_t, len_ekey> ekey{};
+
+    template <Op_mode Mode, bool IsEncrypt>
+    void run(std::span<uint8_t> data, uint8_t* iv) {
+        if constexpr (whole_blocks<Mode>)
+            assert(data.size() % 16 == 0);
+        aes_mode(Mode, data.data(), data.size(), ekey.data(), key_len, iv, IsEncrypt);
+    }
+
+    static std::span<uint8_t> stage(std::span<const uint8_t> in, std::span<uint8_t> out) {
+        assert(out.size() >= in.size());
+        if (in.data() != out.data())
+            std::memmove(out.data(), in.data(), in.size());
+        return out.first(in.size());
+    }
+
+    void wipe() { explicit_bzero(ekey.data(), ekey.size()); }
+};
+
+using Aes128 = Aes<128>;
+using Aes192 = Aes<192>;
+using Aes256 = Aes<256>;
+
+} // namespace caes
+
+#endif
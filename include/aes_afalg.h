@@ -0,0 +1,26 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_afalg.h
+ *
+ * Description:
+ *   File encryption through the Linux kernel crypto API (AF_ALG sockets),
+ *   using whichever AES implementation the kernel has selected. File data
+ *   is spliced from the page cache into the cipher socket, and results are
+ *   vmspliced back out, so the input never passes through a userspace
+ *   buffer. Supports ECB, CBC and CTR; output matches aes_file_pipeline().
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_AFALG_H
+#define AES_AFALG_H
+
+#include "aes_modes.h"
+
+/* Most data the kernel accepts for one operation before it must be read back */
+#define AFALG_MAX_CHUNK (16 * 4096)
+
+bool aes_afalg_available(Op_mode op_mode);
+int aes_afalg_file(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt, uint64_t chunk_size);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef AES_CPP_TEST_H
+#define AES_CPP_TEST_H
+
+#ifdef __cplusplus
+#include <cassert>
+#include "aes.hpp"
+
+void test_cpp_tables();
+void test_cpp_blocks();
+void test_cpp_modes();
+void test_cpp_move();
+
+extern "C" {
+#endif
+
+void test_all_aes_cpp();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
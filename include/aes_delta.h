@@ -0,0 +1,45 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_delta.h
+ *
+ * Description:
+ *   Incremental re-encryption. A container holds a file as fixed-size
+ *   chunks, each encrypted with CTR under its own random nonce, and a table
+ *   of the nonce and a PMAC digest of the plaintext of every chunk, under a
+ *   key derived from the cipher key. Updating the container from a new version of the file hashes the
+ *   new plaintext and re-encrypts and rewrites only the chunks whose digest
+ *   changed, each under a fresh nonce, so the cost is one hashing pass plus
+ *   encryption and I/O proportional to the change.
+ *
+ *   Being keyed PRF outputs, the digests detect any change to a chunk, even
+ *   one crafted to collide, and corruption of a chunk. They do not make the
+ *   container authenticated: whole chunks with their table entries can
+ *   still be swapped or rolled back.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_DELTA_H
+#define AES_DELTA_H
+
+#include "aes_modes.h"
+
+#define AES_DELTA_MAGIC "AESDELTA"
+#define AES_DELTA_VERSION 2                     // 1 used aes_hash() digests
+#define AES_DELTA_DATA_OFFSET 4096              // Header block; chunk i follows at i*chunk_size
+#define AES_DELTA_ENTRY 32                      // Table entry: nonce, digest
+#define AES_DELTA_DEFAULT_CHUNK (256 * 1024)
+#define AES_DELTA_MAX_CHUNK (1 << 30)
+
+#define AES_DELTA_DIRTY 1                       // Header flag: an update did not finish
+
+typedef struct aes_delta_stats {
+    uint64_t num_chunks;
+    uint64_t changed;           // Chunks re-encrypted
+    uint64_t bytes_written;     // Chunk data rewritten, excluding the table
+} Aes_delta_stats;
+
+int aes_delta_encrypt(const char* in_file, const char* container, uint8_t* ekey, int len_key,
+        uint64_t chunk_size, Aes_delta_stats* stats);
+int aes_delta_decrypt(const char* container, const char* out_file, uint8_t* ekey, int len_key);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef AES_DELTA_TEST_H
+#define AES_DELTA_TEST_H
+
+#include <assert.h>
+#include "aes_delta.h"
+
+void test_delta_update();
+void test_delta_resize();
+void test_delta_rejects();
+void test_all_aes_delta();
+
+#endif
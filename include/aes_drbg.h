@@ -0,0 +1,43 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_drbg.h
+ *
+ * Description:
+ *   CTR_DRBG (NIST SP 800-90A) with AES-256 and no derivation function, and
+ *   a per-thread instance seeded from getrandom() for bulk random bytes and
+ *   IVs. Output blocks are produced by aes_ctr(), so one generate call runs
+ *   through the interleaved cipher core; small requests are served from a
+ *   per-thread batch, with no lock and no system call per request.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_DRBG_H
+#define AES_DRBG_H
+
+#include "aes_modes.h"
+
+#define AES_DRBG_SEED_LEN 48                    // Key (32) + V (16)
+#define AES_DRBG_MAX_REQUEST (1 << 16)          // Bytes per generate call, 2^19 bits
+#define AES_DRBG_RESEED_INTERVAL (1ull << 24)   // Generate calls between reseeds
+#define AES_DRBG_BATCH 4096                     // Per-thread bytes generated at once for small requests
+
+#define AES_DRBG_RESEED 1                       // generate: reseed required first
+
+typedef struct aes_drbg {
+    uint8_t ekey[240];          // Expanded Key; its first 32 bytes are Key
+    uint8_t v[16];
+    uint64_t reseed_counter;
+} Aes_drbg;
+
+int aes_drbg_instantiate(Aes_drbg* drbg, const uint8_t* entropy, const uint8_t* personal,
+        int len_personal);
+int aes_drbg_reseed(Aes_drbg* drbg, const uint8_t* entropy, const uint8_t* additional,
+        int len_additional);
+int aes_drbg_generate(Aes_drbg* drbg, uint8_t* out, uint64_t len, const uint8_t* additional,
+        int len_additional);
+void aes_drbg_uninstantiate(Aes_drbg* drbg);
+
+int aes_random_bytes(uint8_t* out, uint64_t len);
+int aes_random_iv(uint8_t* iv);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef AES_DRBG_TEST_H
+#define AES_DRBG_TEST_H
+
+#include <assert.h>
+#include <pthread.h>
+#include "aes_drbg.h"
+
+void test_drbg_known_answer();
+void test_drbg_limits();
+void test_random_bytes();
+void test_random_threads();
+void test_random_fork();
+void test_all_aes_drbg();
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_fpe.h
+ *
+ * Description:
+ *   Format-preserving encryption (NIST SP 800-38G): FF1, and FF3-1 with its
+ *   56-bit tweak (the original 64-bit FF3 tweak is also accepted). Values
+ *   are arrays of numerals in a radix from 2 to 65536. Batches of values
+ *   are evaluated together, with their AES calls interleaved through the
+ *   multi-block cipher core under one expanded key.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_FPE_H
+#define AES_FPE_H
+
+#include "aes_modes.h"
+
+#define FPE_MAX_LEN   128       // Numerals per value
+#define FPE_MAX_TWEAK 256       // FF1 tweak bytes
+
+#define FPE_ERR_LENGTH  -1      // Length outside the domain allowed for the radix
+#define FPE_ERR_TWEAK   -2      // Tweak length not valid for the algorithm
+#define FPE_ERR_NUMERAL -3      // Numeral not below the radix, or radix out of range
+
+typedef enum fpe_type {
+    FF1, FF3_1
+} Fpe_type;
+
+typedef struct fpe_item {
+    const uint16_t* in;
+    uint16_t* out;              // len numerals; may be the same array as in
+    int len;
+    const uint8_t* tweak;
+    int len_tweak;              // FF1: 0..FPE_MAX_TWEAK, FF3-1: 7 (or 8 for FF3)
+    int result;                 // 0, or an FPE_ERR_* code
+} Fpe_item;
+
+void ff3_expand_key(const uint8_t* key, int len_key, uint8_t* ekey);
+void aes_fpe_batch(Fpe_type type, Fpe_item* items, int num_items, uint32_t radix, uint8_t* ekey,
+        int len_key, bool is_encrypt);
+int aes_ff1(const uint16_t* in, uint16_t* out, int len, uint32_t radix, const uint8_t* tweak,
+        int len_tweak, uint8_t* ekey, int len_key, bool is_encrypt);
+int aes_ff3_1(const uint16_t* in, uint16_t* out, int len, uint32_t radix, const uint8_t* tweak,
+        int len_tweak, uint8_t* ekey, int len_key, bool is_encrypt);
+
+int fpe_from_string(const char* s, uint16_t* numerals, uint32_t radix);
+void fpe_to_string(const uint16_t* numerals, int len, char* s);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef AES_FPE_TEST_H
+#define AES_FPE_TEST_H
+
+#include <assert.h>
+#include "aes_fpe.h"
+
+void test_ff1_vectors();
+void test_ff3_1_vectors();
+void test_fpe_large_radix();
+void test_fpe_batch();
+void test_fpe_errors();
+void test_all_aes_fpe();
+
+#endif
@@ -4,18 +4,32 @@
 #include <stdbool.h>
 #include "expand_key.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum op_mode {
-    ECB, CBC, CFB, OFB, CTR
+    ECB, CBC, CFB, OFB, CTR, CFB8, CFB1     // CFB has 128-bit segments
 } Op_mode;
 
-void usage(int exit_code);
-uint8_t* read_vector(char* vector_file, uint64_t* size, bool is_encrypt);
+uint64_t pad_vector(uint8_t* vector, uint64_t size);
+int64_t unpad_vector(uint8_t* vector, uint64_t size);
 void add_round_key(uint8_t* state, uint8_t* ekey, int offset);
 void byte_sub(uint8_t* state, bool is_encrypt);
 void shift_row(uint8_t* state, bool is_encrypt);
 uint8_t gf_mul(uint8_t a, uint8_t b);
 void mix_column(uint8_t* state, bool is_encrypt);
 void aes(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt);
+void aes_table(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt);
+
+// Command line helpers in aes_cli.c; they exit on errors, so the CLI and the
+// tests link them and the libraries leave them out
+void usage(int exit_code);
+uint8_t* read_vector(char* vector_file, uint64_t* size, bool is_encrypt);
 void print_uint8_t_array(uint8_t* arr, int len_arr, char* result);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
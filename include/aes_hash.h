@@ -0,0 +1,43 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_hash.h
+ *
+ * Description:
+ *   Fast non-cryptographic 128-bit hash built from AES rounds, for chunk
+ *   deduplication and corruption checks, with an optional 128-bit key that
+ *   seeds it. Four lanes each absorb one 16-byte block per round, so
+ *   the hash runs at close to one AES round per block. It uses AES-NI when
+ *   the CPU has it, otherwise the table round functions from aes_funcs.h,
+ *   and both give the same digest. aes_mode_hash() hashes the plaintext in
+ *   the same pass that encrypts or decrypts it.
+ *
+ *   The hash is not a MAC: anyone can construct collisions, with or without
+ *   the key. Use aes_mac.h to authenticate data.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_HASH_H
+#define AES_HASH_H
+
+#include "aes_modes.h"
+
+#define AES_HASH_STRIPE 64      // Bytes absorbed per round, 16 per lane
+
+typedef struct aes_hash_ctx {
+    uint8_t lanes[AES_HASH_STRIPE];
+    uint8_t key[16];
+    uint8_t partial[AES_HASH_STRIPE];   // Unabsorbed tail, held back until more data or final
+    int len_partial;
+    uint64_t total;
+} Aes_hash_ctx;
+
+bool aes_hash_use_aesni(bool enable);
+void aes_hash_init(Aes_hash_ctx* ctx, const uint8_t* key);
+void aes_hash_update(Aes_hash_ctx* ctx, const uint8_t* msg, uint64_t len);
+void aes_hash_final(Aes_hash_ctx* ctx, uint8_t* digest);
+void aes_hash(const uint8_t* msg, uint64_t len, const uint8_t* key, uint8_t* digest);
+
+void aes_mode_hash(Aes_hash_ctx* ctx, Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey,
+        int len_key, uint8_t* iv, bool is_encrypt);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef AES_HASH_TEST_H
+#define AES_HASH_TEST_H
+
+#include <assert.h>
+#include "aes_hash.h"
+
+void test_hash_paths_agree();
+void test_hash_incremental();
+void test_hash_sensitivity();
+void test_hash_keyed();
+void test_mode_hash();
+void test_all_aes_hash();
+
+#endif
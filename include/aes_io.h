@@ -0,0 +1,49 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_io.h
+ *
+ * Description:
+ *   Asynchronous file-to-file encryption pipeline. Reads, encryption and
+ *   writes of fixed-size chunks are overlapped: several reads are kept in
+ *   flight, completed chunks are handed to a pool of cipher workers, and
+ *   writes are submitted as soon as a chunk is finished. I/O goes through
+ *   io_uring when the kernel provides it, otherwise through a small pool of
+ *   I/O threads doing pread/pwrite. IO_AF_ALG instead hands the whole file
+ *   to the kernel crypto API (see aes_afalg.h). On NUMA hosts the cipher workers are
+ *   pinned per node and each buffer lives on the node that encrypts it.
+ *   aes_file_rekey() runs the same pipeline to rotate a file's key in one
+ *   pass, decrypting and re-encrypting each chunk while it is in cache.
+ *   Both cipher passes count in the metrics, so a rotation announces and
+ *   records twice the file's size.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_IO_H
+#define AES_IO_H
+
+#include "aes_modes.h"
+
+typedef enum io_backend {
+    IO_AUTO, IO_URING, IO_THREADS, IO_AF_ALG
+} Io_backend;
+
+typedef struct aes_io_opts {
+    Io_backend backend;
+    uint64_t chunk_size;    // Bytes per buffer, rounded down to a multiple of 16
+    int queue_depth;        // Number of chunk buffers in flight
+    int num_threads;        // Cipher workers, 0 for one per online CPU
+    bool numa;              // Pin workers per NUMA node and keep their buffers node-local
+} Aes_io_opts;
+
+#define AES_IO_DEFAULT_CHUNK (1 << 20)
+#define AES_IO_MAX_CHUNK (1ull << 31)   // io_uring lengths are 32-bit, with room for padding
+#define AES_IO_DEFAULT_DEPTH 8
+
+void aes_io_default_opts(Aes_io_opts* opts);
+bool aes_io_uring_available();
+int aes_file_pipeline(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey,
+        int len_key, uint8_t* iv, bool is_encrypt, Aes_io_opts* opts);
+int aes_file_rekey(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey, int len_key,
+        uint8_t* iv, uint8_t* new_ekey, int new_len_key, uint8_t* new_iv, Aes_io_opts* opts);
+
+#endif
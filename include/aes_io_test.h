@@ -0,0 +1,15 @@
+#ifndef AES_IO_TEST_H
+#define AES_IO_TEST_H
+
+#include <assert.h>
+#include "aes_io.h"
+#include "aes_afalg.h"
+#include "aes_metrics.h"
+
+void test_ctr_pipeline_threads();
+void test_file_pipeline();
+void test_file_rekey();
+void test_afalg_pipeline();
+void test_all_aes_io();
+
+#endif
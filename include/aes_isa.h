@@ -0,0 +1,68 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_isa.h
+ *
+ * Description:
+ *   Instruction set tiers and the kernel dispatch table. The hot kernels
+ *   (the block cipher, the interleaved core, the CTR and CBC decryption
+ *   loops and the hex decoder's fast path) exist in several variants, and
+ *   the best variant the CPU supports is bound once when the program or
+ *   library is loaded. Every variant gives the same output.
+ *
+ *   The tiers are cumulative:
+ *     baseline  portable table cipher, SSE2 hex decoding on x86-64
+ *     ssse3     AES-NI round instructions, byte-shuffled CTR counters
+ *     avx2      256-bit hex decoding; with VAES, bulk ECB, CTR and CBC
+ *               decryption two blocks per instruction
+ *     avx512    512-bit clones of the byte loops; with VAES, the bulk
+ *               kernels four blocks per instruction
+ *
+ *   Setting AES_ISA to a tier name in the environment caps the tier bound
+ *   at load time, for comparing variants or working around a bad CPU.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_ISA_H
+#define AES_ISA_H
+
+#include "aes_modes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define AES_ISA_X86 1
+// Clone a plain loop per tier; the dynamic linker picks one through an ifunc
+#define AES_ISA_CLONES __attribute__((target_clones("default", "ssse3", "avx2", "avx512f")))
+#else
+#define AES_ISA_CLONES
+#endif
+
+typedef enum aes_isa {
+    AES_ISA_BASELINE, AES_ISA_SSSE3, AES_ISA_AVX2, AES_ISA_AVX512
+} Aes_isa;
+
+typedef struct aes_kernels {
+    void (*block)(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt);
+    void (*blocks)(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key, bool is_encrypt);
+    void (*blocks_keys)(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys, int len_key,
+            bool is_encrypt);
+    void (*ctr)(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+    void (*cbc_decrypt)(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+    const char* name;
+} Aes_kernels;
+
+extern Aes_kernels aes_kernels;
+
+Aes_isa aes_isa_detect();
+Aes_isa aes_isa_select(Aes_isa isa);
+Aes_isa aes_isa_current();
+const char* aes_isa_name(Aes_isa isa);
+int aes_isa_parse(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef AES_ISA_TEST_H
+#define AES_ISA_TEST_H
+
+#include <assert.h>
+#include "aes_isa.h"
+#include "hex.h"
+
+void test_isa_names();
+void test_isa_kernels_agree();
+void test_isa_hex_agree();
+void test_all_aes_isa();
+
+#endif
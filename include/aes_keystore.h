@@ -0,0 +1,54 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keystore.h
+ *
+ * Description:
+ *   Compact store for very large numbers of keys. Only the raw 16/24/32-byte
+ *   key is kept per entry (34 bytes with its length and heat, against 240
+ *   for an expanded schedule). Cold keys generate their round keys on the fly,
+ *   interleaved with the rounds, while a small cache holds full schedules for
+ *   the keys that are used most.
+ *
+ *   A store is not thread-safe; give each thread its own, or lock around it.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_KEYSTORE_H
+#define AES_KEYSTORE_H
+
+#include "aes_modes.h"
+
+#define AES_KEYSTORE_HOT_THRESHOLD 4        // Uses before a key earns a cached schedule
+#define AES_KEYSTORE_ONTHEFLY_BLOCKS 4      // Cold calls up to this size skip expansion
+#define AES_KEYSTORE_DECAY_MIN 65536        // Fewest lookups between heat halvings
+
+typedef struct keystore_entry {
+    int64_t id;                 // Key held in this entry, -1 if empty
+    uint8_t ekey[240];
+} Keystore_entry;
+
+typedef struct aes_keystore {
+    uint8_t (*keys)[32];
+    uint8_t* len_keys;
+    uint8_t* heat;              // Saturating use count, halved periodically
+    uint64_t num_keys;
+    uint64_t capacity;
+
+    Keystore_entry* cache;      // Direct-mapped by key id
+    uint32_t cache_size;        // Power of two, or 0 for no cache
+    uint64_t lookups;           // Since the last halving of heat
+    uint64_t hits;
+    uint64_t misses;
+} Aes_keystore;
+
+void aes_compact(uint8_t* state, const uint8_t* key, int len_key, bool is_encrypt);
+
+int aes_keystore_init(Aes_keystore* ks, uint64_t capacity, uint32_t cache_entries);
+int64_t aes_keystore_add(Aes_keystore* ks, const uint8_t* key, int len_key);
+void aes_keystore_ecb(Aes_keystore* ks, int64_t id, uint8_t* blocks, uint64_t num_blocks,
+        bool is_encrypt);
+void aes_keystore_mode(Aes_keystore* ks, int64_t id, Op_mode op_mode, uint8_t* data,
+        uint64_t len, uint8_t* iv, bool is_encrypt);
+void aes_keystore_free(Aes_keystore* ks);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef AES_KEYSTORE_TEST_H
+#define AES_KEYSTORE_TEST_H
+
+#include <assert.h>
+#include "aes_keystore.h"
+
+void test_aes_compact();
+void test_keystore_matches_expanded();
+void test_keystore_cache();
+void test_all_aes_keystore();
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keystream.h
+ *
+ * Description:
+ *   Precomputed OFB/CTR keystream. For one key and IV, a background producer
+ *   thread keeps a ring buffer of keystream filled ahead of demand, so
+ *   encrypting or decrypting a message on the latency-sensitive path is only
+ *   an XOR against bytes that are already there.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_KEYSTREAM_H
+#define AES_KEYSTREAM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "aes_modes.h"
+
+/* Bytes the producer generates between updates of the ring's head */
+#define AES_KEYSTREAM_BATCH 4096
+#define AES_KEYSTREAM_DEFAULT_CAPACITY (256 * 1024)
+
+typedef struct aes_keystream {
+    Op_mode op_mode;            // OFB or CTR
+    uint8_t ekey[240];
+    int len_key;
+    uint8_t iv[16];             // Next counter block, or OFB feedback register
+
+    uint8_t* ring;
+    uint64_t capacity;          // Multiple of AES_KEYSTREAM_BATCH
+    _Atomic uint64_t head;      // Bytes produced so far
+    _Atomic uint64_t tail;      // Bytes consumed so far
+
+    pthread_t producer;
+    pthread_mutex_t lock;       // Only taken when one side has to sleep
+    pthread_cond_t space;
+    pthread_cond_t data;
+    _Atomic bool producer_waiting;
+    _Atomic bool consumer_waiting;
+    _Atomic bool stop;
+} Aes_keystream;
+
+int aes_keystream_init(Aes_keystream* ks, Op_mode op_mode, uint8_t* ekey, int len_key,
+        const uint8_t* iv, uint64_t capacity);
+void aes_keystream_xor(Aes_keystream* ks, uint8_t* data, uint64_t len);
+uint64_t aes_keystream_available(Aes_keystream* ks);
+void aes_keystream_destroy(Aes_keystream* ks);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef AES_KEYSTREAM_TEST_H
+#define AES_KEYSTREAM_TEST_H
+
+#include <assert.h>
+#include "aes_keystream.h"
+
+void test_keystream_matches_modes();
+void test_keystream_wraparound();
+void test_keystream_bad_mode();
+void test_all_aes_keystream();
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keywrap.h
+ *
+ * Description:
+ *   AES Key Wrap (RFC 3394, KW) and Key Wrap with Padding (RFC 5649, KWP),
+ *   one key at a time or as a batch of many keys under one key-encryption
+ *   key. The batch engine interleaves the 6·n wrapping steps of up to eight
+ *   keys through the multi-block cipher core.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_KEYWRAP_H
+#define AES_KEYWRAP_H
+
+#include "aes_modes.h"
+
+#define KW_ERR_LENGTH    -1     // Input length not valid for the algorithm
+#define KW_ERR_INTEGRITY -2     // Unwrapped integrity check value did not match
+
+typedef struct kw_item {
+    const uint8_t* in;
+    uint64_t len_in;
+    uint8_t* out;           // len_in + 8 bytes when wrapping (KWP: rounded up to 8 first),
+                            // len_in - 8 bytes when unwrapping
+    int64_t result;         // Output length, or a KW_ERR_* code
+} Kw_item;
+
+int64_t aes_key_wrap(const uint8_t* in, uint64_t len_in, uint8_t* ekey, int len_key,
+        uint8_t* out, bool padded);
+int64_t aes_key_unwrap(const uint8_t* in, uint64_t len_in, uint8_t* ekey, int len_key,
+        uint8_t* out, bool padded);
+void aes_key_wrap_batch(Kw_item* items, int num_items, uint8_t* ekey, int len_key, bool padded);
+void aes_key_unwrap_batch(Kw_item* items, int num_items, uint8_t* ekey, int len_key, bool padded);
+
+#endif
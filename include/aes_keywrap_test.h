@@ -0,0 +1,13 @@
+#ifndef AES_KEYWRAP_TEST_H
+#define AES_KEYWRAP_TEST_H
+
+#include <assert.h>
+#include "aes_keywrap.h"
+
+void test_key_wrap();
+void test_key_wrap_pad();
+void test_key_unwrap_errors();
+void test_key_wrap_batch();
+void test_all_aes_keywrap();
+
+#endif
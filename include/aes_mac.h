@@ -0,0 +1,47 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_mac.h
+ *
+ * Description:
+ *   Message authentication codes built on the AES block function:
+ *   CMAC (NIST SP 800-38B / RFC 4493), serial and incremental, and PMAC
+ *   (Rogaway's PMAC1), whose per-block work is independent and is spread
+ *   across interleaved lanes and threads.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_MAC_H
+#define AES_MAC_H
+
+#include "aes_modes.h"
+
+typedef enum mac_type {
+    CMAC, PMAC
+} Mac_type;
+
+typedef struct cmac_ctx {
+    uint8_t* ekey;
+    int len_key;
+    uint8_t k1[16];
+    uint8_t k2[16];
+    uint8_t state[16];      // CBC-MAC chaining value
+    uint8_t partial[16];    // Unprocessed tail, held back until more data or final
+    int len_partial;
+} Cmac_ctx;
+
+void gf128_double(uint8_t* block);
+void gf128_halve(uint8_t* block);
+void cmac_subkeys(uint8_t* ekey, int len_key, uint8_t* k1, uint8_t* k2);
+
+void cmac_init(Cmac_ctx* ctx, uint8_t* ekey, int len_key);
+void cmac_update(Cmac_ctx* ctx, const uint8_t* msg, uint64_t len);
+void cmac_final(Cmac_ctx* ctx, uint8_t* tag);
+void aes_cmac(const uint8_t* msg, uint64_t len, uint8_t* ekey, int len_key, uint8_t* tag);
+
+void aes_pmac(const uint8_t* msg, uint64_t len, uint8_t* ekey, int len_key, uint8_t* tag,
+        int num_threads);
+
+int aes_mac_file(char* vector_file, Mac_type mac_type, uint8_t* ekey, int len_key,
+        uint8_t* tag, int num_threads);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef AES_MAC_TEST_H
+#define AES_MAC_TEST_H
+
+#include <assert.h>
+#include "aes_mac.h"
+
+void test_gf128_double();
+void test_cmac();
+void test_cmac_incremental();
+void test_pmac();
+void test_pmac_threads();
+void test_all_aes_mac();
+
+#endif
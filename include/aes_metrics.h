@@ -0,0 +1,62 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_metrics.h
+ *
+ * Description:
+ *   Runtime instrumentation for long-running jobs. It covers:
+ *     - counters of bytes and blocks processed per mode and backend;
+ *     - counters of key expansions and key cache lookups;
+ *     - per-call latency histograms, which each thread records into its
+ *       own buckets without locking.
+ *   Results are available as an in-process snapshot, a periodically
+ *   rewritten Prometheus text-format file, and a progress/ETA line on
+ *   stderr. Nothing is recorded until metrics are enabled.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_METRICS_H
+#define AES_METRICS_H
+
+#include <stdatomic.h>
+#include "aes_funcs.h"
+
+#define METRICS_NUM_MODES 7
+#define METRICS_HIST_BUCKETS 48             // Bucket i counts latencies of at most 2^i ns
+#define METRICS_DEFAULT_INTERVAL_MS 1000
+
+typedef enum metrics_backend {
+    METRICS_MEMORY, METRICS_URING, METRICS_THREADS, METRICS_AF_ALG, METRICS_NUM_BACKENDS
+} Metrics_backend;
+
+typedef struct metrics_snapshot {
+    uint64_t bytes[METRICS_NUM_MODES][METRICS_NUM_BACKENDS];
+    uint64_t blocks[METRICS_NUM_MODES][METRICS_NUM_BACKENDS];
+    uint64_t key_expansions;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t latency[METRICS_NUM_MODES][METRICS_HIST_BUCKETS];
+    uint64_t latency_sum_ns[METRICS_NUM_MODES];
+    uint64_t latency_count[METRICS_NUM_MODES];
+    uint64_t expected_bytes;                // Total announced by metrics_expect()
+    double elapsed;                         // Seconds since metrics were enabled
+} Metrics_snapshot;
+
+extern atomic_bool metrics_enabled;
+
+void metrics_enable();
+void metrics_set_backend(Metrics_backend backend);
+Metrics_backend metrics_get_backend();
+uint64_t metrics_now_ns();
+void metrics_record(Op_mode op_mode, uint64_t len, uint64_t start_ns);
+void metrics_count_key_expansion();
+void metrics_count_cache(bool hit);
+void metrics_expect(uint64_t len);
+
+void metrics_snapshot(Metrics_snapshot* snap);
+int metrics_write_prometheus(const char* path);
+void metrics_format_progress(Metrics_snapshot* snap, char* line, size_t size);
+
+int metrics_start_exporter(const char* path, bool progress, int interval_ms);
+void metrics_stop_exporter();
+
+#endif
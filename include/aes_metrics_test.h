@@ -0,0 +1,15 @@
+#ifndef AES_METRICS_TEST_H
+#define AES_METRICS_TEST_H
+
+#include <assert.h>
+#include <pthread.h>
+#include "aes_metrics.h"
+#include "aes_modes.h"
+
+void test_metrics_counters();
+void test_metrics_thread_histograms();
+void test_metrics_prometheus();
+void test_metrics_progress();
+void test_all_aes_metrics();
+
+#endif
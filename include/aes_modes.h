@@ -0,0 +1,62 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_modes.h
+ *
+ * Description:
+ *   Interleaved multi-block cipher core and the block cipher modes of
+ *   operation (ECB, CBC, CFB with 1-, 8- and 128-bit segments, OFB, CTR)
+ *   built on top of it.
+ *   The interleaved core advances several independent states through each
+ *   round together so that the table lookups of different blocks overlap
+ *   instead of waiting on each other.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_MODES_H
+#define AES_MODES_H
+
+#include "aes_funcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maximum number of blocks advanced through a round together */
+#define AES_INTERLEAVE_MAX 8
+
+void aes_x4(uint8_t* states, uint8_t* ekey, int len_key, bool is_encrypt);
+void aes_x8(uint8_t* states, uint8_t* ekey, int len_key, bool is_encrypt);
+void aes_set_interleave(int width);
+int aes_get_interleave();
+void aes_blocks(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key, bool is_encrypt);
+void aes_x4_keys(uint8_t* states, uint8_t* const* ekeys, int len_key, bool is_encrypt);
+void aes_x8_keys(uint8_t* states, uint8_t* const* ekeys, int len_key, bool is_encrypt);
+void aes_blocks_keys(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys, int len_key,
+        bool is_encrypt);
+void aes_blocks_table(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key,
+        bool is_encrypt);
+void aes_blocks_keys_table(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys, int len_key,
+        bool is_encrypt);
+
+void ctr_increment(uint8_t* counter);
+void ctr_add(uint8_t* counter, uint64_t n);
+
+void aes_ecb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, bool is_encrypt);
+void aes_cbc(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt);
+void aes_cbc_decrypt_table(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+void aes_cfb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt);
+void aes_cfb8(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt);
+void aes_cfb1(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt);
+void aes_ofb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+void aes_ctr(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+void aes_ctr_table(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv);
+uint64_t aes_bulk_threshold();
+void aes_bulk_set_threshold(uint64_t threshold);
+void aes_mode(Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
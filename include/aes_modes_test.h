@@ -0,0 +1,18 @@
+#ifndef AES_MODES_TEST_H
+#define AES_MODES_TEST_H
+
+#include <assert.h>
+#include "aes_modes.h"
+
+void test_aes_x8();
+void test_ecb();
+void test_cbc();
+void test_cfb();
+void test_cfb8();
+void test_cfb1();
+void test_ofb();
+void test_ctr();
+void test_bulk();
+void test_all_aes_modes();
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_multibuf.h
+ *
+ * Description:
+ *   Multi-buffer CBC encryption. CBC encryption is a serial chain within a
+ *   message, but independent messages are not, so many messages (each with
+ *   its own IV and possibly its own key) are advanced in lockstep through
+ *   the interleaved cipher core, one block of each per pass.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_MULTIBUF_H
+#define AES_MULTIBUF_H
+
+#include "aes_modes.h"
+
+typedef struct cbc_msg {
+    uint8_t* data;          // Encrypted in place
+    uint64_t len;           // Multiple of 16
+    uint8_t* ekey;
+    int len_key;
+    uint8_t* iv;            // Left holding the next chaining value, as with aes_cbc()
+} Cbc_msg;
+
+void aes_cbc_encrypt_multi(Cbc_msg* msgs, int num_msgs);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef AES_MULTIBUF_TEST_H
+#define AES_MULTIBUF_TEST_H
+
+#include <assert.h>
+#include "aes_multibuf.h"
+
+void test_blocks_keys();
+void test_cbc_multi_vector();
+void test_cbc_multi_mixed();
+void test_all_aes_multibuf();
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_numa.h
+ *
+ * Description:
+ *   NUMA topology discovery and placement helpers for the multi-threaded
+ *   cipher paths. Nodes and their CPUs are read from sysfs, so no NUMA
+ *   library is needed; hosts without NUMA information look like a single
+ *   node holding every CPU the process may run on.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_NUMA_H
+#define AES_NUMA_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define AES_NUMA_MAX_NODES 64
+
+typedef struct numa_topology {
+    int num_nodes;                          // Nodes with at least one usable CPU
+    int node_ids[AES_NUMA_MAX_NODES];       // Kernel node number of each entry
+    cpu_set_t cpus[AES_NUMA_MAX_NODES];     // Usable CPUs of each node
+} Numa_topology;
+
+int numa_parse_cpulist(const char* cpulist, cpu_set_t* cpus);
+void numa_discover(Numa_topology* topo);
+int numa_pin_to_node(Numa_topology* topo, int node);
+void* numa_alloc_untouched(size_t size);
+void numa_free(void* ptr, size_t size);
+void numa_first_touch(void* ptr, size_t size);
+
+#endif
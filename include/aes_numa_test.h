@@ -0,0 +1,15 @@
+#ifndef AES_NUMA_TEST_H
+#define AES_NUMA_TEST_H
+
+#include "aes_numa.h"
+#include "aes_io.h"
+#include <assert.h>
+#include <pthread.h>
+
+void test_parse_cpulist();
+void test_discover();
+void test_first_touch();
+void test_numa_pipeline();
+void test_all_aes_numa();
+
+#endif
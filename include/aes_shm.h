@@ -0,0 +1,131 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_shm.h
+ *
+ * Description:
+ *   Local encryption service over shared memory. The service maps a named
+ *   POSIX shared-memory region holding one submission ring per worker, one
+ *   completion ring per client and a payload area per client. Clients map
+ *   the same region, write payloads into their area, and submit requests
+ *   naming a key, a mode and a range of that area. A pool of workers
+ *   encrypts or decrypts the range in place with expanded keys that stay
+ *   in the service process and never enter the region.
+ *
+ *   The rings are lock-free, bounded and multi-producer/single-consumer, so
+ *   any number of clients can submit to a worker, and any number of workers
+ *   can complete to a client, without a syscall. A side with nothing to do
+ *   polls briefly, then yields, then sleeps on a futex in the ring.
+ *
+ *   A client handle belongs to one thread; threads that submit concurrently
+ *   each attach their own. Every client can read and write the whole
+ *   region, so the service separates clients' requests but does not
+ *   protect them from each other: attach only clients that trust each
+ *   other.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_SHM_H
+#define AES_SHM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "aes_modes.h"
+
+#define AES_SHM_MAGIC 0x53474e4952534541ULL   // "AESRINGS"
+#define AES_SHM_VERSION 2
+#define AES_SHM_RING_SIZE 256                  // Entries per ring, a power of two
+#define AES_SHM_MAX_CLIENTS 64
+#define AES_SHM_MAX_WORKERS 16
+#define AES_SHM_MAX_IN_FLIGHT (AES_SHM_RING_SIZE - AES_SHM_MAX_WORKERS)   // Per client
+#define AES_SHM_MAX_KEYS 1024
+#define AES_SHM_DEFAULT_AREA (1 << 20)         // Payload bytes per client
+
+#define AES_SHM_SPIN 1024           // Polls before yielding
+#define AES_SHM_YIELD 16            // Yields before sleeping on the futex
+#define AES_SHM_SLEEP_MS 50         // Longest futex sleep between liveness checks
+
+typedef struct aes_shm_request {
+    uint64_t tag;               // Returned unchanged with the completion
+    uint64_t offset;            // Payload range within the client's area
+    uint64_t len;
+    uint32_t key_id;
+    uint8_t op_mode;            // Op_mode
+    uint8_t is_encrypt;
+    uint16_t client;            // Set by aes_shm_submit()
+    uint16_t generation;        // Set by aes_shm_submit(): the attach it came from
+    int32_t status;             // On completion: 0, or -1 if the request was rejected
+    uint8_t iv[16];             // In: IV; on completion: the next chaining value
+} Aes_shm_request;
+
+typedef struct shm_cell {
+    _Atomic uint64_t seq;       // Position this cell is ready for, see aes_shm.c
+    Aes_shm_request req;
+} Shm_cell;
+
+typedef struct shm_ring {
+    _Alignas(64) _Atomic uint64_t tail;     // Claimed by producers
+    _Alignas(64) _Atomic uint64_t head;     // Advanced by the single consumer
+    _Alignas(64) _Atomic uint32_t doorbell; // Futex word, bumped on every push
+    _Atomic uint32_t sleepers;
+    Shm_cell cells[AES_SHM_RING_SIZE];
+} Shm_ring;
+
+/* Layout of the shared region; the client payload areas follow it */
+typedef struct aes_shm_region {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_workers;
+    uint64_t area_size;         // Payload bytes per client, a multiple of 64
+    uint64_t size;              // Of the whole mapping
+    _Atomic uint64_t clients;   // Bit per attached client
+    _Atomic uint32_t running;
+    _Atomic uint32_t generations[AES_SHM_MAX_CLIENTS];   // Attaches per client slot
+    _Atomic int32_t owners[AES_SHM_MAX_CLIENTS];         // Pid holding each slot, 0 if none
+    Shm_ring submit[AES_SHM_MAX_WORKERS];
+    Shm_ring complete[AES_SHM_MAX_CLIENTS];
+} Aes_shm_region;
+
+typedef struct shm_key {
+    uint8_t ekey[240];
+    int len_key;
+} Shm_key;
+
+typedef struct shm_worker {
+    struct aes_shm_service* svc;
+    int index;
+    pthread_t thread;
+} Shm_worker;
+
+typedef struct aes_shm_service {
+    char name[256];
+    Aes_shm_region* region;
+    Shm_key* keys;              // Private to the service process
+    uint32_t num_keys;
+    int num_workers;
+    Shm_worker workers[AES_SHM_MAX_WORKERS];
+    bool started;
+} Aes_shm_service;
+
+typedef struct aes_shm_client {
+    Aes_shm_region* region;
+    uint8_t* area;              // This client's payload area
+    uint64_t area_size;
+    uint16_t id;
+    uint16_t generation;
+    uint32_t in_flight;
+    uint32_t next_worker;
+} Aes_shm_client;
+
+int aes_shm_service_init(Aes_shm_service* svc, const char* name, int num_workers,
+        uint64_t area_size);
+int64_t aes_shm_service_add_key(Aes_shm_service* svc, const uint8_t* key, int len_key);
+int aes_shm_service_start(Aes_shm_service* svc);
+void aes_shm_service_stop(Aes_shm_service* svc);
+
+int aes_shm_attach(Aes_shm_client* c, const char* name);
+int aes_shm_submit(Aes_shm_client* c, Aes_shm_request* req);
+int aes_shm_poll(Aes_shm_client* c, Aes_shm_request* done);
+int aes_shm_wait(Aes_shm_client* c, Aes_shm_request* done);
+void aes_shm_detach(Aes_shm_client* c);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef AES_SHM_TEST_H
+#define AES_SHM_TEST_H
+
+#include <assert.h>
+#include "aes_shm.h"
+
+void test_shm_modes();
+void test_shm_rejects();
+void test_shm_slot_reuse();
+void test_shm_clients();
+void test_shm_process();
+void test_all_aes_shm();
+
+#endif
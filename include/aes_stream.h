@@ -0,0 +1,34 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_stream.h
+ *
+ * Description:
+ *   Incremental init/update/final interface to every mode of operation, for
+ *   data that arrives in arbitrary-sized pieces. Only a partial-block tail
+ *   is buffered in the context; whole blocks go straight to the mode
+ *   functions in aes_modes.c.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_STREAM_H
+#define AES_STREAM_H
+
+#include "aes_modes.h"
+
+typedef struct aes_stream {
+    Op_mode op_mode;
+    uint8_t* ekey;
+    int len_key;
+    bool is_encrypt;
+    bool padded;            // PKCS#7 pad on encrypt, check and strip on decrypt
+    uint8_t iv[16];         // Chaining value carried between updates
+    uint8_t tail[16];       // Bytes not yet processed
+    int len_tail;
+} Aes_stream;
+
+void aes_stream_init(Aes_stream* s, Op_mode op_mode, uint8_t* ekey, int len_key,
+        const uint8_t* iv, bool is_encrypt, bool padded);
+int64_t aes_stream_update(Aes_stream* s, const uint8_t* in, uint64_t len, uint8_t* out);
+int64_t aes_stream_final(Aes_stream* s, uint8_t* out);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef AES_STREAM_TEST_H
+#define AES_STREAM_TEST_H
+
+#include <assert.h>
+#include "aes_stream.h"
+
+void test_stream_fragments();
+void test_stream_unpadded();
+void test_stream_errors();
+void test_all_aes_stream();
+
+#endif
@@ -23,6 +23,10 @@
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* --------------------------------------------------------------------------
  * AES Substitution Boxes
  * --------------------------------------------------------------------------
@@ -68,4 +72,8 @@ extern const uint8_t AES_MUL_D[4][4];
 extern const uint8_t AES_L[256];
 extern const uint8_t AES_E[256];
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
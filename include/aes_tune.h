@@ -0,0 +1,34 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_tune.h
+ *
+ * Description:
+ *   Per-host tuning profiles. aes_autotune() times short runs over the
+ *   available I/O backends and a few settings for each pipeline parameter
+ *   and the interleave width, and keeps the fastest. The result is saved as
+ *   a small key=value file named after the host, which bin/aes loads on
+ *   every later run before applying its command-line overrides.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef AES_TUNE_H
+#define AES_TUNE_H
+
+#include "aes_io.h"
+
+#define AES_TUNE_RUN_MS 250                   // Target length of one pipeline timing
+#define AES_TUNE_MAX_SAMPLE (64ull << 20)
+
+typedef struct aes_profile {
+    Aes_io_opts io;
+    int interleave;             // Widest interleaved variant for aes_blocks()
+} Aes_profile;
+
+void aes_profile_defaults(Aes_profile* profile);
+int aes_profile_default_path(char* path, size_t size);
+int aes_profile_load(const char* path, Aes_profile* profile);
+int aes_profile_save(const char* path, const Aes_profile* profile);
+void aes_profile_print(FILE* f, const Aes_profile* profile);
+int aes_autotune(Aes_profile* profile, uint64_t sample_size, bool verbose);
+
+#endif
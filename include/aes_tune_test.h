@@ -0,0 +1,13 @@
+#ifndef AES_TUNE_TEST_H
+#define AES_TUNE_TEST_H
+
+#include <assert.h>
+#include "aes_tune.h"
+
+void test_interleave_widths();
+void test_profile_round_trip();
+void test_profile_errors();
+void test_autotune();
+void test_all_aes_tune();
+
+#endif
@@ -28,6 +28,10 @@
 #include <string.h>
 #include "aes_tables.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 uint8_t char_to_hex(char c);
 void strip_whitespace(char* s);
 int read_key(char* key_file, uint8_t* key);
@@ -39,4 +43,8 @@ uint32_t K(uint8_t* key, int len_key, int offset);
 void store_ekey(uint8_t* loc, uint32_t store_val);
 void expand_key(uint8_t* key, int len_key, uint8_t* ekey);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,42 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: hex.h
+ *
+ * Description:
+ *   Single-pass hexadecimal decoder for keys and hex-encoded payloads.
+ *   Whitespace is skipped while decoding, input may be fed in arbitrary
+ *   pieces through a streaming decoder, and errors are returned to the
+ *   caller instead of exiting.
+ * -----------------------------------------------------------------------------
+ */
+
+#ifndef HEX_H
+#define HEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define HEX_OK          0
+#define HEX_ERR_CHAR   -1   // Character that is neither a hex digit nor whitespace
+#define HEX_ERR_ODD    -2   // Input ended in the middle of a byte
+#define HEX_ERR_IO     -3   // File could not be opened or read
+#define HEX_ERR_NOMEM  -4
+
+typedef struct hex_decoder {
+    uint8_t pending;        // High nibble waiting for its low nibble
+    bool has_pending;
+    uint64_t position;      // Input characters consumed so far
+    char bad_char;          // Offending character after HEX_ERR_CHAR
+} Hex_decoder;
+
+uint8_t hex_digit_value(char c);
+bool hex_use_avx2(bool enable);
+void hex_decoder_init(Hex_decoder* d);
+int64_t hex_decode_update(Hex_decoder* d, const char* in, uint64_t len, uint8_t* out);
+int hex_decode_final(Hex_decoder* d);
+int64_t hex_decode(const char* in, uint64_t len, uint8_t* out);
+uint8_t* hex_read_file(char* hex_file, uint64_t* size, int* err);
+const char* hex_strerror(int err);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HEX_TEST_H
+#define HEX_TEST_H
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hex.h"
+
+void test_hex_digit_value();
+void test_hex_decode();
+void test_hex_decode_errors();
+void test_hex_decode_stream();
+void test_hex_read_file();
+void test_all_hex();
+
+#endif
@@ -1,17 +1,140 @@
 #include "../include/aes_funcs.h"
+#include "../include/aes_delta.h"
+#include "../include/aes_modes.h"
+#include "../include/aes_io.h"
+#include "../include/aes_isa.h"
+#include "../include/aes_mac.h"
+#include "../include/aes_metrics.h"
+#include "../include/aes_shm.h"
+#include "../include/aes_tune.h"
 #include "../include/expand_key.h"
+#include "../include/hex.h"
+
+#include <signal.h>
 
 int main (int argc, char *argv[]) {
     // Delare variables to be assigned by command line arguments
     bool is_encrypt = true;
     Op_mode op_mode = ECB;
-    
+    int segment = 128;
+    char* iv_file = NULL;
+    char* out_file = NULL;
+    bool hex_input = false;
+    bool do_mac = false;
+    bool incremental = false;
+    char* rekey_new = NULL;
+    char* new_iv_file = NULL;
+    uint64_t delta_chunk = 0;
+    char* metrics_file = NULL;
+    bool progress = false;
+    Mac_type mac_type = CMAC;
+    Aes_profile profile;
+    aes_profile_defaults(&profile);
+    char profile_path[4096];
+    char* profile_file = NULL;
+    bool use_profile = true;
+
+    // Calibrate this host and save its profile; takes no key or vector
+    if (argc >= 2 && !strcmp(argv[1], "--autotune")) {
+        if (argc == 4 && !strcmp(argv[2], "--profile"))
+            profile_file = argv[3];
+        else if (argc != 2)
+            usage(1);
+        if (!profile_file && aes_profile_default_path(profile_path, sizeof(profile_path)) < 0) {
+            fprintf(stderr, "Error: no home directory for the profile, use --profile FILE\n");
+            exit(1);
+        }
+        if (aes_autotune(&profile, 0, true) < 0 ||
+                aes_profile_save(profile_file ? profile_file : profile_path, &profile) < 0)
+            exit(1);
+        printf("Saved %s:\n", profile_file ? profile_file : profile_path);
+        aes_profile_print(stdout, &profile);
+        return 0;
+    }
+
+    // Serve keys to local clients over shared memory until interrupted
+    if (argc >= 2 && !strcmp(argv[1], "--serve")) {
+        if (argc < 4)
+            usage(1);
+        int num_workers = 0;
+        uint64_t area_size = 0;
+        int i = 3;
+        for (; i < argc - 1; i++) {
+            if (!strcmp(argv[i], "--threads"))
+                num_workers = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--area"))
+                area_size = strtoull(argv[++i], NULL, 10);
+            else
+                break;
+        }
+        if (i >= argc)
+            usage(1);
+
+        // Workers inherit the blocked mask, so only sigwait() sees these
+        sigset_t stop_signals;
+        sigemptyset(&stop_signals);
+        sigaddset(&stop_signals, SIGINT);
+        sigaddset(&stop_signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+        Aes_shm_service svc;
+        if (aes_shm_service_init(&svc, argv[2], num_workers, area_size) < 0)
+            exit(1);
+        for (; i < argc; i++) {
+            uint8_t key[32 + 1];
+            int len_key = read_key(argv[i], key);
+            int64_t id = len_key < 0 ? -1 : aes_shm_service_add_key(&svc, key, len_key);
+            memset(key, 0, sizeof(key));
+            if (id < 0) {
+                aes_shm_service_stop(&svc);
+                exit(1);
+            }
+        }
+        if (aes_shm_service_start(&svc) < 0)
+            exit(1);
+        printf("Serving %s: %u keys, %d workers\n", argv[2], svc.num_keys, svc.num_workers);
+        fflush(stdout);
+
+        int sig;
+        sigwait(&stop_signals, &sig);
+        aes_shm_service_stop(&svc);
+        return 0;
+    }
+
     // Parse command line arguments
     if (argc < 3)
         usage(1);
 
+    // --rekey takes both key files, leaving VECTOR_FILE as the only positional argument
+    char* key_file = NULL;
+    int num_positional = 2;
+    for (int i = 1; i < argc - 1; i++)
+        if (!strcmp(argv[i], "--rekey"))
+            num_positional = 1;
+
+    // Start from this host's profile, if there is one; the options below override it
+    for (int i = 1; i < argc - num_positional; i++) {
+        if (!strcmp(argv[i], "--profile") && i + 1 < argc - num_positional)
+            profile_file = argv[++i];
+        else if (!strcmp(argv[i], "--no-profile"))
+            use_profile = false;
+    }
+    if (use_profile) {
+        if (profile_file) {
+            if (aes_profile_load(profile_file, &profile) != 0) {
+                fprintf(stderr, "Error: failed to load profile %s\n", profile_file);
+                exit(1);
+            }
+        } else if (aes_profile_default_path(profile_path, sizeof(profile_path)) == 0 &&
+                aes_profile_load(profile_path, &profile) < 0) {
+            exit(1);
+        }
+    }
+    Aes_io_opts io_opts = profile.io;
+    int interleave = profile.interleave;
+
     char arg[BUFSIZ];
-    for (int i = 1; i < argc - 2; i++) {
+    for (int i = 1; i < argc - num_positional; i++) {
         arg[0] = '\0';
         strcpy(arg, argv[i]);
         if (!strcmp(arg, "-u") || !strcmp(arg, "--usage") || 
@@ -30,26 +153,186 @@ int main (int argc, char *argv[]) {
             else if (!strcmp(arg, "OFB")) op_mode = OFB;
             else if (!strcmp(arg, "CTR")) op_mode = CTR;
             else usage(1);
+        } else if (!strcmp(arg, "--segment")) {
+            segment = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--iv")) {
+            iv_file = argv[++i];
+        } else if (!strcmp(arg, "--mac")) {
+            do_mac = true;
+            arg[0] = '\0';
+            strcpy(arg, argv[++i]);
+            if (!strcmp(arg, "cmac")) mac_type = CMAC;
+            else if (!strcmp(arg, "pmac")) mac_type = PMAC;
+            else usage(1);
+        } else if (!strcmp(arg, "--rekey")) {
+            key_file = argv[++i];
+            rekey_new = argv[++i];
+        } else if (!strcmp(arg, "--new-iv")) {
+            new_iv_file = argv[++i];
+        } else if (!strcmp(arg, "--incremental")) {
+            incremental = true;
+        } else if (!strcmp(arg, "--hex")) {
+            hex_input = true;
+        } else if (!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+            out_file = argv[++i];
+        } else if (!strcmp(arg, "--io")) {
+            arg[0] = '\0';
+            strcpy(arg, argv[++i]);
+            if (!strcmp(arg, "uring")) io_opts.backend = IO_URING;
+            else if (!strcmp(arg, "threads")) io_opts.backend = IO_THREADS;
+            else if (!strcmp(arg, "afalg")) io_opts.backend = IO_AF_ALG;
+            else usage(1);
+        } else if (!strcmp(arg, "--threads")) {
+            io_opts.num_threads = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--chunk")) {
+            io_opts.chunk_size = delta_chunk = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(arg, "--depth")) {
+            io_opts.queue_depth = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--interleave")) {
+            interleave = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--isa")) {
+            int isa = aes_isa_parse(argv[++i]);
+            if (isa < 0)
+                usage(1);
+            aes_isa_select((Aes_isa)isa);
+        } else if (!strcmp(arg, "--profile") || !strcmp(arg, "--no-profile")) {
+            // Already applied before parsing
+            i += !strcmp(arg, "--profile");
+        } else if (!strcmp(arg, "--no-numa")) {
+            io_opts.numa = false;
+        } else if (!strcmp(arg, "--metrics")) {
+            metrics_file = argv[++i];
+        } else if (!strcmp(arg, "--progress")) {
+            progress = true;
         } else {
             usage(1);
         }
     }
 
-    char* key_file = argv[argc - 2];
+    if (io_opts.chunk_size < 16 || io_opts.chunk_size > AES_IO_MAX_CHUNK || interleave < 1)
+        usage(1);
+    if (incremental && (!out_file || hex_input || do_mac))
+        usage(1);
+    if ((rekey_new && (!out_file || hex_input || do_mac || incremental)) ||
+            (new_iv_file && !rekey_new))
+        usage(1);
+    aes_set_interleave(interleave);
+
+    // CFB is the only mode with a segment size
+    if (segment != 128) {
+        if (op_mode != CFB || (segment != 8 && segment != 1))
+            usage(1);
+        op_mode = segment == 8 ? CFB8 : CFB1;
+    }
+
+    if (!key_file)
+        key_file = argv[argc - 2];
     char* vector_file = argv[argc - 1];
 
      
     uint8_t* key  = malloc(sizeof(uint8_t) * (32 + 1));
 
     int len_key = read_key(key_file, key);
+    if (len_key < 0) {
+        free(key);
+        exit(1);
+    }
+
+    if ((metrics_file || progress) && metrics_start_exporter(metrics_file, progress, 0) < 0)
+        exit(1);
 
     uint8_t* ekey = malloc(sizeof(uint8_t) * 240);
     expand_key(key, len_key, ekey);
 
+    // Authenticate instead of encrypting, printing the tag as hex
+    if (do_mac) {
+        uint8_t tag[16];
+        int ret = aes_mac_file(vector_file, mac_type, ekey, len_key, tag, io_opts.num_threads);
+        metrics_stop_exporter();
+        if (ret == 0) {
+            for (int i = 0; i < 16; i++)
+                printf("%.2x", tag[i]);
+            printf("\n");
+        }
+        free(key);
+        free(ekey);
+        return ret == 0 ? 0 : 1;
+    }
+
+    // Update a chunked container, re-encrypting only the chunks that changed,
+    // or decrypt one
+    if (incremental) {
+        Aes_delta_stats stats;
+        int ret = is_encrypt
+            ? aes_delta_encrypt(vector_file, out_file, ekey, len_key, delta_chunk, &stats)
+            : aes_delta_decrypt(vector_file, out_file, ekey, len_key);
+        metrics_stop_exporter();
+        if (ret == 0 && is_encrypt)
+            printf("Re-encrypted %lu of %lu chunks, %lu bytes\n", stats.changed,
+                    stats.num_chunks, stats.bytes_written);
+        free(key);
+        free(ekey);
+        return ret == 0 ? 0 : 1;
+    }
+
+    // Chaining modes start from the IV file if given, otherwise an all-zero IV
+    uint8_t iv[32 + 1] = {0};
+    if (iv_file && read_key(iv_file, iv) != 16) {
+        fprintf(stderr, "Error: IV must be 16 bytes\n");
+        exit(1);
+    }
+
+    // Rotate to the new key in one pass, re-encrypting each chunk as soon as it
+    // is decrypted; the new IV defaults to the old one
+    if (rekey_new) {
+        uint8_t new_key[32 + 1], new_ekey[240];
+        uint8_t new_iv[32 + 1] = {0};
+        memcpy(new_iv, iv, 16);
+        int new_len_key = read_key(rekey_new, new_key);
+        if (new_len_key < 0)
+            exit(1);
+        if (new_iv_file && read_key(new_iv_file, new_iv) != 16) {
+            fprintf(stderr, "Error: IV must be 16 bytes\n");
+            exit(1);
+        }
+        expand_key(new_key, new_len_key, new_ekey);
+        int ret = aes_file_rekey(vector_file, out_file, op_mode, ekey, len_key, iv, new_ekey,
+                new_len_key, new_iv, &io_opts);
+        metrics_stop_exporter();
+        memset(new_key, 0, sizeof(new_key));
+        memset(new_ekey, 0, sizeof(new_ekey));
+        free(key);
+        free(ekey);
+        return ret == 0 ? 0 : 1;
+    }
+
+    // With an output file, stream through the asynchronous pipeline instead
+    // of reading the whole vector into memory
+    if (out_file && !hex_input) {
+        int ret = aes_file_pipeline(vector_file, out_file, op_mode, ekey, len_key, iv,
+                is_encrypt, &io_opts);
+        metrics_stop_exporter();
+        free(key);
+        free(ekey);
+        return ret == 0 ? 0 : 1;
+    }
+
     uint64_t *len_vector = malloc(sizeof(uint64_t));
     *len_vector = 0;
 
-    uint8_t* vector = read_vector(vector_file, len_vector, is_encrypt);
+    uint8_t* vector;
+    if (hex_input) {
+        int err;
+        vector = hex_read_file(vector_file, len_vector, &err);
+        if (!vector) {
+            fprintf(stderr, "Error: %s: %s\n", vector_file, hex_strerror(err));
+            exit(1);
+        }
+        if (is_encrypt)
+            *len_vector = pad_vector(vector, *len_vector);
+    } else {
+        vector = read_vector(vector_file, len_vector, is_encrypt);
+    }
     //printf("len_vector = %ld\n", *len_vector);
     
     //char buffer[*len_vector*BUFSIZ];
@@ -63,21 +346,23 @@ int main (int argc, char *argv[]) {
     //for (uint64_t i = 0; i < *len_vector; i++)
         //printf("vector[%ld] = %.2x\n", i, vector[i]);
     
-    // TODO: finish implementing non ECB modes
-
-    // Use encryption mode for decryption for these modes
-    if (op_mode == CFB || op_mode == OFB || op_mode == CTR)
-        is_encrypt = true;
-     
-    for (uint64_t i = 0; i < *len_vector / 16; i++) {
-        //printf("aes loop count = %ld\n", i);
-        aes(state, ekey, len_key, is_encrypt);
-        state += 16;
-    }
+    metrics_expect(*len_vector);
+    aes_mode(op_mode, state, *len_vector, ekey, len_key, iv, is_encrypt);
+    metrics_stop_exporter();
 
     //print_uint8_t_array(vector, *len_vector, buffer);
     //printf("%s", buffer);
 
+    if (out_file) {
+        int64_t len_out = is_encrypt ? (int64_t)*len_vector : unpad_vector(vector, *len_vector);
+        FILE* f = fopen(out_file, "wb");
+        if (len_out < 0 || !f || fwrite(vector, 1, len_out, f) != (uint64_t)len_out) {
+            fprintf(stderr, "Error: failed to write %s\n", out_file);
+            exit(1);
+        }
+        fclose(f);
+    }
+
     free(len_vector);
     free(key);
     free(ekey);
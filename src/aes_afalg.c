@@ -0,0 +1,364 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_afalg.c
+ *
+ * Description:
+ *   AF_ALG skcipher backend for file encryption.
+ *
+ * Details:
+ *   A transform socket is bound to "ecb(aes)", "cbc(aes)" or "ctr(aes)" and
+ *   keyed once. The cipher key is the first len_key bytes of the expanded
+ *   key, since the schedule starts with the key itself. Each chunk is then
+ *   one operation on the accepted operation socket:
+ *     1. sendmsg() sets the direction and IV, with MSG_MORE;
+ *     2. the chunk is spliced from the input file through a pipe into the
+ *        socket, straight from the page cache;
+ *     3. read() collects the result;
+ *     4. vmsplice() and splice() move the result to the output file.
+ *
+ *   Each chunk carries its own IV rather than relying on the kernel to chain
+ *   between operations. CTR advances the counter by the chunk's blocks. CBC
+ *   encryption continues from the last ciphertext block just read back. CBC
+ *   decryption continues from the last input block, which is fetched with a
+ *   16-byte pread() since the chunk itself never reaches userspace.
+ *
+ *   Chunks are limited to AFALG_MAX_CHUNK, the amount the kernel buffers
+ *   for an operation before it has to be read back. The final chunk is read
+ *   into memory and sent with send(), because it may need PKCS#7 padding
+ *   added on encryption; on decryption its padding is checked and stripped.
+ * -----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include "../include/aes_afalg.h"
+#include "../include/aes_metrics.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/if_alg.h>
+
+#ifndef SOL_ALG
+#define SOL_ALG 279
+#endif
+
+static const char* alg_name(Op_mode op_mode) {
+    switch (op_mode) {
+        case ECB: return "ecb(aes)";
+        case CBC: return "cbc(aes)";
+        case CTR: return "ctr(aes)";
+        default:  return NULL;
+    }
+}
+
+/**
+ * @brief Open a transform socket for the mode. Returns the socket, or -1 if
+ *        AF_ALG or the algorithm is not available.
+ */
+static int afalg_bind(Op_mode op_mode) {
+    const char* name = alg_name(op_mode);
+    if (!name)
+        return -1;
+
+    int tfm_fd = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (tfm_fd < 0)
+        return -1;
+
+    struct sockaddr_alg sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.salg_family = AF_ALG;
+    strcpy((char*)sa.salg_type, "skcipher");
+    strcpy((char*)sa.salg_name, name);
+    if (bind(tfm_fd, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+        close(tfm_fd);
+        return -1;
+    }
+    return tfm_fd;
+}
+
+/**
+ * @brief Start an operation: set the direction and, except for ECB, the IV.
+ */
+static int send_op(int op_fd, bool is_encrypt, const uint8_t* iv) {
+    char control[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct af_alg_iv) + 16)];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = iv ? sizeof(control) : CMSG_SPACE(sizeof(uint32_t));
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_OP;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    uint32_t op = is_encrypt ? ALG_OP_ENCRYPT : ALG_OP_DECRYPT;
+    memcpy(CMSG_DATA(cmsg), &op, sizeof(op));
+
+    if (iv) {
+        cmsg = CMSG_NXTHDR(&msg, cmsg);
+        cmsg->cmsg_level = SOL_ALG;
+        cmsg->cmsg_type = ALG_SET_IV;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + 16);
+        struct af_alg_iv* alg_iv = (struct af_alg_iv*)CMSG_DATA(cmsg);
+        alg_iv->ivlen = 16;
+        memcpy(alg_iv->iv, iv, 16);
+    }
+
+    return sendmsg(op_fd, &msg, MSG_MORE) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Move len bytes at offset of in_fd into the operation through the
+ *        pipe, without copying them through userspace.
+ */
+static int splice_in(int in_fd, loff_t offset, int* pipe_fd, int op_fd, uint64_t len) {
+    while (len > 0) {
+        ssize_t n = splice(in_fd, &offset, pipe_fd[1], NULL, len, SPLICE_F_MOVE);
+        if (n <= 0)
+            return -1;
+        len -= n;
+        for (ssize_t left = n; left > 0; ) {
+            unsigned int flags = SPLICE_F_MOVE | (len > 0 ? SPLICE_F_MORE : 0);
+            ssize_t m = splice(pipe_fd[0], NULL, op_fd, NULL, left, flags);
+            if (m <= 0)
+                return -1;
+            left -= m;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Append len bytes of buf to out_fd by mapping them into the pipe.
+ */
+static int vmsplice_out(uint8_t* buf, uint64_t len, int* pipe_fd, int out_fd) {
+    while (len > 0) {
+        struct iovec iov = { buf, len };
+        ssize_t n = vmsplice(pipe_fd[1], &iov, 1, 0);
+        if (n <= 0)
+            return -1;
+        for (ssize_t left = n; left > 0; ) {
+            ssize_t m = splice(pipe_fd[0], NULL, out_fd, NULL, left, SPLICE_F_MOVE);
+            if (m <= 0)
+                return -1;
+            left -= m;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, uint8_t* buf, uint64_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int pread_full(int fd, uint8_t* buf, uint64_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, offset);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run every chunk of the file through the operation socket.
+ */
+static int afalg_run(int in_fd, int out_fd, int op_fd, int* pipe_fd, uint64_t in_size,
+        Op_mode op_mode, uint8_t* iv, bool is_encrypt, uint64_t chunk_size) {
+    uint8_t* buf;
+    if (posix_memalign((void**)&buf, 4096, chunk_size + 16)) {
+        fprintf(stderr, "Error: failed to allocate chunk buffer\n");
+        return -1;
+    }
+
+    uint8_t chain[16];
+    memcpy(chain, iv, 16);
+    int ret = 0;
+
+    for (uint64_t offset = 0; ; ) {
+        uint64_t remaining = in_size - offset;
+        // Encryption always ends with a chunk, possibly empty, to carry the padding
+        bool last = is_encrypt ? remaining < chunk_size : remaining <= chunk_size;
+        uint64_t len = last ? remaining : chunk_size;
+        uint64_t start = metrics_now_ns();
+
+        uint8_t next_chain[16];
+        if (send_op(op_fd, is_encrypt, op_mode == ECB ? NULL : chain) < 0) {
+            ret = -1;
+            break;
+        }
+        if (!last) {
+            if (op_mode == CBC && !is_encrypt && pread_full(in_fd, next_chain, 16, offset + len - 16) < 0) {
+                ret = -1;
+                break;
+            }
+            if (splice_in(in_fd, offset, pipe_fd, op_fd, len) < 0) {
+                ret = -1;
+                break;
+            }
+        } else {
+            if (pread_full(in_fd, buf, len, offset) < 0) {
+                ret = -1;
+                break;
+            }
+            if (is_encrypt)
+                len = pad_vector(buf, len);
+            if ((uint64_t)send(op_fd, buf, len, 0) != len) {
+                ret = -1;
+                break;
+            }
+        }
+
+        if (read_full(op_fd, buf, len) < 0) {
+            ret = -1;
+            break;
+        }
+        metrics_record(op_mode, len, start);
+
+        if (op_mode == CTR)
+            ctr_add(chain, len / 16);
+        else if (op_mode == CBC)
+            memcpy(chain, is_encrypt ? buf + len - 16 : next_chain, 16);
+
+        uint64_t len_out = len;
+        if (last && !is_encrypt) {
+            int64_t unpadded = unpad_vector(buf, len);
+            if (unpadded < 0) {
+                fprintf(stderr, "Error: invalid padding in final block\n");
+                ret = -1;
+                break;
+            }
+            len_out = unpadded;
+        }
+        if (vmsplice_out(buf, len_out, pipe_fd, out_fd) < 0) {
+            ret = -1;
+            break;
+        }
+
+        if (last)
+            break;
+        offset += len;
+    }
+
+    free(buf);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Check whether the kernel offers AF_ALG and an AES transform for the mode.
+ */
+bool aes_afalg_available(Op_mode op_mode) {
+    int tfm_fd = afalg_bind(op_mode);
+    if (tfm_fd < 0)
+        return false;
+    close(tfm_fd);
+    return true;
+}
+
+/**
+ * @brief Encrypt or decrypt in_file into out_file through the kernel crypto
+ *        API. Returns 0 on success, -1 on error.
+ */
+int aes_afalg_file(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt, uint64_t chunk_size) {
+    if (!alg_name(op_mode)) {
+        fprintf(stderr, "Error: the AF_ALG backend supports ECB, CBC and CTR\n");
+        return -1;
+    }
+
+    int tfm_fd = afalg_bind(op_mode);
+    if (tfm_fd < 0) {
+        fprintf(stderr, "Error: AF_ALG is not available\n");
+        return -1;
+    }
+    if (setsockopt(tfm_fd, SOL_ALG, ALG_SET_KEY, ekey, len_key) < 0) {
+        fprintf(stderr, "Error: AF_ALG rejected the key\n");
+        close(tfm_fd);
+        return -1;
+    }
+    int op_fd = accept4(tfm_fd, NULL, 0, SOCK_CLOEXEC);
+    close(tfm_fd);
+    if (op_fd < 0) {
+        fprintf(stderr, "Error: failed to start an AF_ALG operation\n");
+        return -1;
+    }
+
+    int in_fd = open(in_file, O_RDONLY);
+    struct stat st;
+    if (in_fd < 0 || fstat(in_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: failed to open %s\n", in_file);
+        if (in_fd >= 0)
+            close(in_fd);
+        close(op_fd);
+        return -1;
+    }
+    uint64_t in_size = st.st_size;
+    if (!is_encrypt && (in_size == 0 || in_size % 16 != 0)) {
+        fprintf(stderr, "Error: ciphertext length %lu is not a multiple of 16\n", in_size);
+        close(in_fd);
+        close(op_fd);
+        return -1;
+    }
+
+    int out_fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", out_file);
+        close(in_fd);
+        close(op_fd);
+        return -1;
+    }
+
+    int pipe_fd[2];
+    if (pipe2(pipe_fd, O_CLOEXEC) < 0) {
+        fprintf(stderr, "Error: failed to create pipe\n");
+        close(in_fd);
+        close(out_fd);
+        close(op_fd);
+        return -1;
+    }
+
+    // A chunk has to fit in both the pipe and the kernel's operation buffer
+    chunk_size &= ~(uint64_t)15;
+    if (chunk_size == 0 || chunk_size > AFALG_MAX_CHUNK)
+        chunk_size = AFALG_MAX_CHUNK;
+    int pipe_size = fcntl(pipe_fd[1], F_SETPIPE_SZ, (int)chunk_size);
+    if (pipe_size > 0 && (uint64_t)pipe_size < chunk_size)
+        chunk_size = pipe_size & ~15;
+
+    Metrics_backend caller_backend = metrics_get_backend();
+    metrics_set_backend(METRICS_AF_ALG);
+    metrics_expect(in_size);
+
+    int ret = afalg_run(in_fd, out_fd, op_fd, pipe_fd, in_size, op_mode, iv, is_encrypt,
+            chunk_size);
+    if (ret < 0)
+        fprintf(stderr, "Error: AF_ALG operation failed\n");
+
+    metrics_set_backend(caller_backend);
+    close(pipe_fd[0]);
+    close(pipe_fd[1]);
+    close(in_fd);
+    close(op_fd);
+    if (close(out_fd) < 0)
+        ret = -1;
+    return ret;
+}
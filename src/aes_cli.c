@@ -0,0 +1,100 @@
+#include "../include/aes_funcs.h"
+
+void usage(int exit_code) {
+    if (exit_code != 0)
+        printf("Invalid input\n");
+    printf("USAGE: aes [OPTIONS] [KEY_FILE] [VECTOR_FILE]\n");
+    printf("  -e | -d                   Encrypt (default) or decrypt\n");
+    printf("  -m | --mode MODE          ECB, CBC, CFB, OFB or CTR\n");
+    printf("  --segment 1|8|128         CFB segment size in bits (default 128)\n");
+    printf("  --iv IV_FILE              Hex IV for chaining modes (default all zero)\n");
+    printf("  --hex                     VECTOR_FILE is hex text rather than binary\n");
+    printf("  -o | --output FILE        Stream the result to FILE\n");
+    printf("  --io uring|threads|afalg  I/O engine for --output (default uring if available);\n");
+    printf("                            afalg uses the kernel cipher for ECB, CBC and CTR\n");
+    printf("  --threads N               Worker threads for --output and --mac pmac\n");
+    printf("  --chunk BYTES             Chunk size for --output\n");
+    printf("  --depth N                 Chunks in flight for --output\n");
+    printf("  --interleave 1|4|8        Blocks ciphered together\n");
+    printf("  --isa baseline|ssse3|avx2|avx512\n");
+    printf("                            Highest instruction set tier the kernels may use\n");
+    printf("                            (default the best this CPU has, or $AES_ISA)\n");
+    printf("  --no-numa                 Do not pin --output workers to NUMA nodes\n");
+    printf("  --metrics FILE            Rewrite FILE with Prometheus metrics every second\n");
+    printf("  --progress                Show progress, rate and ETA on stderr\n");
+    printf("  --mac cmac|pmac           Print the MAC of VECTOR_FILE instead of encrypting\n");
+    printf("  --rekey OLD_KEY NEW_KEY   With -o: re-encrypt VECTOR_FILE from OLD_KEY to NEW_KEY\n");
+    printf("                            in one pass; takes the place of KEY_FILE\n");
+    printf("  --new-iv IV_FILE          IV under NEW_KEY (default the --iv IV)\n");
+    printf("  --incremental             With -o: keep FILE as a chunked CTR container and\n");
+    printf("                            re-encrypt only the chunks that changed; with -d,\n");
+    printf("                            decrypt such a container (--chunk sets its chunk size)\n");
+    printf("  --profile FILE            Tuning profile (default ~/.config/aes/HOST.profile)\n");
+    printf("  --no-profile              Ignore the tuning profile\n");
+    printf("USAGE: aes --autotune [--profile FILE]\n");
+    printf("  Time this host's backends and settings and save the fastest as its profile;\n");
+    printf("  the options above override the profile on each run\n");
+    printf("USAGE: aes --serve NAME [--threads N] [--area BYTES] KEY_FILE...\n");
+    printf("  Serve the keys, numbered from 0, to local clients through the shared\n");
+    printf("  memory region NAME until interrupted; --area is payload bytes per client\n");
+    exit(exit_code);
+}
+
+uint8_t* read_vector(char* vector_file, uint64_t* size, bool is_encrypt) {
+    
+    FILE* f = fopen(vector_file, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: failed to open %s\n", vector_file);
+        exit(1);
+    }
+    
+    uint64_t capacity = BUFSIZ * sizeof(uint8_t);
+    uint8_t* vector = malloc(capacity);
+    
+    // Unknown file size, so read in bulk and grow the buffer exponentially,
+    // always keeping room for up to 16 bytes of padding at the end
+    size_t n;
+    while ((n = fread(vector + *size, 1, capacity - 16 - *size, f)) > 0) {
+        *size += n;
+        if (*size + 16 >= capacity) {
+            capacity *= 2;
+            uint8_t* bigger_vector = realloc(vector, capacity);
+            if (!bigger_vector) {
+                fprintf(stderr, "Error: out of memory reading %s\n", vector_file);
+                exit(1);
+            }
+            vector = bigger_vector;
+        }
+    }
+
+    fclose(f);
+
+    /* Pad out to a multiple of 16 bytes with the number of padded bytes 
+     * per the PKCS standard for CBC, only for encryption
+     */
+    if (is_encrypt) {
+        *size = pad_vector(vector, *size);
+
+        // Realloc smaller to fit the exact memory used for the vector
+        uint8_t* smaller_vector = realloc(vector, (*size));
+
+        // TODO: make this less jank
+        if (!smaller_vector)
+            exit(1);
+    
+        vector = smaller_vector;
+    }
+    
+    return vector;
+}
+
+void print_uint8_t_array(uint8_t* arr, int len_arr, char* result) {
+    for (int i = 0; i < len_arr; i++) {
+        if (i % 4 == 0 && i != 0) {
+            sprintf(result, " ");
+            result++;
+        }
+        sprintf(result, "%.2x", arr[i]);
+        result += 2*sizeof(char);
+    }
+}
@@ -0,0 +1,384 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_delta.c
+ *
+ * Description:
+ *   Chunked CTR containers that are updated by re-encrypting only the
+ *   chunks whose plaintext changed.
+ *
+ * Details:
+ *   Layout, all integers little-endian:
+ *     0     "AESDELTA", version (4), flags (4), chunk size (8),
+ *           plaintext length (8), number of chunks (8), key check (16)
+ *     4096  chunk i at 4096 + i*chunk_size; only the last may be short
+ *     then  the table, one entry per chunk: CTR nonce (16), digest (16)
+ *   Chunk offsets do not depend on the number of chunks, so a file that
+ *   grows or shrinks keeps every unchanged chunk where it is; the table is
+ *   rewritten after the last chunk and the file truncated behind it.
+ *
+ *   Digests are PMAC tags of the chunk plaintext under a MAC key derived
+ *   from the cipher key. A PRF is needed here, not just a hash: aes_hash()
+ *   collisions can be built by anyone, so a crafted edit could keep a
+ *   chunk's digest, be skipped, and leave the old plaintext in place
+ *   without decryption noticing. Without the key a tag can neither be
+ *   matched nor computed for a guessed plaintext. The key check, derived
+ *   the same way, tells a wrong key apart from a corrupt container.
+ *
+ *   Every rewritten chunk gets a fresh nonce from aes_random_iv(): reusing a
+ *   nonce for a changed chunk would expose the XOR of its old and new
+ *   plaintext. An update in progress is marked dirty in the header; a
+ *   container left dirty by an interrupted update cannot be decrypted, and
+ *   the next update re-encrypts every chunk, as it does for a container
+ *   written by an older version.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_delta.h"
+#include "../include/aes_drbg.h"
+#include "../include/aes_mac.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEADER_LEN 56
+
+typedef struct delta_header {
+    uint32_t version;
+    uint32_t flags;
+    uint64_t chunk_size;
+    uint64_t plain_len;
+    uint64_t num_chunks;
+    uint8_t key_check[16];
+} Delta_header;
+
+/* --------------------------------------------------------------------------
+ * Encoding and I/O Helpers
+ * -------------------------------------------------------------------------- */
+
+static void put_le(uint8_t* dst, uint64_t value, int len) {
+    for (int i = 0; i < len; i++)
+        dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t* src, int len) {
+    uint64_t value = 0;
+    for (int i = len - 1; i >= 0; i--)
+        value = (value << 8) | src[i];
+    return value;
+}
+
+static int pread_full(int fd, uint8_t* buf, uint64_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const uint8_t* buf, uint64_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int write_header(int fd, const Delta_header* h) {
+    uint8_t buf[HEADER_LEN];
+    memcpy(buf, AES_DELTA_MAGIC, 8);
+    put_le(buf + 8, h->version, 4);
+    put_le(buf + 12, h->flags, 4);
+    put_le(buf + 16, h->chunk_size, 8);
+    put_le(buf + 24, h->plain_len, 8);
+    put_le(buf + 32, h->num_chunks, 8);
+    memcpy(buf + 40, h->key_check, 16);
+    return pwrite_full(fd, buf, HEADER_LEN, 0);
+}
+
+/**
+ * @brief Read and sanity-check a container header against the file size.
+ *        Returns 0, or -1 if the file is not a container. The caller checks
+ *        the version.
+ */
+static int read_header(int fd, Delta_header* h) {
+    uint8_t buf[HEADER_LEN];
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < AES_DELTA_DATA_OFFSET ||
+            pread_full(fd, buf, HEADER_LEN, 0) < 0 || memcmp(buf, AES_DELTA_MAGIC, 8))
+        return -1;
+
+    h->version = (uint32_t)get_le(buf + 8, 4);
+    h->flags = (uint32_t)get_le(buf + 12, 4);
+    h->chunk_size = get_le(buf + 16, 8);
+    h->plain_len = get_le(buf + 24, 8);
+    h->num_chunks = get_le(buf + 32, 8);
+    memcpy(h->key_check, buf + 40, 16);
+
+    if (h->version == 0 || h->chunk_size < 16 || h->chunk_size % 16 ||
+            h->chunk_size > AES_DELTA_MAX_CHUNK ||
+            h->num_chunks != (h->plain_len + h->chunk_size - 1) / h->chunk_size ||
+            h->num_chunks > ((uint64_t)st.st_size - AES_DELTA_DATA_OFFSET) / h->chunk_size + 1 ||
+            (uint64_t)st.st_size < AES_DELTA_DATA_OFFSET + h->num_chunks * h->chunk_size +
+                h->num_chunks * AES_DELTA_ENTRY)
+        return -1;
+    return 0;
+}
+
+static uint64_t chunk_len(uint64_t plain_len, uint64_t chunk_size, uint64_t i) {
+    uint64_t rest = plain_len - i * chunk_size;
+    return rest < chunk_size ? rest : chunk_size;
+}
+
+/**
+ * @brief Derive the expanded digest key and the key check value from the
+ *        cipher key.
+ */
+static void derive_keys(uint8_t* ekey, int len_key, uint8_t* mac_ekey, uint8_t* key_check) {
+    uint8_t mac_key[16];
+    memcpy(mac_key, "aes-delta digest", 16);
+    memcpy(key_check, "aes-delta keychk", 16);
+    aes(mac_key, ekey, len_key, true);
+    aes(key_check, ekey, len_key, true);
+    expand_key(mac_key, 16, mac_ekey);
+    memset(mac_key, 0, sizeof(mac_key));
+}
+
+static void chunk_digest(const uint8_t* buf, uint64_t len, uint8_t* mac_ekey, uint8_t* digest) {
+    aes_pmac(buf, len, mac_ekey, 16, digest, 1);
+}
+
+/* --------------------------------------------------------------------------
+ * Update and Decryption
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Bring container up to date with in_file, creating it if it does not
+ *        exist or is empty. Only chunks whose plaintext changed are encrypted
+ *        and written. An existing container keeps its chunk size; chunk_size
+ *        (0 for AES_DELTA_DEFAULT_CHUNK) applies to a new one, and to one
+ *        written under another key or left dirty, which are rewritten in
+ *        full. Returns 0 on success, -1 on error.
+ */
+int aes_delta_encrypt(const char* in_file, const char* container, uint8_t* ekey, int len_key,
+        uint64_t chunk_size, Aes_delta_stats* stats) {
+    int ret = -1;
+    uint8_t mac_ekey[240], key_check[16];
+    uint8_t* old_table = NULL;
+    uint8_t* table = NULL;
+    uint8_t* buf = NULL;
+    memset(stats, 0, sizeof(*stats));
+    derive_keys(ekey, len_key, mac_ekey, key_check);
+
+    if (chunk_size == 0)
+        chunk_size = AES_DELTA_DEFAULT_CHUNK;
+    if (chunk_size < 16 || chunk_size % 16 || chunk_size > AES_DELTA_MAX_CHUNK) {
+        fprintf(stderr, "Error: chunk size must be a multiple of 16 up to %d\n",
+                AES_DELTA_MAX_CHUNK);
+        return -1;
+    }
+
+    int in_fd = open(in_file, O_RDONLY);
+    if (in_fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", in_file);
+        return -1;
+    }
+    int fd = open(container, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", container);
+        close(in_fd);
+        return -1;
+    }
+
+    // Take over the chunk size and table of a clean container of this version
+    // under this key
+    Delta_header old = {0};
+    struct stat st;
+    if (fstat(in_fd, &st) < 0) {
+        fprintf(stderr, "Error: failed to stat %s\n", in_file);
+        goto out;
+    }
+    if (read_header(fd, &old) == 0) {
+        if (old.version == AES_DELTA_VERSION && !(old.flags & AES_DELTA_DIRTY) &&
+                !memcmp(old.key_check, key_check, 16)) {
+            chunk_size = old.chunk_size;
+            old_table = malloc(old.num_chunks * AES_DELTA_ENTRY + 1);
+            if (!old_table || pread_full(fd, old_table, old.num_chunks * AES_DELTA_ENTRY,
+                    AES_DELTA_DATA_OFFSET + old.num_chunks * old.chunk_size) < 0) {
+                fprintf(stderr, "Error: failed to read the table of %s\n", container);
+                goto out;
+            }
+        } else {
+            old.num_chunks = 0;
+        }
+    } else if (lseek(fd, 0, SEEK_END) != 0) {
+        fprintf(stderr, "Error: %s exists and is not an incremental container\n", container);
+        goto out;
+    }
+
+    Delta_header h = { AES_DELTA_VERSION, AES_DELTA_DIRTY, chunk_size, (uint64_t)st.st_size,
+            ((uint64_t)st.st_size + chunk_size - 1) / chunk_size, {0} };
+    memcpy(h.key_check, key_check, 16);
+    table = calloc(h.num_chunks + 1, AES_DELTA_ENTRY);
+    buf = malloc(chunk_size);
+    if (!table || !buf) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto out;
+    }
+    if (write_header(fd, &h) < 0 || fdatasync(fd) < 0) {
+        fprintf(stderr, "Error: failed to write %s\n", container);
+        goto out;
+    }
+
+    stats->num_chunks = h.num_chunks;
+    for (uint64_t i = 0; i < h.num_chunks; i++) {
+        uint64_t len = chunk_len(h.plain_len, chunk_size, i);
+        uint8_t* entry = table + i * AES_DELTA_ENTRY;
+        if (pread_full(in_fd, buf, len, i * chunk_size) < 0) {
+            fprintf(stderr, "Error: failed to read %s\n", in_file);
+            goto out;
+        }
+        chunk_digest(buf, len, mac_ekey, entry + 16);
+
+        // Unchanged when it was there before with the same length and digest
+        if (i < old.num_chunks && len == chunk_len(old.plain_len, chunk_size, i) &&
+                !memcmp(old_table + i * AES_DELTA_ENTRY + 16, entry + 16, 16)) {
+            memcpy(entry, old_table + i * AES_DELTA_ENTRY, 16);
+            continue;
+        }
+
+        uint8_t iv[16];
+        if (aes_random_iv(entry) < 0) {
+            fprintf(stderr, "Error: failed to generate a nonce\n");
+            goto out;
+        }
+        memcpy(iv, entry, 16);
+        aes_mode(CTR, buf, len, ekey, len_key, iv, true);
+        if (pwrite_full(fd, buf, len, AES_DELTA_DATA_OFFSET + i * chunk_size) < 0) {
+            fprintf(stderr, "Error: failed to write %s\n", container);
+            goto out;
+        }
+        stats->changed++;
+        stats->bytes_written += len;
+    }
+
+    uint64_t table_offset = AES_DELTA_DATA_OFFSET + h.num_chunks * chunk_size;
+    h.flags = 0;
+    if (pwrite_full(fd, table, h.num_chunks * AES_DELTA_ENTRY, table_offset) < 0 ||
+            ftruncate(fd, (off_t)(table_offset + h.num_chunks * AES_DELTA_ENTRY)) < 0 ||
+            fdatasync(fd) < 0 || write_header(fd, &h) < 0) {
+        fprintf(stderr, "Error: failed to write %s\n", container);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    if (buf)
+        memset(buf, 0, chunk_size);
+    free(buf);
+    free(table);
+    free(old_table);
+    memset(mac_ekey, 0, sizeof(mac_ekey));
+    close(in_fd);
+    close(fd);
+    return ret;
+}
+
+/**
+ * @brief Decrypt a container to out_file, checking every chunk against its
+ *        digest. Returns 0 on success, -1 on error.
+ */
+int aes_delta_decrypt(const char* container, const char* out_file, uint8_t* ekey, int len_key) {
+    int ret = -1;
+    uint8_t mac_ekey[240], key_check[16], digest[16];
+    uint8_t* table = NULL;
+    uint8_t* buf = NULL;
+    derive_keys(ekey, len_key, mac_ekey, key_check);
+
+    int fd = open(container, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", container);
+        return -1;
+    }
+    int out_fd = -1;
+
+    Delta_header h = {0};
+    if (read_header(fd, &h) < 0) {
+        fprintf(stderr, "Error: %s is not an incremental container\n", container);
+        goto out;
+    }
+    if (h.version != AES_DELTA_VERSION) {
+        fprintf(stderr, "Error: %s is from an older version, update it to rewrite it\n", container);
+        goto out;
+    }
+    if (h.flags & AES_DELTA_DIRTY) {
+        fprintf(stderr, "Error: %s: an update was interrupted, run it again\n", container);
+        goto out;
+    }
+    if (memcmp(h.key_check, key_check, 16)) {
+        fprintf(stderr, "Error: %s was written under a different key\n", container);
+        goto out;
+    }
+
+    table = malloc(h.num_chunks * AES_DELTA_ENTRY + 1);
+    buf = malloc(h.chunk_size);
+    if (!table || !buf || pread_full(fd, table, h.num_chunks * AES_DELTA_ENTRY,
+            AES_DELTA_DATA_OFFSET + h.num_chunks * h.chunk_size) < 0) {
+        fprintf(stderr, "Error: failed to read the table of %s\n", container);
+        goto out;
+    }
+
+    out_fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", out_file);
+        goto out;
+    }
+
+    for (uint64_t i = 0; i < h.num_chunks; i++) {
+        uint64_t len = chunk_len(h.plain_len, h.chunk_size, i);
+        uint8_t* entry = table + i * AES_DELTA_ENTRY;
+        uint8_t iv[16];
+        if (pread_full(fd, buf, len, AES_DELTA_DATA_OFFSET + i * h.chunk_size) < 0) {
+            fprintf(stderr, "Error: failed to read %s\n", container);
+            goto out;
+        }
+        memcpy(iv, entry, 16);
+        aes_mode(CTR, buf, len, ekey, len_key, iv, false);
+        chunk_digest(buf, len, mac_ekey, digest);
+        if (memcmp(digest, entry + 16, 16)) {
+            fprintf(stderr, "Error: %s: chunk %lu is corrupt\n", container, i);
+            goto out;
+        }
+        if (pwrite_full(out_fd, buf, len, i * h.chunk_size) < 0) {
+            fprintf(stderr, "Error: failed to write %s\n", out_file);
+            goto out;
+        }
+    }
+    ret = 0;
+
+out:
+    if (buf)
+        memset(buf, 0, h.chunk_size);
+    free(buf);
+    free(table);
+    memset(mac_ekey, 0, sizeof(mac_ekey));
+    if (out_fd >= 0)
+        close(out_fd);
+    close(fd);
+    return ret;
+}
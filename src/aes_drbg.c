@@ -0,0 +1,275 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_drbg.c
+ *
+ * Description:
+ *   CTR_DRBG mechanism and the per-thread generator built on it.
+ *
+ * Details:
+ *   Follows SP 800-90A section 10.2.1 for AES-256 with a 128-bit counter
+ *   and no derivation function, so entropy input is a full 48-byte seed
+ *   and any personalization or additional input is at most 48 bytes. Key
+ *   is kept in expanded form. Since the first 32 bytes of an AES-256
+ *   schedule are the key itself, the schedule is all the state there is.
+ *
+ *   Each Generate and Update encrypts V+1, V+2, ...: V is stepped once in
+ *   place and handed to aes_ctr() over a zeroed buffer. aes_ctr() leaves it
+ *   one past the last counter used, so stepping it back gives the new V.
+ *
+ *   The per-thread generator keeps a _Thread_local instance, seeded from
+ *   getrandom() on first use and again every AES_DRBG_RESEED_INTERVAL
+ *   requests. A pthread_atfork() handler bumps a generation number, which
+ *   makes a forked child reseed instead of repeating the parent's output.
+ *   Requests up to AES_DRBG_BATCH/16 bytes are copied out of a batch
+ *   generated AES_DRBG_BATCH bytes at a time, and the copied bytes are
+ *   wiped from the batch. Larger requests are generated straight into the
+ *   caller's buffer.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_drbg.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/random.h>
+
+/* --------------------------------------------------------------------------
+ * Mechanism
+ * -------------------------------------------------------------------------- */
+
+static void ctr_decrement(uint8_t* counter) {
+    for (int i = 15; i >= 0; i--)
+        if (counter[i]-- != 0)
+            break;
+}
+
+/**
+ * @brief Fill out with E(Key, V+1) || E(Key, V+2) || ... and advance V to the
+ *        last counter used.
+ */
+static void drbg_blocks(Aes_drbg* drbg, uint8_t* out, uint64_t len) {
+    memset(out, 0, len);
+    ctr_increment(drbg->v);
+    aes_ctr(out, len, drbg->ekey, 32, drbg->v);
+    ctr_decrement(drbg->v);
+}
+
+/**
+ * @brief CTR_DRBG_Update: derive the next Key and V, mixing in up to
+ *        AES_DRBG_SEED_LEN bytes of provided data.
+ */
+static void drbg_update(Aes_drbg* drbg, const uint8_t* data, int len_data) {
+    uint8_t temp[AES_DRBG_SEED_LEN];
+    drbg_blocks(drbg, temp, AES_DRBG_SEED_LEN);
+    for (int i = 0; i < len_data; i++)
+        temp[i] ^= data[i];
+
+    expand_key(temp, 32, drbg->ekey);
+    memcpy(drbg->v, temp + 32, 16);
+    memset(temp, 0, sizeof(temp));
+}
+
+/**
+ * @brief Instantiate from AES_DRBG_SEED_LEN bytes of full-entropy input and an
+ *        optional personalization string. Returns 0, or -1 if the
+ *        personalization string is too long.
+ */
+int aes_drbg_instantiate(Aes_drbg* drbg, const uint8_t* entropy, const uint8_t* personal,
+        int len_personal) {
+    if (len_personal < 0 || len_personal > AES_DRBG_SEED_LEN)
+        return -1;
+
+    uint8_t seed[AES_DRBG_SEED_LEN];
+    memcpy(seed, entropy, AES_DRBG_SEED_LEN);
+    for (int i = 0; i < len_personal; i++)
+        seed[i] ^= personal[i];
+
+    uint8_t zero_key[32] = {0};
+    expand_key(zero_key, 32, drbg->ekey);
+    memset(drbg->v, 0, 16);
+    drbg_update(drbg, seed, AES_DRBG_SEED_LEN);
+    drbg->reseed_counter = 1;
+
+    memset(seed, 0, sizeof(seed));
+    return 0;
+}
+
+/**
+ * @brief Reseed from AES_DRBG_SEED_LEN bytes of full-entropy input and
+ *        optional additional input. Returns 0, or -1 if the additional input
+ *        is too long.
+ */
+int aes_drbg_reseed(Aes_drbg* drbg, const uint8_t* entropy, const uint8_t* additional,
+        int len_additional) {
+    if (len_additional < 0 || len_additional > AES_DRBG_SEED_LEN)
+        return -1;
+
+    uint8_t seed[AES_DRBG_SEED_LEN];
+    memcpy(seed, entropy, AES_DRBG_SEED_LEN);
+    for (int i = 0; i < len_additional; i++)
+        seed[i] ^= additional[i];
+
+    drbg_update(drbg, seed, AES_DRBG_SEED_LEN);
+    drbg->reseed_counter = 1;
+
+    memset(seed, 0, sizeof(seed));
+    return 0;
+}
+
+/**
+ * @brief Generate up to AES_DRBG_MAX_REQUEST bytes. Returns 0,
+ *        AES_DRBG_RESEED if the instance must be reseeded first, or -1 if
+ *        the request or additional input is too long.
+ */
+int aes_drbg_generate(Aes_drbg* drbg, uint8_t* out, uint64_t len, const uint8_t* additional,
+        int len_additional) {
+    if (len > AES_DRBG_MAX_REQUEST || len_additional < 0 || len_additional > AES_DRBG_SEED_LEN)
+        return -1;
+    if (drbg->reseed_counter > AES_DRBG_RESEED_INTERVAL)
+        return AES_DRBG_RESEED;
+
+    if (len_additional > 0)
+        drbg_update(drbg, additional, len_additional);
+
+    // Whole blocks are generated; a partial last block is truncated
+    uint64_t whole = len / 16 * 16;
+    drbg_blocks(drbg, out, whole);
+    if (whole < len) {
+        uint8_t last[16];
+        drbg_blocks(drbg, last, 16);
+        memcpy(out + whole, last, len - whole);
+        memset(last, 0, sizeof(last));
+    }
+
+    drbg_update(drbg, additional, len_additional);
+    drbg->reseed_counter++;
+    return 0;
+}
+
+/**
+ * @brief Wipe the instance.
+ */
+void aes_drbg_uninstantiate(Aes_drbg* drbg) {
+    memset(drbg, 0, sizeof(*drbg));
+}
+
+/* --------------------------------------------------------------------------
+ * Per-Thread Generator
+ * -------------------------------------------------------------------------- */
+
+typedef struct thread_drbg {
+    Aes_drbg drbg;
+    uint8_t batch[AES_DRBG_BATCH];
+    int batch_pos;              // Bytes of batch already handed out
+    unsigned generation;        // fork_generation when last seeded
+    bool seeded;
+} Thread_drbg;
+
+static _Thread_local Thread_drbg thread_drbg;
+static atomic_uint fork_generation;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void on_fork_child() {
+    atomic_fetch_add(&fork_generation, 1);
+}
+
+static void register_atfork() {
+    pthread_atfork(NULL, NULL, on_fork_child);
+}
+
+static int get_entropy(uint8_t* buf, int len) {
+    for (int done = 0; done < len; ) {
+        ssize_t n = getrandom(buf + done, len - done, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            fprintf(stderr, "Error: getrandom failed\n");
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief The calling thread's instance, seeded and ready to generate, or NULL
+ *        if no entropy is available.
+ */
+static Thread_drbg* thread_instance() {
+    Thread_drbg* t = &thread_drbg;
+    pthread_once(&atfork_once, register_atfork);
+    unsigned generation = atomic_load(&fork_generation);
+
+    if (!t->seeded || t->generation != generation ||
+            t->drbg.reseed_counter > AES_DRBG_RESEED_INTERVAL) {
+        uint8_t entropy[AES_DRBG_SEED_LEN];
+        if (get_entropy(entropy, AES_DRBG_SEED_LEN) < 0)
+            return NULL;
+        if (t->seeded && t->generation == generation)
+            aes_drbg_reseed(&t->drbg, entropy, NULL, 0);
+        else
+            aes_drbg_instantiate(&t->drbg, entropy, NULL, 0);
+        memset(entropy, 0, sizeof(entropy));
+
+        // Anything batched before a fork is the parent's
+        memset(t->batch, 0, AES_DRBG_BATCH);
+        t->batch_pos = AES_DRBG_BATCH;
+        t->generation = generation;
+        t->seeded = true;
+    }
+    return t;
+}
+
+/**
+ * @brief Generate from the calling thread's instance, reseeding it when due.
+ */
+static int thread_generate(uint8_t* out, uint64_t len) {
+    for (;;) {
+        Thread_drbg* t = thread_instance();
+        if (!t)
+            return -1;
+        int ret = aes_drbg_generate(&t->drbg, out, len, NULL, 0);
+        if (ret != AES_DRBG_RESEED)
+            return ret;
+    }
+}
+
+/**
+ * @brief Fill out with len random bytes from the calling thread's generator.
+ *        Returns 0, or -1 if it could not be seeded.
+ */
+int aes_random_bytes(uint8_t* out, uint64_t len) {
+    Thread_drbg* t = thread_instance();
+    if (!t)
+        return -1;
+
+    if (len <= AES_DRBG_BATCH / 16) {
+        if (t->batch_pos + len > AES_DRBG_BATCH) {
+            if (thread_generate(t->batch, AES_DRBG_BATCH) < 0)
+                return -1;
+            t->batch_pos = 0;
+        }
+        memcpy(out, t->batch + t->batch_pos, len);
+        memset(t->batch + t->batch_pos, 0, len);
+        t->batch_pos += len;
+        return 0;
+    }
+
+    while (len > 0) {
+        uint64_t n = len < AES_DRBG_MAX_REQUEST ? len : AES_DRBG_MAX_REQUEST;
+        if (thread_generate(out, n) < 0)
+            return -1;
+        out += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill a 16-byte IV or nonce from the calling thread's generator.
+ *        Returns 0, or -1 if it could not be seeded.
+ */
+int aes_random_iv(uint8_t* iv) {
+    return aes_random_bytes(iv, 16);
+}
@@ -0,0 +1,530 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_fpe.c
+ *
+ * Description:
+ *   FF1 and FF3-1 format-preserving encryption with a batched lane engine.
+ *
+ * Details:
+ *   Both algorithms are Feistel networks over numeral strings. Each round
+ *   computes a pseudorandom number y with AES and adds it to (or subtracts
+ *   it from) one half of the value modulo radix^m:
+ *     - FF1 runs 10 rounds. Each round takes a CBC-MAC over P || Q, plus
+ *       extra blocks to stretch the result to d bytes. P is the same in
+ *       every round, so E(P) is computed once per value and reused.
+ *     - FF3-1 runs 8 rounds of a single AES call, under the byte-reversed
+ *       key (see ff3_expand_key()).
+ *
+ *   A single value is a chain of dependent AES calls, but values are
+ *   independent of each other. As in the key wrap engine, up to
+ *   AES_INTERLEAVE_MAX values are held in lanes. Every pass takes the next
+ *   block of each lane through aes_blocks() together, then advances each
+ *   lane by one step. A lane that finishes is refilled from the batch.
+ *
+ *   Numbers are handled as little-endian 32-bit limbs. The modular sum
+ *   only needs the low m radix digits of y, which come from repeated
+ *   division by the radix. The sum or difference is then taken digit by
+ *   digit, dropping the final carry or borrow, which is the reduction
+ *   modulo radix^m. For FF3-1 both halves are stored reversed, which turns
+ *   its REV(STR(NUM(REV(X)) + y)) steps into the same plain big-endian
+ *   operations as FF1.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_fpe.h"
+
+#define FPE_LIMBS 40
+#define FPE_MAX_Q (FPE_MAX_TWEAK + 16 + 1 + FPE_MAX_LEN)
+#define FPE_MAX_S (FPE_MAX_LEN + 24)
+
+typedef struct fpe_num {
+    uint32_t limb[FPE_LIMBS];
+} Fpe_num;
+
+typedef struct fpe_lane {
+    Fpe_item* item;
+    uint16_t a[FPE_MAX_LEN];
+    uint16_t b[FPE_MAX_LEN];
+    int len_a;
+    int len_b;
+    int u;
+    int v;
+    int round;                  // Rounds completed
+    int i;                      // Round number as the specification counts it
+
+    // FF1
+    int num_bytes;              // b: bytes of NUM(B)
+    int d;                      // Bytes of S used for y
+    uint8_t p[16];
+    uint8_t ep[16];             // E(P), the same for every round
+    bool has_ep;
+    uint8_t q[FPE_MAX_Q];
+    int len_q;
+    uint8_t mac[16];
+    uint8_t s[FPE_MAX_S];
+    int step;                   // Next block within the round
+    int mac_blocks;             // Blocks of P || Q
+    int exp_blocks;             // Blocks stretching R to d bytes
+
+    // FF3-1
+    uint8_t tl[4];
+    uint8_t tr[4];
+} Fpe_lane;
+
+/* --------------------------------------------------------------------------
+ * Numbers
+ * -------------------------------------------------------------------------- */
+
+static void num_mul_add(Fpe_num* x, uint32_t mul, uint32_t add) {
+    uint64_t carry = add;
+    for (int i = 0; i < FPE_LIMBS; i++) {
+        uint64_t t = (uint64_t)x->limb[i] * mul + carry;
+        x->limb[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+}
+
+/**
+ * @brief NUM_radix(X): the value of a numeral string, most significant first.
+ */
+static void num_from_numerals(Fpe_num* x, const uint16_t* digits, int len, uint32_t radix) {
+    memset(x, 0, sizeof(*x));
+    for (int i = 0; i < len; i++)
+        num_mul_add(x, radix, digits[i]);
+}
+
+/**
+ * @brief NUM(X) of a big-endian byte string.
+ */
+static void num_from_bytes(Fpe_num* x, const uint8_t* in, int len) {
+    memset(x, 0, sizeof(*x));
+    for (int i = 0; i < len; i++) {
+        int j = len - 1 - i;
+        x->limb[j / 4] |= (uint32_t)in[i] << (8 * (j % 4));
+    }
+}
+
+/**
+ * @brief [x]^len: x as a big-endian byte string of len bytes.
+ */
+static void num_to_bytes(const Fpe_num* x, uint8_t* out, int len) {
+    for (int j = 0; j < len; j++)
+        out[len - 1 - j] = (uint8_t)(x->limb[j / 4] >> (8 * (j % 4)));
+}
+
+/**
+ * @brief Divide x by radix in place and return the remainder.
+ */
+static uint32_t num_divmod(Fpe_num* x, uint32_t radix) {
+    uint64_t rem = 0;
+    for (int i = FPE_LIMBS - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | x->limb[i];
+        x->limb[i] = (uint32_t)(cur / radix);
+        rem = cur % radix;
+    }
+    return (uint32_t)rem;
+}
+
+/**
+ * @brief The low m radix digits of x, most significant first. Consumes x.
+ */
+static void num_low_digits(Fpe_num* x, uint16_t* digits, int m, uint32_t radix) {
+    for (int i = m - 1; i >= 0; i--)
+        digits[i] = (uint16_t)num_divmod(x, radix);
+}
+
+/**
+ * @brief Bytes needed for any v-numeral value: ceil(ceil(v·log2(radix))/8).
+ */
+static int numeral_bytes(int v, uint32_t radix) {
+    Fpe_num x;
+    memset(&x, 0, sizeof(x));
+    x.limb[0] = 1;
+    for (int i = 0; i < v; i++)
+        num_mul_add(&x, radix, 0);
+
+    // radix^v - 1 has exactly ceil(v·log2(radix)) bits
+    for (int i = 0; i < FPE_LIMBS && x.limb[i]-- == 0; i++)
+        ;
+    int bits = 0;
+    for (int i = FPE_LIMBS - 1; i >= 0; i--) {
+        if (x.limb[i]) {
+            bits = 32*i + 32 - __builtin_clz(x.limb[i]);
+            break;
+        }
+    }
+    return (bits + 7) / 8;
+}
+
+/**
+ * @brief dst = (x ± y) mod radix^m, digit by digit. dst may alias x.
+ */
+static void digits_add(uint16_t* dst, const uint16_t* x, const uint16_t* y, int m, uint32_t radix,
+        bool subtract) {
+    int64_t carry = 0;
+    for (int i = m - 1; i >= 0; i--) {
+        int64_t t = (int64_t)x[i] + (subtract ? -(int64_t)y[i] : (int64_t)y[i]) + carry;
+        carry = 0;
+        if (t >= (int64_t)radix) {
+            t -= radix;
+            carry = 1;
+        } else if (t < 0) {
+            t += radix;
+            carry = -1;
+        }
+        dst[i] = (uint16_t)t;
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Lanes
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Check that a value's length and tweak are in the algorithm's domain.
+ */
+static int check_domain(Fpe_type type, Fpe_item* item, uint32_t radix) {
+    if (radix < 2 || radix > 65536)
+        return FPE_ERR_NUMERAL;
+    if (item->len < 2 || item->len > FPE_MAX_LEN)
+        return FPE_ERR_LENGTH;
+
+    // radix^minlen >= 1,000,000
+    uint64_t size = 1;
+    for (int i = 0; i < item->len && size < 1000000; i++)
+        size *= radix;
+    if (size < 1000000)
+        return FPE_ERR_LENGTH;
+
+    if (type == FF1) {
+        if (item->len_tweak < 0 || item->len_tweak > FPE_MAX_TWEAK)
+            return FPE_ERR_TWEAK;
+    } else {
+        if (item->len_tweak != 7 && item->len_tweak != 8)
+            return FPE_ERR_TWEAK;
+        // maxlen = 2·floor(log_radix(2^96))
+        unsigned __int128 limit = (unsigned __int128)1 << 96;
+        unsigned __int128 power = 1;
+        int k = 0;
+        while (power * radix <= limit) {
+            power *= radix;
+            k++;
+        }
+        if (item->len > 2*k)
+            return FPE_ERR_LENGTH;
+    }
+
+    for (int i = 0; i < item->len; i++)
+        if (item->in[i] >= radix)
+            return FPE_ERR_NUMERAL;
+    return 0;
+}
+
+static void reverse_numerals(uint16_t* x, int len) {
+    for (int i = 0; i < len / 2; i++) {
+        uint16_t t = x[i];
+        x[i] = x[len - 1 - i];
+        x[len - 1 - i] = t;
+    }
+}
+
+/**
+ * @brief Set up the lane for its next round.
+ */
+static void begin_round(Fpe_lane* lane, Fpe_type type, uint32_t radix, bool is_encrypt) {
+    int rounds = type == FF1 ? 10 : 8;
+    lane->i = is_encrypt ? lane->round : rounds - 1 - lane->round;
+    if (type != FF1)
+        return;
+
+    // Q = T || [0]^((-t-b-1) mod 16) || [i]^1 || [NUM_radix(B)]^b
+    const uint16_t* src = is_encrypt ? lane->b : lane->a;
+    int len_src = is_encrypt ? lane->len_b : lane->len_a;
+    int t = lane->item->len_tweak;
+    int pad = (int)(((-(int64_t)t - lane->num_bytes - 1) % 16 + 16) % 16);
+    uint8_t* q = lane->q;
+    memcpy(q, lane->item->tweak, t);
+    memset(q + t, 0, pad);
+    q[t + pad] = (uint8_t)lane->i;
+    Fpe_num x;
+    num_from_numerals(&x, src, len_src, radix);
+    num_to_bytes(&x, q + t + pad + 1, lane->num_bytes);
+    lane->len_q = t + pad + 1 + lane->num_bytes;
+
+    lane->mac_blocks = 1 + lane->len_q / 16;
+    lane->exp_blocks = (lane->d + 15) / 16 - 1;
+    if (lane->has_ep) {
+        memcpy(lane->mac, lane->ep, 16);
+        lane->step = 1;
+    } else {
+        memset(lane->mac, 0, 16);
+        lane->step = 0;
+    }
+}
+
+/**
+ * @brief Validate an item and load it into a lane. Returns false, with the
+ *        item's result set, if it is outside the algorithm's domain.
+ */
+static bool lane_load(Fpe_lane* lane, Fpe_item* item, Fpe_type type, uint32_t radix,
+        bool is_encrypt) {
+    item->result = check_domain(type, item, radix);
+    if (item->result != 0)
+        return false;
+
+    int n = item->len;
+    lane->item = item;
+    lane->u = type == FF1 ? n / 2 : (n + 1) / 2;
+    lane->v = n - lane->u;
+    lane->len_a = lane->u;
+    lane->len_b = lane->v;
+    memcpy(lane->a, item->in, lane->u * sizeof(uint16_t));
+    memcpy(lane->b, item->in + lane->u, lane->v * sizeof(uint16_t));
+    lane->round = 0;
+
+    if (type == FF1) {
+        lane->num_bytes = numeral_bytes(lane->v, radix);
+        lane->d = 4 * ((lane->num_bytes + 3) / 4) + 4;
+        uint32_t t = item->len_tweak;
+        uint8_t p[16] = { 1, 2, 1, (uint8_t)(radix >> 16), (uint8_t)(radix >> 8), (uint8_t)radix,
+                10, (uint8_t)lane->u, (uint8_t)(n >> 24), (uint8_t)(n >> 16), (uint8_t)(n >> 8),
+                (uint8_t)n, (uint8_t)(t >> 24), (uint8_t)(t >> 16), (uint8_t)(t >> 8), (uint8_t)t };
+        memcpy(lane->p, p, 16);
+        lane->has_ep = false;
+    } else {
+        const uint8_t* tw = item->tweak;
+        if (item->len_tweak == 8) {
+            memcpy(lane->tl, tw, 4);
+            memcpy(lane->tr, tw + 4, 4);
+        } else {
+            uint8_t tl[4] = { tw[0], tw[1], tw[2], (uint8_t)(tw[3] & 0xF0) };
+            uint8_t tr[4] = { tw[4], tw[5], tw[6], (uint8_t)(tw[3] << 4) };
+            memcpy(lane->tl, tl, 4);
+            memcpy(lane->tr, tr, 4);
+        }
+        reverse_numerals(lane->a, lane->len_a);
+        reverse_numerals(lane->b, lane->len_b);
+    }
+
+    begin_round(lane, type, radix, is_encrypt);
+    return true;
+}
+
+/**
+ * @brief Write the lane's next cipher input block.
+ */
+static void lane_block(Fpe_lane* lane, Fpe_type type, uint32_t radix, bool is_encrypt,
+        uint8_t* block) {
+    if (type == FF1) {
+        if (lane->step < lane->mac_blocks) {
+            const uint8_t* src = lane->step == 0 ? lane->p : lane->q + (lane->step - 1)*16;
+            for (int k = 0; k < 16; k++)
+                block[k] = lane->mac[k] ^ src[k];
+        } else {
+            // R ^ [j]^16 for the j-th stretching block
+            uint32_t j = lane->step - lane->mac_blocks + 1;
+            memcpy(block, lane->s, 16);
+            block[12] ^= (uint8_t)(j >> 24);
+            block[13] ^= (uint8_t)(j >> 16);
+            block[14] ^= (uint8_t)(j >> 8);
+            block[15] ^= (uint8_t)j;
+        }
+        return;
+    }
+
+    // P = W ^ [i]^4 || [NUM_radix(REV(B))]^12, enciphered byte-reversed
+    uint8_t p[16];
+    const uint8_t* w = lane->i % 2 == 0 ? lane->tr : lane->tl;
+    memcpy(p, w, 4);
+    p[3] ^= (uint8_t)lane->i;
+    Fpe_num x;
+    num_from_numerals(&x, is_encrypt ? lane->b : lane->a, is_encrypt ? lane->len_b : lane->len_a,
+            radix);
+    num_to_bytes(&x, p + 4, 12);
+    for (int k = 0; k < 16; k++)
+        block[k] = p[15 - k];
+}
+
+/**
+ * @brief Take the lane's cipher output. Returns true once the value is finished.
+ */
+static bool lane_absorb(Fpe_lane* lane, Fpe_type type, uint32_t radix, bool is_encrypt,
+        const uint8_t* out) {
+    Fpe_num y;
+
+    if (type == FF1) {
+        if (lane->step < lane->mac_blocks) {
+            memcpy(lane->mac, out, 16);
+            if (lane->step == 0) {
+                memcpy(lane->ep, out, 16);
+                lane->has_ep = true;
+            }
+            if (lane->step == lane->mac_blocks - 1)
+                memcpy(lane->s, out, 16);
+        } else {
+            memcpy(lane->s + (lane->step - lane->mac_blocks + 1)*16, out, 16);
+        }
+        if (++lane->step < lane->mac_blocks + lane->exp_blocks)
+            return false;
+        num_from_bytes(&y, lane->s, lane->d);
+    } else {
+        uint8_t s[16];
+        for (int k = 0; k < 16; k++)
+            s[k] = out[15 - k];
+        num_from_bytes(&y, s, 16);
+    }
+
+    // Feistel step: C = (A + y) mod radix^m, A = B, B = C; or its inverse
+    int m = lane->i % 2 == 0 ? lane->u : lane->v;
+    uint16_t yd[FPE_MAX_LEN];
+    uint16_t c[FPE_MAX_LEN];
+    num_low_digits(&y, yd, m, radix);
+    if (is_encrypt) {
+        digits_add(c, lane->a, yd, m, radix, false);
+        memcpy(lane->a, lane->b, lane->len_b * sizeof(uint16_t));
+        lane->len_a = lane->len_b;
+        memcpy(lane->b, c, m * sizeof(uint16_t));
+        lane->len_b = m;
+    } else {
+        digits_add(c, lane->b, yd, m, radix, true);
+        memcpy(lane->b, lane->a, lane->len_a * sizeof(uint16_t));
+        lane->len_b = lane->len_a;
+        memcpy(lane->a, c, m * sizeof(uint16_t));
+        lane->len_a = m;
+    }
+
+    if (++lane->round < (type == FF1 ? 10 : 8)) {
+        begin_round(lane, type, radix, is_encrypt);
+        return false;
+    }
+    return true;
+}
+
+static void lane_finish(Fpe_lane* lane, Fpe_type type) {
+    Fpe_item* item = lane->item;
+    if (type == FF3_1) {
+        reverse_numerals(lane->a, lane->len_a);
+        reverse_numerals(lane->b, lane->len_b);
+    }
+    memcpy(item->out, lane->a, lane->len_a * sizeof(uint16_t));
+    memcpy(item->out + lane->len_a, lane->b, lane->len_b * sizeof(uint16_t));
+    item->result = 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Expand an FF3-1 key. FF3-1 enciphers under the byte-reversed key.
+ */
+void ff3_expand_key(const uint8_t* key, int len_key, uint8_t* ekey) {
+    uint8_t rev[32];
+    for (int i = 0; i < len_key; i++)
+        rev[i] = key[len_key - 1 - i];
+    expand_key(rev, len_key, ekey);
+    memset(rev, 0, sizeof(rev));
+}
+
+/**
+ * @brief Encrypt or decrypt a batch of values under one expanded key (from
+ *        ff3_expand_key() for FF3-1). Each item's result is 0 or an
+ *        FPE_ERR_* code.
+ */
+void aes_fpe_batch(Fpe_type type, Fpe_item* items, int num_items, uint32_t radix, uint8_t* ekey,
+        int len_key, bool is_encrypt) {
+    Fpe_lane* storage = malloc(sizeof(Fpe_lane) * AES_INTERLEAVE_MAX);
+    Fpe_lane* lanes[AES_INTERLEAVE_MAX];
+    Fpe_lane* spare[AES_INTERLEAVE_MAX];
+    uint8_t buf[AES_INTERLEAVE_MAX*16];
+    int num_spare = AES_INTERLEAVE_MAX;
+    int active = 0;
+    int next = 0;
+
+    for (int l = 0; l < AES_INTERLEAVE_MAX; l++)
+        spare[l] = &storage[l];
+
+    for (;;) {
+        // Refill empty lanes, keeping the active ones packed at the front
+        while (active < AES_INTERLEAVE_MAX && next < num_items) {
+            Fpe_lane* lane = spare[num_spare - 1];
+            if (lane_load(lane, &items[next++], type, radix, is_encrypt)) {
+                lanes[active++] = lane;
+                num_spare--;
+            }
+        }
+        if (active == 0)
+            break;
+
+        for (int l = 0; l < active; l++)
+            lane_block(lanes[l], type, radix, is_encrypt, buf + l*16);
+
+        aes_blocks(buf, active, ekey, len_key, true);
+
+        for (int l = 0; l < active; ) {
+            if (!lane_absorb(lanes[l], type, radix, is_encrypt, buf + l*16)) {
+                l++;
+                continue;
+            }
+            lane_finish(lanes[l], type);
+
+            // Move the last active lane into this slot, and its block with it
+            spare[num_spare++] = lanes[l];
+            active--;
+            if (l != active) {
+                lanes[l] = lanes[active];
+                memcpy(buf + l*16, buf + active*16, 16);
+            }
+        }
+    }
+
+    memset(storage, 0, sizeof(Fpe_lane) * AES_INTERLEAVE_MAX);
+    free(storage);
+}
+
+/**
+ * @brief FF1 on one value. Returns 0 or an FPE_ERR_* code.
+ */
+int aes_ff1(const uint16_t* in, uint16_t* out, int len, uint32_t radix, const uint8_t* tweak,
+        int len_tweak, uint8_t* ekey, int len_key, bool is_encrypt) {
+    Fpe_item item = { in, out, len, tweak, len_tweak, 0 };
+    aes_fpe_batch(FF1, &item, 1, radix, ekey, len_key, is_encrypt);
+    return item.result;
+}
+
+/**
+ * @brief FF3-1 on one value, under a key from ff3_expand_key(). Returns 0 or
+ *        an FPE_ERR_* code.
+ */
+int aes_ff3_1(const uint16_t* in, uint16_t* out, int len, uint32_t radix, const uint8_t* tweak,
+        int len_tweak, uint8_t* ekey, int len_key, bool is_encrypt) {
+    Fpe_item item = { in, out, len, tweak, len_tweak, 0 };
+    aes_fpe_batch(FF3_1, &item, 1, radix, ekey, len_key, is_encrypt);
+    return item.result;
+}
+
+/**
+ * @brief Parse a string of 0-9a-z numerals (radix up to 36, either case).
+ *        Returns the number of numerals, or -1 if one is not below the radix.
+ */
+int fpe_from_string(const char* s, uint16_t* numerals, uint32_t radix) {
+    int len = 0;
+    for (; s[len]; len++) {
+        int c = tolower((unsigned char)s[len]);
+        int value = isdigit(c) ? c - '0' : isalpha(c) ? c - 'a' + 10 : 99;
+        if ((uint32_t)value >= radix || len >= FPE_MAX_LEN)
+            return -1;
+        numerals[len] = (uint16_t)value;
+    }
+    return len;
+}
+
+/**
+ * @brief Format numerals below 36 as a NUL-terminated 0-9a-z string.
+ */
+void fpe_to_string(const uint16_t* numerals, int len, char* s) {
+    static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    for (int i = 0; i < len; i++)
+        s[i] = DIGITS[numerals[i]];
+    s[len] = '\0';
+}
@@ -1,57 +1,31 @@
 #include "../include/aes_funcs.h"
-
-void usage(int exit_code) {
-    if (exit_code != 0)
-        printf("Invalid input\n");
-    printf("USAGE: aes [OPTIONS] [KEY_FILE] [VECTOR_FILE]");
-    exit(exit_code);
+#include "../include/aes_isa.h"
+
+/**
+ * Append PKCS#7 padding in place. vector must have 16 spare bytes past size.
+ * Returns the padded length.
+ */
+uint64_t pad_vector(uint8_t* vector, uint64_t size) {
+    uint8_t pad_bytes = 16 - (size % 16);
+    for (int i = 0; i < pad_bytes; i++)
+        vector[size++] = pad_bytes;
+    return size;
 }
 
-uint8_t* read_vector(char* vector_file, uint64_t* size, bool is_encrypt) {
-    
-    FILE* f = fopen(vector_file, "rb");
-    if (!f) {
-        fprintf(stderr, "Error: failed to open %s\n", vector_file);
-        exit(1);
-    }
-    
-    uint64_t capacity = BUFSIZ * sizeof(uint8_t);
-    uint8_t* vector = malloc(capacity);
-    
-    int c;
-    while ((c = fgetc(f)) != EOF) {
-        // Unknown file size, so use realloc to dynamically grow the buffer
-        // Use exponential scaling
-        if ((*size) + 1 >= capacity) {
-            capacity *= 2;
-            uint8_t* bigger_vector = realloc(vector, capacity);
-            vector = bigger_vector;
-        }
-        vector[(*size)++] = (uint8_t)c;
-    }
-
-    fclose(f);
-
-    /* Pad out to a multiple of 16 bytes with the number of padded bytes 
-     * per the PKCS standard for CBC, only for encryption
-     */
-    if (is_encrypt) {
-        uint8_t pad_bytes = *size % 16 == 0 ? 16 : 16 - (*size % 16);
-        //printf("size = %ld\npad_bytes = %d\n", *size, pad_bytes);
-        for (int i = 0; i < pad_bytes; i++)
-            vector[(*size)++] = pad_bytes;
-
-        // Realloc smaller to fit the exact memory used for the vector
-        uint8_t* smaller_vector = realloc(vector, (*size));
-
-        // TODO: make this less jank
-        if (!smaller_vector)
-            exit(1);
-    
-        vector = smaller_vector;
-    }
-    
-    return vector;
+/**
+ * Validate PKCS#7 padding at the end of a decrypted vector.
+ * Returns the unpadded length, or -1 if the padding is invalid.
+ */
+int64_t unpad_vector(uint8_t* vector, uint64_t size) {
+    if (size == 0 || size % 16 != 0)
+        return -1;
+    uint8_t pad_bytes = vector[size - 1];
+    if (pad_bytes < 1 || pad_bytes > 16)
+        return -1;
+    for (int i = 1; i <= pad_bytes; i++)
+        if (vector[size - i] != pad_bytes)
+            return -1;
+    return size - pad_bytes;
 }
 
 void add_round_key(uint8_t* state, uint8_t* ekey, int offset) {
@@ -153,7 +127,18 @@ void mix_column(uint8_t* state, bool is_encrypt) {
         state[i] = temp[i];
 }
 
+/**
+ * @brief Encrypt or decrypt one block in place with the kernel bound for this
+ *        CPU (see aes_isa.h).
+ */
 void aes(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt) {
+    aes_kernels.block(state, ekey, len_key, is_encrypt);
+}
+
+/**
+ * @brief The portable table implementation of aes().
+ */
+void aes_table(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt) {
     int round_num = 0;
 
     // Calculate number of rounds
@@ -190,14 +175,3 @@ void aes(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt) {
     }
     
 }
-
-void print_uint8_t_array(uint8_t* arr, int len_arr, char* result) {
-    for (int i = 0; i < len_arr; i++) {
-        if (i % 4 == 0 && i != 0) {
-            sprintf(result, " ");
-            result++;
-        }
-        sprintf(result, "%.2x", arr[i]);
-        result += 2*sizeof(char);
-    }
-}
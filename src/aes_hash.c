@@ -0,0 +1,234 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_hash.c
+ *
+ * Description:
+ *   AES-round hash: lanes, finalization, AES-NI and table round paths, and
+ *   the pass that hashes while it enciphers.
+ *
+ * Details:
+ *   The state is four 16-byte lanes, initialized from constants (XORed with
+ *   the key if there is one). Each 64-byte stripe of input is absorbed as
+ *
+ *       lane[i] = AESENC(lane[i], m[i])
+ *
+ *   where AESENC is one full encryption round (SubBytes, ShiftRows,
+ *   MixColumns) followed by XORing the block in as the round key. The
+ *   four lanes are independent chains, so their rounds overlap in the
+ *   pipeline. A final partial stripe is zero-padded, and the total length
+ *   is then mixed in, so messages that differ only by trailing zeros still
+ *   hash apart. Finalization runs the lanes through each other for three
+ *   rounds, folds them into one block and runs three more rounds so that
+ *   every input bit reaches every digest bit.
+ *
+ *   aes_mode_hash() goes through the data a tile at a time. It hashes each
+ *   tile while it is still in L1, either before encrypting it or after
+ *   decrypting it, so the data is read from memory only once.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_hash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AES_HASH_X86 1
+#include <wmmintrin.h>
+#endif
+
+#define AES_HASH_TILE 4096
+
+// Fractional digits of pi: lane seeds, then finalization round keys
+static const uint8_t HASH_SEED[AES_HASH_STRIPE] = {
+    0x24, 0x3f, 0x6a, 0x88, 0x85, 0xa3, 0x08, 0xd3, 0x13, 0x19, 0x8a, 0x2e, 0x03, 0x70, 0x73, 0x44,
+    0xa4, 0x09, 0x38, 0x22, 0x29, 0x9f, 0x31, 0xd0, 0x08, 0x2e, 0xfa, 0x98, 0xec, 0x4e, 0x6c, 0x89,
+    0x45, 0x28, 0x21, 0xe6, 0x38, 0xd0, 0x13, 0x77, 0xbe, 0x54, 0x66, 0xcf, 0x34, 0xe9, 0x0c, 0x6c,
+    0xc0, 0xac, 0x29, 0xb7, 0xc9, 0x7c, 0x50, 0xdd, 0x3f, 0x84, 0xd5, 0xb5, 0xb5, 0x47, 0x09, 0x17
+};
+static const uint8_t HASH_FINAL[3][16] = {
+    { 0x92, 0x16, 0xd5, 0xd9, 0x89, 0x79, 0xfb, 0x1b, 0xd1, 0x31, 0x0b, 0xa6, 0x98, 0xdf, 0xb5, 0xac },
+    { 0x2f, 0xfd, 0x72, 0xdb, 0xd0, 0x1a, 0xdf, 0xb7, 0xb8, 0xe1, 0xaf, 0xed, 0x6a, 0x26, 0x7e, 0x96 },
+    { 0xba, 0x7c, 0x90, 0x45, 0xf1, 0x2c, 0x7f, 0x99, 0x24, 0xa1, 0x99, 0x47, 0xb3, 0x91, 0x6c, 0xf7 }
+};
+
+/* --------------------------------------------------------------------------
+ * Rounds
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief AESENC with the table round functions: state = round(state) ^ rk.
+ */
+static void round_table(uint8_t* state, const uint8_t* rk) {
+    byte_sub(state, true);
+    shift_row(state, true);
+    mix_column(state, true);
+    for (int i = 0; i < 16; i++)
+        state[i] ^= rk[i];
+}
+
+static void stripes_table(uint8_t* lanes, const uint8_t* msg, uint64_t num_stripes) {
+    for (; num_stripes > 0; num_stripes--, msg += AES_HASH_STRIPE)
+        for (int l = 0; l < 4; l++)
+            round_table(lanes + l*16, msg + l*16);
+}
+
+#ifdef AES_HASH_X86
+__attribute__((target("aes,sse2")))
+static void round_aesni(uint8_t* state, const uint8_t* rk) {
+    __m128i s = _mm_loadu_si128((const __m128i*)state);
+    s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i*)rk));
+    _mm_storeu_si128((__m128i*)state, s);
+}
+
+__attribute__((target("aes,sse2")))
+static void stripes_aesni(uint8_t* lanes, const uint8_t* msg, uint64_t num_stripes) {
+    __m128i l0 = _mm_loadu_si128((const __m128i*)lanes);
+    __m128i l1 = _mm_loadu_si128((const __m128i*)(lanes + 16));
+    __m128i l2 = _mm_loadu_si128((const __m128i*)(lanes + 32));
+    __m128i l3 = _mm_loadu_si128((const __m128i*)(lanes + 48));
+
+    for (; num_stripes > 0; num_stripes--, msg += AES_HASH_STRIPE) {
+        l0 = _mm_aesenc_si128(l0, _mm_loadu_si128((const __m128i*)msg));
+        l1 = _mm_aesenc_si128(l1, _mm_loadu_si128((const __m128i*)(msg + 16)));
+        l2 = _mm_aesenc_si128(l2, _mm_loadu_si128((const __m128i*)(msg + 32)));
+        l3 = _mm_aesenc_si128(l3, _mm_loadu_si128((const __m128i*)(msg + 48)));
+    }
+
+    _mm_storeu_si128((__m128i*)lanes, l0);
+    _mm_storeu_si128((__m128i*)(lanes + 16), l1);
+    _mm_storeu_si128((__m128i*)(lanes + 32), l2);
+    _mm_storeu_si128((__m128i*)(lanes + 48), l3);
+}
+#endif
+
+// The table rounds until aes_isa.c binds the best at load time
+static void (*hash_round)(uint8_t* state, const uint8_t* rk) = round_table;
+static void (*hash_stripes)(uint8_t* lanes, const uint8_t* msg, uint64_t num_stripes) = stripes_table;
+
+/**
+ * @brief Select the AES-NI rounds if enable is set and the CPU has them,
+ *        otherwise the table rounds. Returns whether AES-NI is in use.
+ */
+bool aes_hash_use_aesni(bool enable) {
+#ifdef AES_HASH_X86
+    if (enable && __builtin_cpu_supports("aes")) {
+        hash_round = round_aesni;
+        hash_stripes = stripes_aesni;
+        return true;
+    }
+#endif
+    hash_round = round_table;
+    hash_stripes = stripes_table;
+    return false;
+}
+
+/* --------------------------------------------------------------------------
+ * Incremental Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Start a hash, keyed with 16 bytes of key or unkeyed if key is NULL.
+ */
+void aes_hash_init(Aes_hash_ctx* ctx, const uint8_t* key) {
+    memset(ctx->key, 0, 16);
+    if (key)
+        memcpy(ctx->key, key, 16);
+    for (int i = 0; i < AES_HASH_STRIPE; i++)
+        ctx->lanes[i] = HASH_SEED[i] ^ ctx->key[i % 16];
+    ctx->len_partial = 0;
+    ctx->total = 0;
+}
+
+/**
+ * @brief Absorb more of the message.
+ */
+void aes_hash_update(Aes_hash_ctx* ctx, const uint8_t* msg, uint64_t len) {
+    ctx->total += len;
+
+    if (ctx->len_partial > 0) {
+        uint64_t n = AES_HASH_STRIPE - ctx->len_partial;
+        if (n > len)
+            n = len;
+        memcpy(ctx->partial + ctx->len_partial, msg, n);
+        ctx->len_partial += n;
+        msg += n;
+        len -= n;
+        if (ctx->len_partial < AES_HASH_STRIPE)
+            return;
+        hash_stripes(ctx->lanes, ctx->partial, 1);
+        ctx->len_partial = 0;
+    }
+
+    hash_stripes(ctx->lanes, msg, len / AES_HASH_STRIPE);
+    msg += len / AES_HASH_STRIPE * AES_HASH_STRIPE;
+    ctx->len_partial = len % AES_HASH_STRIPE;
+    memcpy(ctx->partial, msg, ctx->len_partial);
+}
+
+/**
+ * @brief Finish the hash and write the 16-byte digest.
+ */
+void aes_hash_final(Aes_hash_ctx* ctx, uint8_t* digest) {
+    uint8_t* lanes = ctx->lanes;
+
+    if (ctx->len_partial > 0) {
+        memset(ctx->partial + ctx->len_partial, 0, AES_HASH_STRIPE - ctx->len_partial);
+        hash_stripes(lanes, ctx->partial, 1);
+    }
+
+    // Total length in bits, little-endian, into the first lane
+    uint8_t length[16] = {0};
+    for (int i = 0; i < 8; i++)
+        length[i] = (uint8_t)((ctx->total * 8) >> (8*i));
+    hash_round(lanes, length);
+
+    // Each lane absorbs its neighbour, three times around
+    uint8_t prev[AES_HASH_STRIPE];
+    for (int r = 0; r < 3; r++) {
+        memcpy(prev, lanes, AES_HASH_STRIPE);
+        for (int l = 0; l < 4; l++)
+            hash_round(lanes + l*16, prev + ((l + 1) % 4)*16);
+    }
+
+    for (int i = 0; i < 16; i++)
+        digest[i] = lanes[i] ^ lanes[16 + i] ^ lanes[32 + i] ^ lanes[48 + i];
+    for (int r = 0; r < 3; r++)
+        hash_round(digest, HASH_FINAL[r]);
+    for (int i = 0; i < 16; i++)
+        digest[i] ^= ctx->key[i];
+
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/**
+ * @brief Hash a whole message, keyed with 16 bytes of key or unkeyed if key
+ *        is NULL.
+ */
+void aes_hash(const uint8_t* msg, uint64_t len, const uint8_t* key, uint8_t* digest) {
+    Aes_hash_ctx ctx;
+    aes_hash_init(&ctx, key);
+    aes_hash_update(&ctx, msg, len);
+    aes_hash_final(&ctx, digest);
+}
+
+/* --------------------------------------------------------------------------
+ * Fused Encryption
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief aes_mode() that also feeds the plaintext into ctx: the input when
+ *        encrypting, the output when decrypting. Both directions hash the
+ *        same bytes, so the digest taken when a chunk was encrypted checks
+ *        it after decryption. Chaining works across calls as for aes_mode().
+ */
+void aes_mode_hash(Aes_hash_ctx* ctx, Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey,
+        int len_key, uint8_t* iv, bool is_encrypt) {
+    while (len > 0) {
+        uint64_t n = len < AES_HASH_TILE ? len : AES_HASH_TILE;
+        if (is_encrypt)
+            aes_hash_update(ctx, data, n);
+        aes_mode(op_mode, data, n, ekey, len_key, iv, is_encrypt);
+        if (!is_encrypt)
+            aes_hash_update(ctx, data, n);
+        data += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,837 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_io.c
+ *
+ * Description:
+ *   Asynchronous file-to-file encryption pipeline.
+ *
+ * Details:
+ *   The input file is split into fixed-size chunks, each owned by one buffer
+ *   slot while it moves through READING -> READ_DONE -> CIPHER -> WRITING.
+ *   The calling thread is the coordinator: it keeps a read outstanding for
+ *   every free slot, hands completed chunks on in file order, and recycles a
+ *   slot once its write completes.
+ *
+ *   Modes whose chunks are independent once the starting chaining value is
+ *   known (ECB, CTR, CBC/CFB decryption of any segment size) are handed to the cipher workers,
+ *   which submit the write themselves when they finish. The serial modes
+ *   (CBC/CFB encryption, OFB) are encrypted on the coordinator in order, which
+ *   still overlaps with the reads and writes in flight.
+ *
+ *   Two I/O engines share the same submit/wait interface: io_uring driven
+ *   directly through its system calls, and a fallback where a pair of I/O
+ *   threads perform blocking pread/pwrite and post completions to a queue.
+ *
+ *   With NUMA placement, slot i belongs to node i % num_nodes and worker w
+ *   to node w % num_nodes. Workers pin themselves to their node, keep a
+ *   node-local copy of the round keys and first-touch their node's buffers
+ *   before any I/O starts; each node then has its own job queue, so a chunk
+ *   is only ever read into, encrypted and written from local memory.
+ *
+ *   As with read_vector(), encryption appends PKCS#7 padding to the final
+ *   chunk; decryption validates and strips it.
+ *
+ *   Key rotation runs the same pipeline with a second key: each chunk is
+ *   decrypted under the old key and encrypted under the new one a tile at a
+ *   time, so every tile is re-encrypted straight from cache and the
+ *   plaintext only ever exists in the chunk buffers. The padding is checked
+ *   but kept, so the output is exactly as long as the input. A chunk is
+ *   parallel only if its mode is parallel in both directions (ECB, CTR);
+ *   otherwise the coordinator rotates chunks in order.
+ * -----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include "../include/aes_io.h"
+#include "../include/aes_numa.h"
+#include "../include/aes_metrics.h"
+#include "../include/aes_afalg.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define IO_NUM_THREADS 2           // I/O threads serving the IO_THREADS backend
+#define REKEY_TILE (32 * 1024)     // Bytes decrypted, then re-encrypted, at a time
+
+enum { OP_READ, OP_WRITE };
+enum { SLOT_FREE, SLOT_READING, SLOT_READ_DONE, SLOT_CIPHER, SLOT_WRITING };
+
+typedef struct io_slot {
+    uint8_t* buf;
+    uint64_t chunk;     // Chunk index within the file
+    uint64_t offset;    // Offset in both the input and output file
+    uint64_t len;       // Bytes to read, then bytes to write
+    uint64_t done;      // Bytes transferred so far by the current operation
+    bool is_last;
+    uint8_t iv[16];     // Chaining value the chunk starts from
+    uint8_t new_iv[16]; // Same, under the new key when rotating keys
+    int state;
+    int node;           // Index into the topology of the node owning buf
+} Io_slot;
+
+typedef struct io_event {
+    int slot;
+    int op;
+    int64_t res;
+} Io_event;
+
+/* Bounded blocking queue used for job hand-off and the thread I/O engine */
+typedef struct io_queue {
+    Io_event* items;
+    int capacity;
+    int head;
+    int count;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Io_queue;
+
+typedef struct uring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+    pthread_mutex_t sq_lock;
+} Uring;
+
+typedef struct io_worker {
+    struct pipeline* p;
+    int node;
+    int index;          // Position among the workers of its node
+    pthread_t thread;
+} Io_worker;
+
+typedef struct pipeline {
+    Op_mode op_mode;
+    uint8_t* ekey;
+    int len_key;
+    bool is_encrypt;
+    uint8_t* new_ekey;  // Rotating keys: re-encrypt under this after decrypting
+    int new_len_key;
+
+    int in_fd;
+    int out_fd;
+    uint64_t num_chunks;
+
+    Io_slot* slots;
+    int num_slots;
+    uint64_t buf_size;
+
+    Io_backend backend;
+    Uring ring;
+    pthread_t io_threads[IO_NUM_THREADS];
+    Io_queue requests;
+    Io_queue completions;
+
+    Io_worker* workers;
+    int num_workers;
+    Io_queue* jobs;     // One queue per node
+    pthread_barrier_t ready;
+
+    bool use_numa;
+    int num_nodes;
+    Numa_topology topo;
+
+    int error;
+} Pipeline;
+
+/* --------------------------------------------------------------------------
+ * Queue
+ * -------------------------------------------------------------------------- */
+
+static void queue_init(Io_queue* q, int capacity) {
+    q->items = malloc(sizeof(Io_event) * capacity);
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->closed = false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+}
+
+static void queue_destroy(Io_queue* q) {
+    free(q->items);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+}
+
+static void queue_push(Io_queue* q, Io_event e) {
+    pthread_mutex_lock(&q->lock);
+    q->items[(q->head + q->count) % q->capacity] = e;
+    q->count++;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief Pop the next event, blocking while the queue is empty.
+ *        Returns false once the queue is closed and drained.
+ */
+static bool queue_pop(Io_queue* q, Io_event* e) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->cond, &q->lock);
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return false;
+    }
+    *e = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+static void queue_close(Io_queue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* --------------------------------------------------------------------------
+ * io_uring Engine
+ * -------------------------------------------------------------------------- */
+
+static int uring_setup(Uring* r, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    r->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (r->fd < 0)
+        return -1;
+
+    r->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_size > r->sq_size)
+            r->sq_size = r->cq_size;
+        r->cq_size = r->sq_size;
+    }
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            munmap(r->sq_ptr, r->sq_size);
+            close(r->fd);
+            return -1;
+        }
+    }
+
+    r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        if (r->cq_ptr != r->sq_ptr)
+            munmap(r->cq_ptr, r->cq_size);
+        munmap(r->sq_ptr, r->sq_size);
+        close(r->fd);
+        return -1;
+    }
+
+    r->sq_head  = (unsigned*)((uint8_t*)r->sq_ptr + params.sq_off.head);
+    r->sq_tail  = (unsigned*)((uint8_t*)r->sq_ptr + params.sq_off.tail);
+    r->sq_mask  = (unsigned*)((uint8_t*)r->sq_ptr + params.sq_off.ring_mask);
+    r->sq_array = (unsigned*)((uint8_t*)r->sq_ptr + params.sq_off.array);
+    r->cq_head  = (unsigned*)((uint8_t*)r->cq_ptr + params.cq_off.head);
+    r->cq_tail  = (unsigned*)((uint8_t*)r->cq_ptr + params.cq_off.tail);
+    r->cq_mask  = (unsigned*)((uint8_t*)r->cq_ptr + params.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe*)((uint8_t*)r->cq_ptr + params.cq_off.cqes);
+
+    pthread_mutex_init(&r->sq_lock, NULL);
+    return 0;
+}
+
+static void uring_teardown(Uring* r) {
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr != r->sq_ptr)
+        munmap(r->cq_ptr, r->cq_size);
+    munmap(r->sq_ptr, r->sq_size);
+    close(r->fd);
+    pthread_mutex_destroy(&r->sq_lock);
+}
+
+static int uring_enter(Uring* r, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, NULL, 0);
+    } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+    return ret;
+}
+
+/**
+ * @brief SQEs queued but not yet taken by the kernel.
+ */
+static unsigned uring_unsubmitted(Uring* r) {
+    return __atomic_load_n(r->sq_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Queue one read or write SQE and submit it. Called from the
+ *        coordinator and from cipher workers, so the SQ is under a lock.
+ *        If the kernel cannot take the SQE now (a full completion queue, no
+ *        memory), it stays queued and the next uring_enter() submits it, at
+ *        the latest the one in uring_wait().
+ */
+static void uring_submit(Uring* r, int fd, int op, int slot, uint8_t* addr, uint64_t len,
+        uint64_t offset) {
+    pthread_mutex_lock(&r->sq_lock);
+
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op == OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = (uint32_t)len;
+    sqe->off = offset;
+    sqe->user_data = ((uint64_t)op << 32) | (uint32_t)slot;
+    r->sq_array[idx] = idx;
+
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    uring_enter(r, uring_unsubmitted(r), 0, 0);
+
+    pthread_mutex_unlock(&r->sq_lock);
+}
+
+/**
+ * @brief Wait for the next completion, submitting any SQEs still queued.
+ *        Returns 0, or -1 if the ring fails.
+ */
+static int uring_wait(Uring* r, Io_event* e) {
+    for (;;) {
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+            e->slot = (int)(cqe->user_data & 0xFFFFFFFF);
+            e->op = (int)(cqe->user_data >> 32);
+            e->res = cqe->res;
+            __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+        // EBUSY: completions are waiting to be reaped first
+        if (uring_enter(r, uring_unsubmitted(r), 1, IORING_ENTER_GETEVENTS) < 0 && errno != EBUSY)
+            return -1;
+    }
+}
+
+/**
+ * @brief Check whether the running kernel allows io_uring to be set up.
+ */
+bool aes_io_uring_available() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, 1, &params);
+    if (fd < 0)
+        return false;
+    close(fd);
+    return true;
+}
+
+/* --------------------------------------------------------------------------
+ * Thread Engine
+ * -------------------------------------------------------------------------- */
+
+static void* io_thread_main(void* arg) {
+    Pipeline* p = arg;
+    Io_event e;
+
+    while (queue_pop(&p->requests, &e)) {
+        Io_slot* s = &p->slots[e.slot];
+        uint64_t done = s->done;
+        int err = 0;
+
+        while (done < s->len) {
+            ssize_t n = e.op == OP_READ
+                ? pread(p->in_fd, s->buf + done, s->len - done, s->offset + done)
+                : pwrite(p->out_fd, s->buf + done, s->len - done, s->offset + done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                err = errno;
+            if (n <= 0)
+                break;
+            done += n;
+        }
+
+        e.res = err ? -err : (int64_t)(done - s->done);
+        queue_push(&p->completions, e);
+    }
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Engine Interface
+ * -------------------------------------------------------------------------- */
+
+static void io_submit(Pipeline* p, int slot, int op) {
+    Io_slot* s = &p->slots[slot];
+    if (p->backend == IO_URING) {
+        uring_submit(&p->ring, op == OP_READ ? p->in_fd : p->out_fd, op, slot,
+                s->buf + s->done, s->len - s->done, s->offset + s->done);
+    } else {
+        Io_event e = { slot, op, 0 };
+        queue_push(&p->requests, e);
+    }
+}
+
+static int io_wait(Pipeline* p, Io_event* e) {
+    if (p->backend == IO_URING)
+        return uring_wait(&p->ring, e);
+    queue_pop(&p->completions, e);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Cipher Stage
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Whether chunks can be ciphered independently once their starting
+ *        chaining value is known.
+ */
+static bool is_parallel_mode(Op_mode op_mode, bool is_encrypt) {
+    return op_mode == ECB || op_mode == CTR ||
+        (!is_encrypt && (op_mode == CBC || op_mode == CFB || op_mode == CFB8 || op_mode == CFB1));
+}
+
+/**
+ * @brief Whether the pipeline's chunks go to the cipher workers.
+ */
+static bool pipeline_is_parallel(Pipeline* p) {
+    return is_parallel_mode(p->op_mode, p->new_ekey ? true : p->is_encrypt);
+}
+
+/**
+ * @brief Decrypt one chunk under the old key and encrypt it under the new
+ *        one, a tile at a time, checking the padding of the final chunk.
+ */
+static void rekey_chunk(Pipeline* p, Io_slot* s, uint8_t* ekey, uint8_t* new_ekey) {
+    for (uint64_t pos = 0; pos < s->len; pos += REKEY_TILE) {
+        uint64_t n = s->len - pos < REKEY_TILE ? s->len - pos : REKEY_TILE;
+        aes_mode(p->op_mode, s->buf + pos, n, ekey, p->len_key, s->iv, false);
+        if (s->is_last && pos + n == s->len && unpad_vector(s->buf, s->len) < 0) {
+            fprintf(stderr, "Error: invalid padding in final block, is the old key right?\n");
+            __atomic_store_n(&p->error, 1, __ATOMIC_RELAXED);
+        }
+        aes_mode(p->op_mode, s->buf + pos, n, new_ekey, p->new_len_key, s->new_iv, true);
+    }
+    s->done = 0;
+    s->state = SLOT_WRITING;
+}
+
+/**
+ * @brief Encrypt or decrypt one chunk in place, handling padding on the final
+ *        chunk, and leave the slot ready to be written.
+ */
+static void cipher_chunk(Pipeline* p, Io_slot* s, uint8_t* ekey, uint8_t* new_ekey) {
+    if (p->new_ekey) {
+        rekey_chunk(p, s, ekey, new_ekey);
+        return;
+    }
+    if (p->is_encrypt && s->is_last)
+        s->len = pad_vector(s->buf, s->len);
+
+    aes_mode(p->op_mode, s->buf, s->len, ekey, p->len_key, s->iv, p->is_encrypt);
+
+    if (!p->is_encrypt && s->is_last) {
+        int64_t unpadded = unpad_vector(s->buf, s->len);
+        if (unpadded >= 0) {
+            s->len = unpadded;
+        } else {
+            fprintf(stderr, "Error: invalid padding in final block\n");
+            __atomic_store_n(&p->error, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    s->done = 0;
+    s->state = SLOT_WRITING;
+}
+
+static void* worker_main(void* arg) {
+    Io_worker* w = arg;
+    Pipeline* p = w->p;
+    Io_event e;
+
+    if (p->use_numa)
+        numa_pin_to_node(&p->topo, w->node);
+    metrics_set_backend(p->backend == IO_URING ? METRICS_URING : METRICS_THREADS);
+
+    // Round keys from the worker's own stack, which is local to its node
+    uint8_t ekey[240], new_ekey[240];
+    memcpy(ekey, p->ekey, 16 * (p->len_key/4 + 7));
+    if (p->new_ekey)
+        memcpy(new_ekey, p->new_ekey, 16 * (p->new_len_key/4 + 7));
+
+    // First-touch this worker's share of its node's buffers
+    int node_workers = (p->num_workers - w->node + p->num_nodes - 1) / p->num_nodes;
+    for (int i = w->node; i < p->num_slots; i += p->num_nodes)
+        if ((i / p->num_nodes) % node_workers == w->index)
+            numa_first_touch(p->slots[i].buf, p->buf_size);
+    pthread_barrier_wait(&p->ready);
+
+    while (queue_pop(&p->jobs[w->node], &e)) {
+        cipher_chunk(p, &p->slots[e.slot], ekey, new_ekey);
+        io_submit(p, e.slot, OP_WRITE);
+    }
+    memset(ekey, 0, sizeof(ekey));
+    memset(new_ekey, 0, sizeof(new_ekey));
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Coordinator
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Fill in the default pipeline options.
+ */
+void aes_io_default_opts(Aes_io_opts* opts) {
+    opts->backend = IO_AUTO;
+    opts->chunk_size = AES_IO_DEFAULT_CHUNK;
+    opts->queue_depth = AES_IO_DEFAULT_DEPTH;
+    opts->num_threads = 0;
+    opts->numa = true;
+}
+
+static int run_pipeline(Pipeline* p, uint64_t in_size, uint64_t chunk_size, uint8_t* iv,
+        uint8_t* new_iv) {
+    bool parallel = pipeline_is_parallel(p);
+
+    // Slots indexed by chunk number for in-order hand-off. Chunks between
+    // next_dispatch and next_read each hold a slot, so chunk % num_slots is unique
+    int* ring = malloc(sizeof(int) * p->num_slots);
+    int* free_slots = malloc(sizeof(int) * p->num_slots);
+    int num_free = p->num_slots;
+    for (int i = 0; i < p->num_slots; i++)
+        free_slots[i] = i;
+
+    uint8_t chain[16], new_chain[16];
+    memcpy(chain, iv, 16);
+    memcpy(new_chain, new_iv ? new_iv : iv, 16);
+
+    uint64_t next_read = 0;
+    uint64_t next_dispatch = 0;
+    uint64_t writes_done = 0;
+
+    while (writes_done < p->num_chunks) {
+
+        // Keep a read in flight for every free slot
+        while (num_free > 0 && next_read < p->num_chunks) {
+            int slot = free_slots[--num_free];
+            Io_slot* s = &p->slots[slot];
+            s->chunk = next_read;
+            s->offset = next_read * chunk_size;
+            s->is_last = next_read == p->num_chunks - 1;
+            s->len = s->is_last ? in_size - s->offset : chunk_size;
+            s->done = 0;
+            ring[next_read % p->num_slots] = slot;
+            next_read++;
+
+            if (s->len == 0) {
+                s->state = SLOT_READ_DONE;
+            } else {
+                s->state = SLOT_READING;
+                io_submit(p, slot, OP_READ);
+            }
+        }
+
+        // Hand finished reads to the cipher stage in file order
+        while (next_dispatch < next_read) {
+            int slot = ring[next_dispatch % p->num_slots];
+            Io_slot* s = &p->slots[slot];
+            if (s->state != SLOT_READ_DONE)
+                break;
+
+            s->state = SLOT_CIPHER;
+            memcpy(s->iv, chain, 16);
+            memcpy(s->new_iv, new_chain, 16);
+            if (!parallel) {
+                cipher_chunk(p, s, p->ekey, p->new_ekey);
+                memcpy(chain, s->iv, 16);
+                memcpy(new_chain, s->new_iv, 16);
+                io_submit(p, slot, OP_WRITE);
+            } else {
+                if (p->op_mode == CTR) {
+                    ctr_add(chain, (s->len + 15) / 16);
+                    ctr_add(new_chain, (s->len + 15) / 16);
+                } else if (p->op_mode != ECB) {
+                    memcpy(chain, s->buf + s->len - 16, 16);
+                }
+                Io_event job = { slot, OP_WRITE, 0 };
+                queue_push(&p->jobs[s->node], job);
+            }
+            next_dispatch++;
+        }
+
+        if (writes_done == p->num_chunks)
+            break;
+
+        // A failed ring completes nothing more; tearing it down cancels
+        // whatever is still in flight
+        Io_event e;
+        if (io_wait(p, &e) < 0) {
+            fprintf(stderr, "Error: io_uring failed: %s\n", strerror(errno));
+            __atomic_store_n(&p->error, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        Io_slot* s = &p->slots[e.slot];
+
+        // Errors and unexpected EOF still complete the operation so the
+        // pipeline drains cleanly; the error is reported at the end
+        if (e.res < 0 || (e.res == 0 && s->done < s->len)) {
+            if (!p->error)
+                fprintf(stderr, "Error: %s failed on chunk %lu: %s\n",
+                        e.op == OP_READ ? "read" : "write", s->chunk,
+                        e.res < 0 ? strerror(-e.res) : "unexpected end of file");
+            __atomic_store_n(&p->error, 1, __ATOMIC_RELAXED);
+            s->done = s->len;
+        } else {
+            s->done += e.res;
+        }
+
+        if (s->done < s->len) {
+            io_submit(p, e.slot, e.op);
+        } else if (e.op == OP_READ) {
+            s->state = SLOT_READ_DONE;
+        } else {
+            s->state = SLOT_FREE;
+            free_slots[num_free++] = e.slot;
+            writes_done++;
+        }
+    }
+
+    free(ring);
+    free(free_slots);
+    return p->error ? -1 : 0;
+}
+
+/**
+ * @brief Set up and run a pipeline. With new_ekey, in_file is decrypted and
+ *        re-encrypted under new_ekey from new_iv; is_encrypt is then false.
+ */
+static int file_pipeline(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey,
+        int len_key, uint8_t* iv, bool is_encrypt, uint8_t* new_ekey, int new_len_key,
+        uint8_t* new_iv, Aes_io_opts* opts) {
+
+    Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.op_mode = op_mode;
+    p.ekey = ekey;
+    p.len_key = len_key;
+    p.is_encrypt = is_encrypt;
+    p.new_ekey = new_ekey;
+    p.new_len_key = new_len_key;
+
+    if (opts->chunk_size > AES_IO_MAX_CHUNK) {
+        fprintf(stderr, "Error: chunk size %lu is above %llu\n", opts->chunk_size, AES_IO_MAX_CHUNK);
+        return -1;
+    }
+    uint64_t chunk_size = opts->chunk_size & ~(uint64_t)15;
+    if (chunk_size == 0)
+        chunk_size = 16;
+
+    p.in_fd = open(in_file, O_RDONLY);
+    if (p.in_fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", in_file);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(p.in_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: %s is not a regular file\n", in_file);
+        close(p.in_fd);
+        return -1;
+    }
+    uint64_t in_size = st.st_size;
+
+    if (!is_encrypt && (in_size == 0 || in_size % 16 != 0)) {
+        fprintf(stderr, "Error: ciphertext length %lu is not a multiple of 16\n", in_size);
+        close(p.in_fd);
+        return -1;
+    }
+
+    // Encryption always has a final, possibly empty, chunk to carry the padding
+    p.num_chunks = is_encrypt ? in_size / chunk_size + 1 : (in_size + chunk_size - 1) / chunk_size;
+
+    p.out_fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (p.out_fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", out_file);
+        close(p.in_fd);
+        return -1;
+    }
+
+    p.num_workers = 0;
+    if (pipeline_is_parallel(&p)) {
+        p.num_workers = opts->num_threads > 0 ? opts->num_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (p.num_workers < 1)
+            p.num_workers = 1;
+    }
+
+    // Spread workers over the nodes, but never more nodes than workers
+    p.num_nodes = 1;
+    if (p.num_workers > 0 && opts->numa) {
+        numa_discover(&p.topo);
+        p.num_nodes = p.topo.num_nodes < p.num_workers ? p.topo.num_nodes : p.num_workers;
+        p.use_numa = p.num_nodes > 1;
+        if (!p.use_numa)
+            p.num_nodes = 1;
+    }
+
+    // Enough slots that every worker can be busy while reads and writes are
+    // in flight, and the same number on every node
+    p.num_slots = opts->queue_depth > 2 ? opts->queue_depth : 2;
+    if (p.num_slots < p.num_workers + 2)
+        p.num_slots = p.num_workers + 2;
+    p.num_slots = (p.num_slots + p.num_nodes - 1) / p.num_nodes * p.num_nodes;
+
+    p.backend = opts->backend;
+    if (p.backend != IO_THREADS) {
+        if (uring_setup(&p.ring, p.num_slots) == 0) {
+            p.backend = IO_URING;
+        } else if (p.backend == IO_URING) {
+            fprintf(stderr, "Error: io_uring is not available\n");
+            close(p.in_fd);
+            close(p.out_fd);
+            return -1;
+        } else {
+            p.backend = IO_THREADS;
+        }
+    }
+
+    // Buffers are not touched here; the workers fault them in on their own node
+    p.buf_size = chunk_size + 16;
+    p.slots = calloc(p.num_slots, sizeof(Io_slot));
+    for (int i = 0; p.slots && i < p.num_slots; i++) {
+        p.slots[i].node = i % p.num_nodes;
+        p.slots[i].buf = numa_alloc_untouched(p.buf_size);
+        if (!p.slots[i].buf) {
+            for (int j = 0; j < i; j++)
+                numa_free(p.slots[j].buf, p.buf_size);
+            free(p.slots);
+            p.slots = NULL;
+        }
+    }
+    if (!p.slots) {
+        fprintf(stderr, "Error: failed to allocate chunk buffers\n");
+        if (p.backend == IO_URING)
+            uring_teardown(&p.ring);
+        close(p.in_fd);
+        close(p.out_fd);
+        return -1;
+    }
+
+    if (p.backend == IO_THREADS) {
+        queue_init(&p.requests, p.num_slots);
+        queue_init(&p.completions, p.num_slots);
+        for (int i = 0; i < IO_NUM_THREADS; i++)
+            pthread_create(&p.io_threads[i], NULL, io_thread_main, &p);
+    }
+
+    p.jobs = malloc(sizeof(Io_queue) * p.num_nodes);
+    for (int n = 0; n < p.num_nodes; n++)
+        queue_init(&p.jobs[n], p.num_slots);
+
+    p.workers = malloc(sizeof(Io_worker) * (p.num_workers + 1));
+    if (p.num_workers > 0) {
+        pthread_barrier_init(&p.ready, NULL, p.num_workers + 1);
+        for (int i = 0; i < p.num_workers; i++) {
+            p.workers[i].p = &p;
+            p.workers[i].node = i % p.num_nodes;
+            p.workers[i].index = i / p.num_nodes;
+            pthread_create(&p.workers[i].thread, NULL, worker_main, &p.workers[i]);
+        }
+        pthread_barrier_wait(&p.ready);
+        pthread_barrier_destroy(&p.ready);
+    }
+
+    // Serial modes are enciphered on this thread, so count them under the backend too
+    Metrics_backend caller_backend = metrics_get_backend();
+    metrics_set_backend(p.backend == IO_URING ? METRICS_URING : METRICS_THREADS);
+    metrics_expect(new_ekey ? 2 * in_size : in_size);     // Rotation ciphers each byte twice
+
+    int ret = run_pipeline(&p, in_size, chunk_size, iv, new_iv);
+    metrics_set_backend(caller_backend);
+
+    for (int n = 0; n < p.num_nodes; n++)
+        queue_close(&p.jobs[n]);
+    for (int i = 0; i < p.num_workers; i++)
+        pthread_join(p.workers[i].thread, NULL);
+    for (int n = 0; n < p.num_nodes; n++)
+        queue_destroy(&p.jobs[n]);
+    free(p.jobs);
+    free(p.workers);
+
+    if (p.backend == IO_THREADS) {
+        queue_close(&p.requests);
+        for (int i = 0; i < IO_NUM_THREADS; i++)
+            pthread_join(p.io_threads[i], NULL);
+        queue_destroy(&p.requests);
+        queue_destroy(&p.completions);
+    } else {
+        uring_teardown(&p.ring);
+    }
+
+    for (int i = 0; i < p.num_slots; i++)
+        numa_free(p.slots[i].buf, p.buf_size);
+    free(p.slots);
+
+    close(p.in_fd);
+    if (close(p.out_fd) < 0)
+        ret = -1;
+
+    return ret;
+}
+
+/**
+ * @brief Encrypt or decrypt in_file into out_file with overlapped reads,
+ *        cipher work and writes. Returns 0 on success, -1 on error.
+ */
+int aes_file_pipeline(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey,
+        int len_key, uint8_t* iv, bool is_encrypt, Aes_io_opts* opts) {
+    if (opts->backend == IO_AF_ALG)
+        return aes_afalg_file(in_file, out_file, op_mode, ekey, len_key, iv, is_encrypt,
+                opts->chunk_size);
+    return file_pipeline(in_file, out_file, op_mode, ekey, len_key, iv, is_encrypt, NULL, 0,
+            NULL, opts);
+}
+
+/**
+ * @brief Rotate the key of in_file, encrypted under ekey from iv, into
+ *        out_file under new_ekey from new_iv, in one pass and without writing
+ *        the plaintext anywhere. Returns 0 on success, -1 on error.
+ */
+int aes_file_rekey(char* in_file, char* out_file, Op_mode op_mode, uint8_t* ekey, int len_key,
+        uint8_t* iv, uint8_t* new_ekey, int new_len_key, uint8_t* new_iv, Aes_io_opts* opts) {
+    if (opts->backend == IO_AF_ALG) {
+        fprintf(stderr, "Error: key rotation needs the uring or threads I/O engine\n");
+        return -1;
+    }
+    return file_pipeline(in_file, out_file, op_mode, ekey, len_key, iv, false, new_ekey,
+            new_len_key, new_iv, opts);
+}
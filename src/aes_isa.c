@@ -0,0 +1,631 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_isa.c
+ *
+ * Description:
+ *   CPU tier detection, the kernel dispatch table and the AES-NI kernels.
+ *
+ * Details:
+ *   aes_kernels starts out holding the portable table kernels, so it is
+ *   usable before anything is bound. A constructor then detects the best
+ *   tier (capped by AES_ISA in the environment) and binds its kernels
+ *   before main() or dlopen() returns. Every entry point that dispatches
+ *   refers to aes_kernels, so a static link that ciphers anything also
+ *   pulls in this file and its constructor.
+ *
+ *   The AES-NI kernels are compiled for their instructions with target
+ *   attributes, so the rest of the build stays at the baseline ISA and the
+ *   one binary runs everywhere. They read the key schedule from
+ *   expand_key() unchanged: its bytes are already in the order AESENC takes
+ *   its round key. Decryption uses AESDEC, which wants the equivalent
+ *   inverse cipher, so the middle round keys go through AESIMC when a call
+ *   loads the schedule.
+ *
+ *   With VAES, one AESENC instruction runs a round on every 128-bit lane of
+ *   a 256- or 512-bit register. The VAES kernels keep 16 blocks in flight
+ *   (eight ymm or four zmm registers) against round keys broadcast to
+ *   every lane, and hand any remainder of fewer than 16 blocks to the
+ *   AES-NI kernels. They cover the bulk paths that have independent blocks:
+ *   ECB, CTR and CBC decryption. CTR counters live in the registers as
+ *   little-endian 128-bit integers; each pass adds 16 to the low half of
+ *   every lane and byte-swaps a copy into keystream input. That add cannot
+ *   carry into the high half, so a call whose low half would wrap goes to
+ *   the AES-NI kernel instead. CBC decryption builds each lane's chaining
+ *   value by shifting the loaded ciphertext one lane along, carrying the
+ *   last block across registers and passes.
+ *
+ *   The other modules bind their own variants through the selector they
+ *   already have (aes_hash_use_aesni(), hex_use_avx2()), called from
+ *   aes_isa_select() so that one tier setting covers everything.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_isa.h"
+#include "../include/aes_hash.h"
+#include "../include/hex.h"
+
+#ifdef AES_ISA_X86
+#include <immintrin.h>
+#endif
+
+#define AESNI_MAX_ROUNDS 14
+#define VAES_BLOCKS 16                              // Blocks in flight per VAES pass
+
+#define TABLE_KERNELS { aes_table, aes_blocks_table, aes_blocks_keys_table, aes_ctr_table, \
+        aes_cbc_decrypt_table, "table" }
+
+static const char* const ISA_NAMES[] = { "baseline", "ssse3", "avx2", "avx512" };
+
+Aes_kernels aes_kernels = TABLE_KERNELS;
+
+static Aes_isa current_isa = AES_ISA_BASELINE;
+
+/* --------------------------------------------------------------------------
+ * AES-NI Kernels
+ * -------------------------------------------------------------------------- */
+
+#ifdef AES_ISA_X86
+
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+#define AESNI_INLINE static inline __attribute__((always_inline, target("aes,ssse3")))
+
+/**
+ * @brief Load a schedule into registers, in the order the rounds use it: as
+ *        is for encryption, reversed and with AESIMC applied to the middle
+ *        keys for decryption.
+ */
+AESNI_INLINE void aesni_schedule(__m128i* rk, const uint8_t* ekey, int num_rounds, bool is_encrypt) {
+    rk[0] = _mm_loadu_si128((const __m128i*)(ekey + (is_encrypt ? 0 : 16*num_rounds)));
+    for (int r = 1; r <= num_rounds; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*)(ekey + 16*(is_encrypt ? r : num_rounds - r)));
+    if (!is_encrypt)
+        for (int r = 1; r < num_rounds; r++)
+            rk[r] = _mm_aesimc_si128(rk[r]);
+}
+
+/*
+ * The lane loops below run a constant number of times once inlined. They
+ * are unrolled explicitly so the blocks stay in registers across rounds.
+ */
+
+/**
+ * @brief Run `lanes` blocks through every round together under the loaded
+ *        schedule rk. Always inlined with a constant lane count.
+ */
+AESNI_INLINE void aesni_lanes(__m128i* b, int lanes, const __m128i* rk, int num_rounds,
+        bool is_encrypt) {
+#pragma GCC unroll 8
+    for (int l = 0; l < lanes; l++)
+        b[l] = _mm_xor_si128(b[l], rk[0]);
+
+    if (is_encrypt) {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 8
+            for (int l = 0; l < lanes; l++)
+                b[l] = _mm_aesenc_si128(b[l], rk[r]);
+#pragma GCC unroll 8
+        for (int l = 0; l < lanes; l++)
+            b[l] = _mm_aesenclast_si128(b[l], rk[num_rounds]);
+    } else {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 8
+            for (int l = 0; l < lanes; l++)
+                b[l] = _mm_aesdec_si128(b[l], rk[r]);
+#pragma GCC unroll 8
+        for (int l = 0; l < lanes; l++)
+            b[l] = _mm_aesdeclast_si128(b[l], rk[num_rounds]);
+    }
+}
+
+/**
+ * @brief Cipher `lanes` consecutive blocks of states in place under one schedule.
+ */
+AESNI_INLINE void aesni_run(uint8_t* states, int lanes, const __m128i* rk, int num_rounds,
+        bool is_encrypt) {
+    __m128i b[8];
+#pragma GCC unroll 8
+    for (int l = 0; l < lanes; l++)
+        b[l] = _mm_loadu_si128((const __m128i*)(states + l*16));
+    aesni_lanes(b, lanes, rk, num_rounds, is_encrypt);
+#pragma GCC unroll 8
+    for (int l = 0; l < lanes; l++)
+        _mm_storeu_si128((__m128i*)(states + l*16), b[l]);
+}
+
+AESNI_TARGET
+static void aes_aesni(uint8_t* state, uint8_t* ekey, int len_key, bool is_encrypt) {
+    int num_rounds = len_key/4 + 6;
+    __m128i rk[AESNI_MAX_ROUNDS + 1];
+    aesni_schedule(rk, ekey, num_rounds, is_encrypt);
+    aesni_run(state, 1, rk, num_rounds, is_encrypt);
+}
+
+/**
+ * @brief aes_blocks() with AES-NI, honouring the interleave width the same
+ *        way as the table core.
+ */
+AESNI_TARGET
+static void aes_blocks_aesni(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key,
+        bool is_encrypt) {
+    int num_rounds = len_key/4 + 6;
+    int width = aes_get_interleave();
+    __m128i rk[AESNI_MAX_ROUNDS + 1];
+    aesni_schedule(rk, ekey, num_rounds, is_encrypt);
+
+    if (width >= 8)
+        for (; num_blocks >= 8; num_blocks -= 8, states += 8*16)
+            aesni_run(states, 8, rk, num_rounds, is_encrypt);
+    if (width >= 4)
+        for (; num_blocks >= 4; num_blocks -= 4, states += 4*16)
+            aesni_run(states, 4, rk, num_rounds, is_encrypt);
+    for (; num_blocks > 0; num_blocks--, states += 16)
+        aesni_run(states, 1, rk, num_rounds, is_encrypt);
+}
+
+/**
+ * @brief aes_blocks_keys() with AES-NI, four lanes at a time.
+ */
+AESNI_TARGET
+static void aes_blocks_keys_aesni(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys,
+        int len_key, bool is_encrypt) {
+    int num_rounds = len_key/4 + 6;
+    __m128i rk[4][AESNI_MAX_ROUNDS + 1];
+    __m128i b[4];
+
+    for (; num_blocks >= 4; num_blocks -= 4, states += 4*16, ekeys += 4) {
+#pragma GCC unroll 4
+        for (int l = 0; l < 4; l++) {
+            aesni_schedule(rk[l], ekeys[l], num_rounds, is_encrypt);
+            b[l] = _mm_loadu_si128((const __m128i*)(states + l*16));
+            b[l] = _mm_xor_si128(b[l], rk[l][0]);
+        }
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 4
+            for (int l = 0; l < 4; l++)
+                b[l] = is_encrypt ? _mm_aesenc_si128(b[l], rk[l][r]) : _mm_aesdec_si128(b[l], rk[l][r]);
+#pragma GCC unroll 4
+        for (int l = 0; l < 4; l++) {
+            b[l] = is_encrypt ? _mm_aesenclast_si128(b[l], rk[l][num_rounds])
+                    : _mm_aesdeclast_si128(b[l], rk[l][num_rounds]);
+            _mm_storeu_si128((__m128i*)(states + l*16), b[l]);
+        }
+    }
+    for (; num_blocks > 0; num_blocks--, states += 16, ekeys++) {
+        aesni_schedule(rk[0], *ekeys, num_rounds, is_encrypt);
+        aesni_run(states, 1, rk[0], num_rounds, is_encrypt);
+    }
+}
+
+/**
+ * @brief aes_ctr() with AES-NI. The counter is kept as two native 64-bit
+ *        halves and turned into big-endian blocks with one byte shuffle each,
+ *        eight blocks at a time, and the keystream is XORed into the data
+ *        straight from registers.
+ */
+AESNI_TARGET
+static void aes_ctr_aesni(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    int num_rounds = len_key/4 + 6;
+    __m128i rk[AESNI_MAX_ROUNDS + 1];
+    aesni_schedule(rk, ekey, num_rounds, true);
+
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    uint64_t hi, lo;
+    memcpy(&hi, iv, 8);
+    memcpy(&lo, iv + 8, 8);
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+
+    __m128i b[8];
+    while (len > 0) {
+        int lanes = len >= 8*16 ? 8 : (int)((len + 15) / 16);
+#pragma GCC unroll 8
+        for (int l = 0; l < lanes; l++) {
+            b[l] = _mm_shuffle_epi8(_mm_set_epi64x((long long)hi, (long long)lo), bswap);
+            hi += (++lo == 0);
+        }
+
+        if (len >= 8*16) {
+            aesni_lanes(b, 8, rk, num_rounds, true);
+#pragma GCC unroll 8
+            for (int l = 0; l < 8; l++) {
+                __m128i d = _mm_loadu_si128((const __m128i*)(data + l*16));
+                _mm_storeu_si128((__m128i*)(data + l*16), _mm_xor_si128(d, b[l]));
+            }
+            data += 8*16;
+            len -= 8*16;
+            continue;
+        }
+
+        // Final partial group: one block at a time, the last maybe short
+        uint8_t ks[16];
+        for (int l = 0; l < lanes; l++) {
+            aesni_lanes(b + l, 1, rk, num_rounds, true);
+            _mm_storeu_si128((__m128i*)ks, b[l]);
+            uint64_t n = len < 16 ? len : 16;
+            for (uint64_t i = 0; i < n; i++)
+                data[i] ^= ks[i];
+            data += n;
+            len -= n;
+        }
+    }
+
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+    memcpy(iv, &hi, 8);
+    memcpy(iv + 8, &lo, 8);
+}
+
+/**
+ * @brief CBC decryption with AES-NI, eight blocks at a time, each XORed with
+ *        the ciphertext block before it while still in registers.
+ */
+AESNI_TARGET
+static void aes_cbc_decrypt_aesni(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv) {
+    int num_rounds = len_key/4 + 6;
+    __m128i rk[AESNI_MAX_ROUNDS + 1], c[8], b[8];
+    aesni_schedule(rk, ekey, num_rounds, false);
+
+    __m128i last = _mm_loadu_si128((const __m128i*)iv);
+    while (len >= 16) {
+        int lanes = len >= 8*16 ? 8 : 1;
+#pragma GCC unroll 8
+        for (int l = 0; l < 8; l++)
+            if (l < lanes)
+                c[l] = b[l] = _mm_loadu_si128((const __m128i*)(data + l*16));
+        if (lanes == 8)
+            aesni_lanes(b, 8, rk, num_rounds, false);
+        else
+            aesni_lanes(b, 1, rk, num_rounds, false);
+#pragma GCC unroll 8
+        for (int l = 0; l < 8; l++)
+            if (l < lanes)
+                _mm_storeu_si128((__m128i*)(data + l*16), _mm_xor_si128(b[l], l ? c[l - 1] : last));
+        last = c[lanes - 1];
+        data += lanes*16;
+        len -= lanes*16;
+    }
+    _mm_storeu_si128((__m128i*)iv, last);
+}
+
+/* --------------------------------------------------------------------------
+ * VAES Kernels
+ * -------------------------------------------------------------------------- */
+
+#define VAES256_TARGET __attribute__((target("aes,ssse3,vaes,avx2")))
+#define VAES256_INLINE static inline __attribute__((always_inline, target("aes,ssse3,vaes,avx2")))
+#define VAES512_TARGET __attribute__((target("aes,ssse3,vaes,avx512f,avx512bw")))
+#define VAES512_INLINE static inline __attribute__((always_inline, \
+        target("aes,ssse3,vaes,avx512f,avx512bw")))
+
+/**
+ * @brief Run eight ymm registers, two blocks each, through every round under
+ *        the broadcast schedule wk.
+ */
+VAES256_INLINE void vaes256_rounds(__m256i* b, const __m256i* wk, int num_rounds, bool is_encrypt) {
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; j++)
+        b[j] = _mm256_xor_si256(b[j], wk[0]);
+
+    if (is_encrypt) {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm256_aesenc_epi128(b[j], wk[r]);
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++)
+            b[j] = _mm256_aesenclast_epi128(b[j], wk[num_rounds]);
+    } else {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++)
+                b[j] = _mm256_aesdec_epi128(b[j], wk[r]);
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++)
+            b[j] = _mm256_aesdeclast_epi128(b[j], wk[num_rounds]);
+    }
+}
+
+VAES256_INLINE void vaes256_schedule(__m256i* wk, const uint8_t* ekey, int num_rounds, bool is_encrypt) {
+    __m128i rk[AESNI_MAX_ROUNDS + 1];
+    aesni_schedule(rk, ekey, num_rounds, is_encrypt);
+    for (int r = 0; r <= num_rounds; r++)
+        wk[r] = _mm256_broadcastsi128_si256(rk[r]);
+}
+
+VAES256_TARGET
+static void aes_blocks_vaes256(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key,
+        bool is_encrypt) {
+    int num_rounds = len_key/4 + 6;
+    __m256i wk[AESNI_MAX_ROUNDS + 1], b[8];
+    vaes256_schedule(wk, ekey, num_rounds, is_encrypt);
+
+    for (; num_blocks >= VAES_BLOCKS; num_blocks -= VAES_BLOCKS, states += VAES_BLOCKS*16) {
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++)
+            b[j] = _mm256_loadu_si256((const __m256i*)(states + j*32));
+        vaes256_rounds(b, wk, num_rounds, is_encrypt);
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++)
+            _mm256_storeu_si256((__m256i*)(states + j*32), b[j]);
+    }
+    aes_blocks_aesni(states, num_blocks, ekey, len_key, is_encrypt);
+}
+
+VAES256_TARGET
+static void aes_ctr_vaes256(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    uint64_t passes = len / (VAES_BLOCKS*16);
+    uint64_t hi, lo;
+    memcpy(&hi, iv, 8);
+    memcpy(&lo, iv + 8, 8);
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+    if (passes == 0 || lo > UINT64_MAX - passes*VAES_BLOCKS) {
+        aes_ctr_aesni(data, len, ekey, len_key, iv);
+        return;
+    }
+
+    int num_rounds = len_key/4 + 6;
+    __m256i wk[AESNI_MAX_ROUNDS + 1], ctr[8], b[8];
+    vaes256_schedule(wk, ekey, num_rounds, true);
+    const __m256i bswap = _mm256_broadcastsi128_si256(
+            _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m256i step = _mm256_set_epi64x(0, VAES_BLOCKS, 0, VAES_BLOCKS);
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; j++)
+        ctr[j] = _mm256_set_epi64x((long long)hi, (long long)(lo + 2*j + 1),
+                (long long)hi, (long long)(lo + 2*j));
+
+    for (uint64_t p = 0; p < passes; p++, data += VAES_BLOCKS*16) {
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            b[j] = _mm256_shuffle_epi8(ctr[j], bswap);
+            ctr[j] = _mm256_add_epi64(ctr[j], step);
+        }
+        vaes256_rounds(b, wk, num_rounds, true);
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(data + j*32));
+            _mm256_storeu_si256((__m256i*)(data + j*32), _mm256_xor_si256(d, b[j]));
+        }
+    }
+
+    lo = __builtin_bswap64(lo + passes*VAES_BLOCKS);
+    memcpy(iv + 8, &lo, 8);
+    aes_ctr_aesni(data, len - passes*VAES_BLOCKS*16, ekey, len_key, iv);
+}
+
+VAES256_TARGET
+static void aes_cbc_decrypt_vaes256(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv) {
+    int num_rounds = len_key/4 + 6;
+    __m256i wk[AESNI_MAX_ROUNDS + 1], c[8], b[8];
+    vaes256_schedule(wk, ekey, num_rounds, false);
+
+    // The high lane of last is the chaining value for the next block
+    __m256i last = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)iv));
+    for (; len >= VAES_BLOCKS*16; len -= VAES_BLOCKS*16, data += VAES_BLOCKS*16) {
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++)
+            c[j] = b[j] = _mm256_loadu_si256((const __m256i*)(data + j*32));
+        vaes256_rounds(b, wk, num_rounds, false);
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            __m256i prev = _mm256_permute2x128_si256(j ? c[j - 1] : last, c[j], 0x21);
+            _mm256_storeu_si256((__m256i*)(data + j*32), _mm256_xor_si256(b[j], prev));
+        }
+        last = c[7];
+    }
+
+    _mm_storeu_si128((__m128i*)iv, _mm256_extracti128_si256(last, 1));
+    aes_cbc_decrypt_aesni(data, len, ekey, len_key, iv);
+}
+
+/**
+ * @brief As vaes256_rounds(), with four zmm registers of four blocks each.
+ */
+VAES512_INLINE void vaes512_rounds(__m512i* b, const __m512i* wk, int num_rounds, bool is_encrypt) {
+#pragma GCC unroll 4
+    for (int j = 0; j < 4; j++)
+        b[j] = _mm512_xor_si512(b[j], wk[0]);
+
+    if (is_encrypt) {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; j++)
+                b[j] = _mm512_aesenc_epi128(b[j], wk[r]);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            b[j] = _mm512_aesenclast_epi128(b[j], wk[num_rounds]);
+    } else {
+        for (int r = 1; r < num_rounds; r++)
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; j++)
+                b[j] = _mm512_aesdec_epi128(b[j], wk[r]);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            b[j] = _mm512_aesdeclast_epi128(b[j], wk[num_rounds]);
+    }
+}
+
+VAES512_INLINE void vaes512_schedule(__m512i* wk, const uint8_t* ekey, int num_rounds, bool is_encrypt) {
+    __m128i rk[AESNI_MAX_ROUNDS + 1];
+    aesni_schedule(rk, ekey, num_rounds, is_encrypt);
+    for (int r = 0; r <= num_rounds; r++)
+        wk[r] = _mm512_broadcast_i32x4(rk[r]);
+}
+
+VAES512_TARGET
+static void aes_blocks_vaes512(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key,
+        bool is_encrypt) {
+    int num_rounds = len_key/4 + 6;
+    __m512i wk[AESNI_MAX_ROUNDS + 1], b[4];
+    vaes512_schedule(wk, ekey, num_rounds, is_encrypt);
+
+    for (; num_blocks >= VAES_BLOCKS; num_blocks -= VAES_BLOCKS, states += VAES_BLOCKS*16) {
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            b[j] = _mm512_loadu_si512(states + j*64);
+        vaes512_rounds(b, wk, num_rounds, is_encrypt);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            _mm512_storeu_si512(states + j*64, b[j]);
+    }
+    aes_blocks_aesni(states, num_blocks, ekey, len_key, is_encrypt);
+}
+
+VAES512_TARGET
+static void aes_ctr_vaes512(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    uint64_t passes = len / (VAES_BLOCKS*16);
+    uint64_t hi, lo;
+    memcpy(&hi, iv, 8);
+    memcpy(&lo, iv + 8, 8);
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+    if (passes == 0 || lo > UINT64_MAX - passes*VAES_BLOCKS) {
+        aes_ctr_aesni(data, len, ekey, len_key, iv);
+        return;
+    }
+
+    int num_rounds = len_key/4 + 6;
+    __m512i wk[AESNI_MAX_ROUNDS + 1], ctr[4], b[4];
+    vaes512_schedule(wk, ekey, num_rounds, true);
+    const __m512i bswap = _mm512_broadcast_i32x4(
+            _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m512i step = _mm512_set_epi64(0, VAES_BLOCKS, 0, VAES_BLOCKS, 0, VAES_BLOCKS, 0, VAES_BLOCKS);
+#pragma GCC unroll 4
+    for (int j = 0; j < 4; j++)
+        ctr[j] = _mm512_set_epi64((long long)hi, (long long)(lo + 4*j + 3),
+                (long long)hi, (long long)(lo + 4*j + 2),
+                (long long)hi, (long long)(lo + 4*j + 1),
+                (long long)hi, (long long)(lo + 4*j));
+
+    for (uint64_t p = 0; p < passes; p++, data += VAES_BLOCKS*16) {
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++) {
+            b[j] = _mm512_shuffle_epi8(ctr[j], bswap);
+            ctr[j] = _mm512_add_epi64(ctr[j], step);
+        }
+        vaes512_rounds(b, wk, num_rounds, true);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            _mm512_storeu_si512(data + j*64, _mm512_xor_si512(_mm512_loadu_si512(data + j*64), b[j]));
+    }
+
+    lo = __builtin_bswap64(lo + passes*VAES_BLOCKS);
+    memcpy(iv + 8, &lo, 8);
+    aes_ctr_aesni(data, len - passes*VAES_BLOCKS*16, ekey, len_key, iv);
+}
+
+VAES512_TARGET
+static void aes_cbc_decrypt_vaes512(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv) {
+    int num_rounds = len_key/4 + 6;
+    __m512i wk[AESNI_MAX_ROUNDS + 1], c[4], b[4];
+    vaes512_schedule(wk, ekey, num_rounds, false);
+
+    // Lane 3 of last is the chaining value for the next block; shifting the
+    // pair (c[j], c[j-1]) right by three lanes gives each block its predecessor
+    __m512i last = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)iv));
+    for (; len >= VAES_BLOCKS*16; len -= VAES_BLOCKS*16, data += VAES_BLOCKS*16) {
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++)
+            c[j] = b[j] = _mm512_loadu_si512(data + j*64);
+        vaes512_rounds(b, wk, num_rounds, false);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++) {
+            __m512i prev = _mm512_alignr_epi64(c[j], j ? c[j - 1] : last, 6);
+            _mm512_storeu_si512(data + j*64, _mm512_xor_si512(b[j], prev));
+        }
+        last = c[3];
+    }
+
+    _mm_storeu_si128((__m128i*)iv, _mm512_extracti32x4_epi32(last, 3));
+    aes_cbc_decrypt_aesni(data, len, ekey, len_key, iv);
+}
+
+#endif
+
+/* --------------------------------------------------------------------------
+ * Tiers
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief The highest tier this CPU and OS support.
+ */
+Aes_isa aes_isa_detect() {
+#ifdef AES_ISA_X86
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("aes") || !__builtin_cpu_supports("ssse3"))
+        return AES_ISA_BASELINE;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return AES_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return AES_ISA_AVX2;
+    return AES_ISA_SSSE3;
+#else
+    return AES_ISA_BASELINE;
+#endif
+}
+
+/**
+ * @brief Bind the kernels of the given tier, or of the highest supported
+ *        tier below it. Returns the tier bound. Call it before starting any
+ *        threads that cipher.
+ */
+Aes_isa aes_isa_select(Aes_isa isa) {
+    Aes_isa best = aes_isa_detect();
+    if (isa > best)
+        isa = best;
+
+    aes_kernels = (Aes_kernels)TABLE_KERNELS;
+#ifdef AES_ISA_X86
+    // VAES extends AES-NI rather than replacing it: the single-block and
+    // per-lane-key kernels stay 128-bit
+    bool vaes = __builtin_cpu_supports("vaes");
+    if (isa >= AES_ISA_SSSE3)
+        aes_kernels = (Aes_kernels){ aes_aesni, aes_blocks_aesni, aes_blocks_keys_aesni, aes_ctr_aesni,
+                aes_cbc_decrypt_aesni, "aesni" };
+    if (isa >= AES_ISA_AVX2 && vaes)
+        aes_kernels = (Aes_kernels){ aes_aesni, aes_blocks_vaes256, aes_blocks_keys_aesni,
+                aes_ctr_vaes256, aes_cbc_decrypt_vaes256, "vaes256" };
+    if (isa >= AES_ISA_AVX512 && vaes)
+        aes_kernels = (Aes_kernels){ aes_aesni, aes_blocks_vaes512, aes_blocks_keys_aesni,
+                aes_ctr_vaes512, aes_cbc_decrypt_vaes512, "vaes512" };
+#endif
+    aes_hash_use_aesni(isa >= AES_ISA_SSSE3);
+    hex_use_avx2(isa >= AES_ISA_AVX2);
+
+    current_isa = isa;
+    return isa;
+}
+
+Aes_isa aes_isa_current() {
+    return current_isa;
+}
+
+const char* aes_isa_name(Aes_isa isa) {
+    return isa >= AES_ISA_BASELINE && isa <= AES_ISA_AVX512 ? ISA_NAMES[isa] : "unknown";
+}
+
+/**
+ * @brief Tier for a name from aes_isa_name(), or -1.
+ */
+int aes_isa_parse(const char* name) {
+    for (int i = AES_ISA_BASELINE; i <= AES_ISA_AVX512; i++)
+        if (!strcmp(name, ISA_NAMES[i]))
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Bind the best tier at load time, capped by AES_ISA if it is set.
+ */
+__attribute__((constructor))
+static void aes_isa_bind() {
+    Aes_isa isa = AES_ISA_AVX512;
+    const char* env = getenv("AES_ISA");
+    if (env && aes_isa_parse(env) >= 0)
+        isa = (Aes_isa)aes_isa_parse(env);
+    aes_isa_select(isa);
+}
@@ -0,0 +1,307 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keystore.c
+ *
+ * Description:
+ *   Compact key store, on-the-fly key schedule and hot-key cache.
+ *
+ * Details:
+ *   Word i of the key schedule depends only on words i-1 and i-Nk, so a
+ *   ring of the last Nk words is enough to walk the schedule. aes_compact()
+ *   keeps that ring on the stack and advances it just far enough before each
+ *   round to produce that round's key.
+ *
+ *   Decryption uses the round keys last to first. The ring is first walked
+ *   forward to the end of the schedule, then run backwards:
+ *   word i-Nk = word i ^ f(word i-1), the same step solved for the older
+ *   word. Each earlier round key is recovered just before it is needed.
+ *
+ *   Every lookup adds to the key's heat. Once a key reaches
+ *   AES_KEYSTORE_HOT_THRESHOLD, a miss expands it into its cache entry,
+ *   unless that entry holds a hotter key. Heat is halved over the whole
+ *   store every max(num_keys, AES_KEYSTORE_DECAY_MIN) lookups, so keys that
+ *   stop being used cool down and can be displaced. Lookups are counted as
+ *   cache hits and misses in the runtime metrics.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_keystore.h"
+#include "../include/aes_metrics.h"
+
+typedef struct key_walker {
+    uint32_t w[8];      // w[i % nk] holds schedule word i, for lo <= i < hi
+    int nk;
+    int lo;
+    int hi;
+} Key_walker;
+
+/* --------------------------------------------------------------------------
+ * On-the-fly Key Schedule
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief The value XORed with word i-Nk to give word i, from word i-1.
+ */
+static uint32_t schedule_temp(uint32_t prev, int i, int nk) {
+    if (i % nk == 0)
+        return sub_word(rot_word(prev)) ^ rcon(i/nk - 1);
+    if (nk == 8 && i % nk == 4)
+        return sub_word(prev);
+    return prev;
+}
+
+static void walker_init(Key_walker* kw, const uint8_t* key, int len_key) {
+    kw->nk = len_key / 4;
+    for (int i = 0; i < kw->nk; i++)
+        kw->w[i] = K((uint8_t*)key, len_key, i*4);
+    kw->lo = 0;
+    kw->hi = kw->nk;
+}
+
+/**
+ * @brief Produce word hi, dropping word lo.
+ */
+static void walker_forward(Key_walker* kw) {
+    int i = kw->hi;
+    kw->w[i % kw->nk] ^= schedule_temp(kw->w[(i - 1) % kw->nk], i, kw->nk);
+    kw->lo++;
+    kw->hi++;
+}
+
+/**
+ * @brief Recover word lo - 1, dropping word hi - 1.
+ */
+static void walker_backward(Key_walker* kw) {
+    int i = kw->hi - 1;
+    kw->w[i % kw->nk] ^= schedule_temp(kw->w[(i - 1) % kw->nk], i, kw->nk);
+    kw->lo--;
+    kw->hi--;
+}
+
+/**
+ * @brief Move the ring to cover round r and write its 16-byte round key.
+ */
+static void walker_round_key(Key_walker* kw, int r, uint8_t* rk) {
+    while (kw->hi < 4*r + 4)
+        walker_forward(kw);
+    while (kw->lo > 4*r)
+        walker_backward(kw);
+    for (int j = 0; j < 4; j++)
+        store_ekey(rk + j*4, kw->w[(4*r + j) % kw->nk]);
+}
+
+/**
+ * @brief aes() from the raw key, generating each round key as it is reached
+ *        instead of reading an expanded schedule.
+ */
+void aes_compact(uint8_t* state, const uint8_t* key, int len_key, bool is_encrypt) {
+    Key_walker kw;
+    uint8_t rk[16];
+    int num_rounds = len_key/4 + 6;
+    walker_init(&kw, key, len_key);
+
+    if (is_encrypt) {
+        walker_round_key(&kw, 0, rk);
+        add_round_key(state, rk, 0);
+        for (int r = 1; r < num_rounds; r++) {
+            byte_sub(state, is_encrypt);
+            shift_row(state, is_encrypt);
+            mix_column(state, is_encrypt);
+            walker_round_key(&kw, r, rk);
+            add_round_key(state, rk, 0);
+        }
+        byte_sub(state, is_encrypt);
+        shift_row(state, is_encrypt);
+        walker_round_key(&kw, num_rounds, rk);
+        add_round_key(state, rk, 0);
+
+    } else {
+        walker_round_key(&kw, num_rounds, rk);
+        add_round_key(state, rk, 0);
+        for (int r = num_rounds - 1; r > 0; r--) {
+            shift_row(state, is_encrypt);
+            byte_sub(state, is_encrypt);
+            walker_round_key(&kw, r, rk);
+            add_round_key(state, rk, 0);
+            mix_column(state, is_encrypt);
+        }
+        shift_row(state, is_encrypt);
+        byte_sub(state, is_encrypt);
+        walker_round_key(&kw, 0, rk);
+        add_round_key(state, rk, 0);
+    }
+
+    memset(&kw, 0, sizeof(kw));
+    memset(rk, 0, sizeof(rk));
+}
+
+/* --------------------------------------------------------------------------
+ * Hot-Key Cache
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Record a use of key id and return its cached schedule, admitting it
+ *        to the cache if it has become hot. Returns NULL for a cold key.
+ */
+static uint8_t* keystore_lookup(Aes_keystore* ks, int64_t id) {
+    if (ks->heat[id] < UINT8_MAX)
+        ks->heat[id]++;
+
+    uint64_t period = ks->num_keys > AES_KEYSTORE_DECAY_MIN ? ks->num_keys : AES_KEYSTORE_DECAY_MIN;
+    if (++ks->lookups >= period) {
+        for (uint64_t k = 0; k < ks->num_keys; k++)
+            ks->heat[k] >>= 1;
+        ks->lookups = 0;
+    }
+
+    if (ks->cache_size == 0) {
+        ks->misses++;
+        metrics_count_cache(false);
+        return NULL;
+    }
+
+    Keystore_entry* e = &ks->cache[id & (ks->cache_size - 1)];
+    if (e->id == id) {
+        ks->hits++;
+        metrics_count_cache(true);
+        return e->ekey;
+    }
+    ks->misses++;
+    metrics_count_cache(false);
+
+    if (ks->heat[id] >= AES_KEYSTORE_HOT_THRESHOLD && (e->id < 0 || ks->heat[e->id] <= ks->heat[id])) {
+        expand_key(ks->keys[id], ks->len_keys[id], e->ekey);
+        e->id = id;
+        return e->ekey;
+    }
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Create an empty store with room for capacity keys before it grows,
+ *        and a schedule cache of cache_entries (rounded up to a power of two,
+ *        0 for none). Returns 0 on success, -1 on error.
+ */
+int aes_keystore_init(Aes_keystore* ks, uint64_t capacity, uint32_t cache_entries) {
+    memset(ks, 0, sizeof(*ks));
+    if (capacity == 0)
+        capacity = 16;
+
+    ks->keys = malloc(capacity * 32);
+    ks->len_keys = malloc(capacity);
+    ks->heat = malloc(capacity);
+    ks->capacity = capacity;
+
+    if (cache_entries > 0) {
+        uint32_t size = 1;
+        while (size < cache_entries)
+            size <<= 1;
+        ks->cache = malloc(sizeof(Keystore_entry) * size);
+        ks->cache_size = size;
+        for (uint32_t i = 0; ks->cache && i < size; i++)
+            ks->cache[i].id = -1;
+    }
+
+    if (!ks->keys || !ks->len_keys || !ks->heat || (cache_entries > 0 && !ks->cache)) {
+        fprintf(stderr, "Error: failed to allocate key store\n");
+        aes_keystore_free(ks);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Add a raw key. Returns its id, or -1 for a bad length or on error.
+ */
+int64_t aes_keystore_add(Aes_keystore* ks, const uint8_t* key, int len_key) {
+    if (len_key != 16 && len_key != 24 && len_key != 32)
+        return -1;
+
+    if (ks->num_keys == ks->capacity) {
+        uint64_t capacity = ks->capacity * 2;
+        uint8_t (*keys)[32] = realloc(ks->keys, capacity * 32);
+        if (keys)
+            ks->keys = keys;
+        uint8_t* len_keys = realloc(ks->len_keys, capacity);
+        if (len_keys)
+            ks->len_keys = len_keys;
+        uint8_t* heat = realloc(ks->heat, capacity);
+        if (heat)
+            ks->heat = heat;
+        if (!keys || !len_keys || !heat) {
+            fprintf(stderr, "Error: failed to grow key store\n");
+            return -1;
+        }
+        ks->capacity = capacity;
+    }
+
+    int64_t id = ks->num_keys++;
+    memcpy(ks->keys[id], key, len_key);
+    ks->len_keys[id] = (uint8_t)len_key;
+    ks->heat[id] = 0;
+    return id;
+}
+
+/**
+ * @brief Encrypt or decrypt num_blocks blocks in place under key id, each
+ *        independently as in ECB.
+ */
+void aes_keystore_ecb(Aes_keystore* ks, int64_t id, uint8_t* blocks, uint64_t num_blocks,
+        bool is_encrypt) {
+    int len_key = ks->len_keys[id];
+    uint8_t* ekey = keystore_lookup(ks, id);
+    if (ekey) {
+        aes_blocks(blocks, num_blocks, ekey, len_key, is_encrypt);
+        return;
+    }
+
+    // A cold key used for a few blocks never has its schedule stored
+    if (num_blocks <= AES_KEYSTORE_ONTHEFLY_BLOCKS) {
+        for (uint64_t b = 0; b < num_blocks; b++)
+            aes_compact(blocks + b*16, ks->keys[id], len_key, is_encrypt);
+        return;
+    }
+
+    uint8_t local[240];
+    expand_key(ks->keys[id], len_key, local);
+    aes_blocks(blocks, num_blocks, local, len_key, is_encrypt);
+    memset(local, 0, sizeof(local));
+}
+
+/**
+ * @brief Run any mode under key id, as aes_mode() would with its expanded key.
+ */
+void aes_keystore_mode(Aes_keystore* ks, int64_t id, Op_mode op_mode, uint8_t* data,
+        uint64_t len, uint8_t* iv, bool is_encrypt) {
+    int len_key = ks->len_keys[id];
+    uint8_t* ekey = keystore_lookup(ks, id);
+    if (ekey) {
+        aes_mode(op_mode, data, len, ekey, len_key, iv, is_encrypt);
+        return;
+    }
+
+    // Cold keys get a transient schedule that lives only for this call
+    uint8_t local[240];
+    expand_key(ks->keys[id], len_key, local);
+    aes_mode(op_mode, data, len, local, len_key, iv, is_encrypt);
+    memset(local, 0, sizeof(local));
+}
+
+/**
+ * @brief Wipe and release every key and cached schedule.
+ */
+void aes_keystore_free(Aes_keystore* ks) {
+    if (ks->keys)
+        memset(ks->keys, 0, ks->capacity * 32);
+    if (ks->cache)
+        memset(ks->cache, 0, sizeof(Keystore_entry) * ks->cache_size);
+    free(ks->keys);
+    free(ks->len_keys);
+    free(ks->heat);
+    free(ks->cache);
+    memset(ks, 0, sizeof(*ks));
+}
@@ -0,0 +1,228 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keystream.c
+ *
+ * Description:
+ *   Background keystream producer and ring buffer for OFB and CTR.
+ *
+ * Details:
+ *   OFB and CTR keystream depends only on the key and IV, never on the data,
+ *   so it can be generated before the data exists. The producer thread runs
+ *   the cipher a batch at a time into a ring buffer and publishes each batch
+ *   by advancing head; the consumer XORs data against the bytes between tail
+ *   and head and advances tail. head and tail are free-running byte counts,
+ *   so the ring is full when head - tail == capacity and empty when they are
+ *   equal.
+ *
+ *   Neither side takes the lock while there is work to do. A side that has
+ *   to sleep raises its waiting flag, re-checks the ring under the lock and
+ *   waits on its condition variable; the other side only takes the lock to
+ *   signal when it sees that flag. Both use sequentially consistent atomics,
+ *   so either the sleeper sees the new head/tail on its re-check or the
+ *   other side sees the flag, and no wakeup is lost.
+ *
+ *   There is one producer and one consumer: a context must not be shared by
+ *   threads calling aes_keystream_xor() concurrently.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_keystream.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Generate the next batch of keystream into dst, advancing the IV.
+ */
+static void produce_batch(Aes_keystream* ks, uint8_t* dst) {
+    if (ks->op_mode == CTR) {
+        for (int i = 0; i < AES_KEYSTREAM_BATCH; i += 16) {
+            memcpy(dst + i, ks->iv, 16);
+            ctr_increment(ks->iv);
+        }
+        aes_blocks(dst, AES_KEYSTREAM_BATCH / 16, ks->ekey, ks->len_key, true);
+    } else {
+        for (int i = 0; i < AES_KEYSTREAM_BATCH; i += 16) {
+            aes(ks->iv, ks->ekey, ks->len_key, true);
+            memcpy(dst + i, ks->iv, 16);
+        }
+    }
+}
+
+static void* producer_main(void* arg) {
+    Aes_keystream* ks = arg;
+    uint64_t head = atomic_load(&ks->head);
+
+    while (!atomic_load(&ks->stop)) {
+        if (ks->capacity - (head - atomic_load(&ks->tail)) < AES_KEYSTREAM_BATCH) {
+            pthread_mutex_lock(&ks->lock);
+            atomic_store(&ks->producer_waiting, true);
+            while (!atomic_load(&ks->stop) &&
+                    ks->capacity - (head - atomic_load(&ks->tail)) < AES_KEYSTREAM_BATCH)
+                pthread_cond_wait(&ks->space, &ks->lock);
+            atomic_store(&ks->producer_waiting, false);
+            pthread_mutex_unlock(&ks->lock);
+            continue;
+        }
+
+        // The capacity is a whole number of batches, so a batch never wraps
+        produce_batch(ks, ks->ring + head % ks->capacity);
+        head += AES_KEYSTREAM_BATCH;
+        atomic_store(&ks->head, head);
+
+        if (atomic_load(&ks->consumer_waiting)) {
+            pthread_mutex_lock(&ks->lock);
+            pthread_cond_signal(&ks->data);
+            pthread_mutex_unlock(&ks->lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief XOR len bytes of src into dst, 16 bytes at a time where possible
+ *        (8 without SSE2).
+ */
+static void xor_stream(uint8_t* dst, const uint8_t* src, uint64_t len) {
+    uint64_t i = 0;
+#ifdef __SSE2__
+    for (; i + 64 <= len; i += 64) {
+        for (int j = 0; j < 64; j += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i + j));
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i + j));
+            _mm_storeu_si128((__m128i*)(dst + i + j), _mm_xor_si128(d, s));
+        }
+    }
+    for (; i + 16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, s));
+    }
+#else
+    for (; i + 8 <= len; i += 8) {
+        uint64_t d, s;
+        memcpy(&d, dst + i, 8);
+        memcpy(&s, src + i, 8);
+        d ^= s;
+        memcpy(dst + i, &d, 8);
+    }
+#endif
+    for (; i < len; i++)
+        dst[i] ^= src[i];
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Start a keystream for OFB or CTR under an expanded key and IV, with a
+ *        ring of at least capacity bytes (0 for the default). The key schedule
+ *        is copied. Returns 0 on success, -1 on error.
+ */
+int aes_keystream_init(Aes_keystream* ks, Op_mode op_mode, uint8_t* ekey, int len_key,
+        const uint8_t* iv, uint64_t capacity) {
+    if (op_mode != OFB && op_mode != CTR) {
+        fprintf(stderr, "Error: keystream precomputation needs OFB or CTR\n");
+        return -1;
+    }
+
+    if (capacity == 0)
+        capacity = AES_KEYSTREAM_DEFAULT_CAPACITY;
+    capacity = (capacity + AES_KEYSTREAM_BATCH - 1) / AES_KEYSTREAM_BATCH * AES_KEYSTREAM_BATCH;
+    if (capacity < 2 * AES_KEYSTREAM_BATCH)
+        capacity = 2 * AES_KEYSTREAM_BATCH;
+
+    ks->op_mode = op_mode;
+    memcpy(ks->ekey, ekey, 16 * (len_key/4 + 7));
+    ks->len_key = len_key;
+    memcpy(ks->iv, iv, 16);
+    ks->capacity = capacity;
+    if (posix_memalign((void**)&ks->ring, 64, capacity)) {
+        fprintf(stderr, "Error: failed to allocate keystream buffer\n");
+        return -1;
+    }
+
+    atomic_init(&ks->head, 0);
+    atomic_init(&ks->tail, 0);
+    atomic_init(&ks->producer_waiting, false);
+    atomic_init(&ks->consumer_waiting, false);
+    atomic_init(&ks->stop, false);
+    pthread_mutex_init(&ks->lock, NULL);
+    pthread_cond_init(&ks->space, NULL);
+    pthread_cond_init(&ks->data, NULL);
+
+    if (pthread_create(&ks->producer, NULL, producer_main, ks)) {
+        fprintf(stderr, "Error: failed to start keystream producer\n");
+        pthread_mutex_destroy(&ks->lock);
+        pthread_cond_destroy(&ks->space);
+        pthread_cond_destroy(&ks->data);
+        free(ks->ring);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Encrypt or decrypt the next len bytes of the stream in place. Waits
+ *        only if the producer has fallen behind.
+ */
+void aes_keystream_xor(Aes_keystream* ks, uint8_t* data, uint64_t len) {
+    uint64_t tail = atomic_load(&ks->tail);
+
+    while (len > 0) {
+        uint64_t avail = atomic_load(&ks->head) - tail;
+        if (avail == 0) {
+            pthread_mutex_lock(&ks->lock);
+            atomic_store(&ks->consumer_waiting, true);
+            while (atomic_load(&ks->head) == tail)
+                pthread_cond_wait(&ks->data, &ks->lock);
+            atomic_store(&ks->consumer_waiting, false);
+            pthread_mutex_unlock(&ks->lock);
+            continue;
+        }
+
+        uint64_t offset = tail % ks->capacity;
+        uint64_t n = len < avail ? len : avail;
+        if (n > ks->capacity - offset)
+            n = ks->capacity - offset;
+
+        xor_stream(data, ks->ring + offset, n);
+        data += n;
+        len -= n;
+        tail += n;
+        atomic_store(&ks->tail, tail);
+
+        if (atomic_load(&ks->producer_waiting)) {
+            pthread_mutex_lock(&ks->lock);
+            pthread_cond_signal(&ks->space);
+            pthread_mutex_unlock(&ks->lock);
+        }
+    }
+}
+
+/**
+ * @brief Bytes of keystream ready to be consumed without waiting.
+ */
+uint64_t aes_keystream_available(Aes_keystream* ks) {
+    return atomic_load(&ks->head) - atomic_load(&ks->tail);
+}
+
+/**
+ * @brief Stop the producer and wipe and release the keystream.
+ */
+void aes_keystream_destroy(Aes_keystream* ks) {
+    pthread_mutex_lock(&ks->lock);
+    atomic_store(&ks->stop, true);
+    pthread_cond_signal(&ks->space);
+    pthread_mutex_unlock(&ks->lock);
+    pthread_join(ks->producer, NULL);
+
+    pthread_mutex_destroy(&ks->lock);
+    pthread_cond_destroy(&ks->space);
+    pthread_cond_destroy(&ks->data);
+    memset(ks->ring, 0, ks->capacity);
+    memset(ks->ekey, 0, sizeof(ks->ekey));
+    free(ks->ring);
+}
@@ -0,0 +1,212 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_keywrap.c
+ *
+ * Description:
+ *   AES Key Wrap (RFC 3394) and Key Wrap with Padding (RFC 5649).
+ *
+ * Details:
+ *   Wrapping n 64-bit blocks of key data takes 6·n dependent AES calls, each
+ *   on the running integrity register A and one block R[i]. A single key is
+ *   a serial chain, but different keys are independent, so the batch engine
+ *   keeps up to AES_INTERLEAVE_MAX keys in flight as lanes. Every pass
+ *   builds one A || R[i] block per lane, runs them through aes_blocks()
+ *   together, and advances each lane by one step. A lane that finishes is
+ *   refilled with the next key, so keys of different lengths mix freely and
+ *   the interleaved core stays full until the batch runs dry.
+ *
+ *   The single-key functions are a batch of one.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_keywrap.h"
+
+static const uint8_t KW_IV[8]  = { 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6, 0xA6 };
+static const uint8_t KWP_IV[4] = { 0xA6, 0x59, 0x59, 0xA6 };
+
+typedef struct kw_lane {
+    Kw_item* item;
+    uint8_t a[8];           // Integrity register
+    uint8_t* r;             // R[0..n-1], kept in the item's output buffer
+    uint64_t n;             // 64-bit blocks of key data
+    uint64_t total;         // Steps to run: 6·n, or 1 for a single-block KWP key
+    uint64_t done;          // Steps completed
+} Kw_lane;
+
+/**
+ * @brief XOR the 64-bit big-endian step counter t into A.
+ */
+static void xor_step(uint8_t* a, uint64_t t) {
+    for (int i = 7; i >= 0; i--, t >>= 8)
+        a[i] ^= (uint8_t)t;
+}
+
+/**
+ * @brief Validate an item and load it into a lane. Returns false, with the
+ *        item's result set, if its length is not valid.
+ */
+static bool lane_load(Kw_lane* lane, Kw_item* item, bool is_wrap, bool padded) {
+    uint64_t len = item->len_in;
+    lane->item = item;
+    lane->done = 0;
+
+    if (is_wrap) {
+        if (padded ? len == 0 || len > 0xFFFFFFFF : len < 16 || len % 8 != 0) {
+            item->result = KW_ERR_LENGTH;
+            return false;
+        }
+        lane->n = (len + 7) / 8;
+        lane->r = item->out + 8;
+        memcpy(lane->r, item->in, len);
+        memset(lane->r + len, 0, lane->n*8 - len);
+
+        if (padded) {
+            memcpy(lane->a, KWP_IV, 4);
+            for (int i = 0; i < 4; i++)
+                lane->a[4 + i] = (uint8_t)(len >> (24 - 8*i));
+        } else {
+            memcpy(lane->a, KW_IV, 8);
+        }
+    } else {
+        if (len % 8 != 0 || len < (padded ? 16u : 24u)) {
+            item->result = KW_ERR_LENGTH;
+            return false;
+        }
+        lane->n = len / 8 - 1;
+        lane->r = item->out;
+        memcpy(lane->a, item->in, 8);
+        memcpy(lane->r, item->in + 8, lane->n*8);
+    }
+
+    // RFC 5649 wraps a single block of key data with one plain AES call
+    lane->total = padded && lane->n == 1 ? 1 : 6*lane->n;
+    return true;
+}
+
+/**
+ * @brief Write the finished lane's result: the wrapped key, or the unwrapped
+ *        key after checking the integrity register.
+ */
+static void lane_finish(Kw_lane* lane, bool is_wrap, bool padded) {
+    Kw_item* item = lane->item;
+
+    if (is_wrap) {
+        memcpy(item->out, lane->a, 8);
+        item->result = 8 + lane->n*8;
+        return;
+    }
+
+    int64_t result = KW_ERR_INTEGRITY;
+    if (!padded) {
+        if (!memcmp(lane->a, KW_IV, 8))
+            result = lane->n*8;
+    } else if (!memcmp(lane->a, KWP_IV, 4)) {
+        uint64_t mli = ((uint64_t)lane->a[4] << 24) | (lane->a[5] << 16) | (lane->a[6] << 8) | lane->a[7];
+        bool valid = mli > (lane->n - 1)*8 && mli <= lane->n*8;
+        for (uint64_t i = mli; valid && i < lane->n*8; i++)
+            valid = lane->r[i] == 0;
+        if (valid)
+            result = mli;
+    }
+
+    // Never hand back key material that failed the check
+    if (result < 0)
+        memset(lane->r, 0, lane->n*8);
+    item->result = result;
+}
+
+/**
+ * @brief Run a batch of wraps or unwraps through the interleaved lanes.
+ */
+static void kw_run(Kw_item* items, int num_items, uint8_t* ekey, int len_key, bool is_wrap,
+        bool padded) {
+    Kw_lane lanes[AES_INTERLEAVE_MAX];
+    uint8_t buf[AES_INTERLEAVE_MAX*16];
+    int active = 0;
+    int next = 0;
+
+    for (;;) {
+        // Refill empty lanes, keeping the active ones packed at the front
+        while (active < AES_INTERLEAVE_MAX && next < num_items)
+            if (lane_load(&lanes[active], &items[next++], is_wrap, padded))
+                active++;
+        if (active == 0)
+            break;
+
+        for (int l = 0; l < active; l++) {
+            Kw_lane* lane = &lanes[l];
+            uint64_t s = is_wrap ? lane->done : lane->total - 1 - lane->done;
+            memcpy(buf + l*16, lane->a, 8);
+            memcpy(buf + l*16 + 8, lane->r + (s % lane->n)*8, 8);
+            if (!is_wrap && lane->total > 1)
+                xor_step(buf + l*16, s + 1);
+        }
+
+        aes_blocks(buf, active, ekey, len_key, is_wrap);
+
+        for (int l = 0; l < active; ) {
+            Kw_lane* lane = &lanes[l];
+            uint64_t s = is_wrap ? lane->done : lane->total - 1 - lane->done;
+            memcpy(lane->a, buf + l*16, 8);
+            memcpy(lane->r + (s % lane->n)*8, buf + l*16 + 8, 8);
+            if (is_wrap && lane->total > 1)
+                xor_step(lane->a, s + 1);
+
+            if (++lane->done < lane->total) {
+                l++;
+                continue;
+            }
+
+            lane_finish(lane, is_wrap, padded);
+
+            // Move the last active lane into this slot, and its block with it
+            active--;
+            if (l != active) {
+                lanes[l] = lanes[active];
+                memcpy(buf + l*16, buf + active*16, 16);
+            }
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Wrap many keys under one expanded key-encryption key. Each item's
+ *        result is the wrapped length or a KW_ERR_* code.
+ */
+void aes_key_wrap_batch(Kw_item* items, int num_items, uint8_t* ekey, int len_key, bool padded) {
+    kw_run(items, num_items, ekey, len_key, true, padded);
+}
+
+/**
+ * @brief Unwrap many keys under one expanded key-encryption key. Each item's
+ *        result is the key length or a KW_ERR_* code.
+ */
+void aes_key_unwrap_batch(Kw_item* items, int num_items, uint8_t* ekey, int len_key, bool padded) {
+    kw_run(items, num_items, ekey, len_key, false, padded);
+}
+
+/**
+ * @brief Wrap one key with KW, or KWP if padded. Returns the wrapped length
+ *        or a KW_ERR_* code.
+ */
+int64_t aes_key_wrap(const uint8_t* in, uint64_t len_in, uint8_t* ekey, int len_key,
+        uint8_t* out, bool padded) {
+    Kw_item item = { in, len_in, out, 0 };
+    kw_run(&item, 1, ekey, len_key, true, padded);
+    return item.result;
+}
+
+/**
+ * @brief Unwrap one key with KW, or KWP if padded. Returns the key length
+ *        or a KW_ERR_* code.
+ */
+int64_t aes_key_unwrap(const uint8_t* in, uint64_t len_in, uint8_t* ekey, int len_key,
+        uint8_t* out, bool padded) {
+    Kw_item item = { in, len_in, out, 0 };
+    kw_run(&item, 1, ekey, len_key, false, padded);
+    return item.result;
+}
@@ -0,0 +1,310 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_mac.c
+ *
+ * Description:
+ *   CMAC and PMAC message authentication codes.
+ *
+ * Details:
+ *   CMAC is a CBC-MAC whose final block is masked with one of two subkeys
+ *   derived by doubling E_K(0) in GF(2^128). It is a serial chain through
+ *   aes(), so it is offered both one-shot and as init/update/final.
+ *
+ *   PMAC1 encrypts every block but the last under its own offset and XORs
+ *   the results together, so the block encryptions are independent. The
+ *   offset of block i is the XOR of L(k) over the bits k set in the Gray
+ *   code of i, which lets each thread start at an arbitrary block without
+ *   walking the offsets before it; within a thread, blocks go through the
+ *   interleaved core 8 at a time.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_mac.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Smallest share of blocks worth handing to a separate PMAC thread
+#define PMAC_MIN_BLOCKS_PER_THREAD 4096
+
+/* --------------------------------------------------------------------------
+ * GF(2^128) Helpers
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Multiply a big-endian 128-bit block by x modulo x^128 + x^7 + x^2 + x + 1.
+ */
+void gf128_double(uint8_t* block) {
+    uint8_t carry = block[0] >> 7;
+    for (int i = 0; i < 15; i++)
+        block[i] = (uint8_t)(block[i] << 1) | (block[i + 1] >> 7);
+    block[15] = (uint8_t)(block[15] << 1) ^ (carry ? 0x87 : 0x00);
+}
+
+/**
+ * @brief Multiply a big-endian 128-bit block by x^-1, the inverse of gf128_double().
+ */
+void gf128_halve(uint8_t* block) {
+    uint8_t carry = block[15] & 1;
+    for (int i = 15; i > 0; i--)
+        block[i] = (block[i] >> 1) | (uint8_t)(block[i - 1] << 7);
+    block[0] >>= 1;
+    if (carry) {
+        block[0] ^= 0x80;
+        block[15] ^= 0x43;
+    }
+}
+
+static void xor_block(uint8_t* dst, const uint8_t* src) {
+    for (int i = 0; i < 16; i++)
+        dst[i] ^= src[i];
+}
+
+/* --------------------------------------------------------------------------
+ * CMAC
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Derive the CMAC subkeys K1 = 2·E_K(0) and K2 = 4·E_K(0).
+ */
+void cmac_subkeys(uint8_t* ekey, int len_key, uint8_t* k1, uint8_t* k2) {
+    memset(k1, 0, 16);
+    aes(k1, ekey, len_key, true);
+    gf128_double(k1);
+    memcpy(k2, k1, 16);
+    gf128_double(k2);
+}
+
+/**
+ * @brief Start an incremental CMAC under an expanded key.
+ */
+void cmac_init(Cmac_ctx* ctx, uint8_t* ekey, int len_key) {
+    ctx->ekey = ekey;
+    ctx->len_key = len_key;
+    cmac_subkeys(ekey, len_key, ctx->k1, ctx->k2);
+    memset(ctx->state, 0, 16);
+    ctx->len_partial = 0;
+}
+
+/**
+ * @brief Absorb the next piece of the message. The last block seen is held
+ *        back, since it is masked differently if nothing follows it.
+ */
+void cmac_update(Cmac_ctx* ctx, const uint8_t* msg, uint64_t len) {
+    if (len == 0)
+        return;
+
+    if (ctx->len_partial < 16) {
+        uint64_t n = 16 - ctx->len_partial;
+        if (n > len)
+            n = len;
+        memcpy(ctx->partial + ctx->len_partial, msg, n);
+        ctx->len_partial += n;
+        msg += n;
+        len -= n;
+    }
+    if (len == 0)
+        return;
+
+    // More data follows, so the held block is not the last one
+    xor_block(ctx->state, ctx->partial);
+    aes(ctx->state, ctx->ekey, ctx->len_key, true);
+
+    for (; len > 16; msg += 16, len -= 16) {
+        xor_block(ctx->state, msg);
+        aes(ctx->state, ctx->ekey, ctx->len_key, true);
+    }
+
+    memcpy(ctx->partial, msg, len);
+    ctx->len_partial = len;
+}
+
+/**
+ * @brief Finish the CMAC and write the 16-byte tag.
+ */
+void cmac_final(Cmac_ctx* ctx, uint8_t* tag) {
+    if (ctx->len_partial == 16) {
+        xor_block(ctx->state, ctx->k1);
+    } else {
+        ctx->partial[ctx->len_partial] = 0x80;
+        memset(ctx->partial + ctx->len_partial + 1, 0, 15 - ctx->len_partial);
+        xor_block(ctx->state, ctx->k2);
+    }
+    xor_block(ctx->state, ctx->partial);
+    aes(ctx->state, ctx->ekey, ctx->len_key, true);
+    memcpy(tag, ctx->state, 16);
+}
+
+/**
+ * @brief One-shot CMAC of a complete message.
+ */
+void aes_cmac(const uint8_t* msg, uint64_t len, uint8_t* ekey, int len_key, uint8_t* tag) {
+    Cmac_ctx ctx;
+    cmac_init(&ctx, ekey, len_key);
+    cmac_update(&ctx, msg, len);
+    cmac_final(&ctx, tag);
+}
+
+/* --------------------------------------------------------------------------
+ * PMAC
+ * -------------------------------------------------------------------------- */
+
+typedef struct pmac_job {
+    const uint8_t* msg;
+    uint64_t first;         // First block, numbered from 1
+    uint64_t last;          // Last block, inclusive
+    uint8_t (*l)[16];       // L(k) = 2^k·E_K(0)
+    uint8_t* ekey;
+    int len_key;
+    uint8_t sigma[16];      // XOR of this range's encrypted blocks
+} Pmac_job;
+
+/**
+ * @brief Accumulate E_K(M_i ^ offset_i) for blocks first..last into job->sigma.
+ */
+static void* pmac_range(void* arg) {
+    Pmac_job* job = arg;
+    uint8_t offset[16] = {0};
+    uint8_t buf[AES_INTERLEAVE_MAX*16];
+
+    // Offset of the block before the range, from the Gray code of its index
+    uint64_t gray = (job->first - 1) ^ ((job->first - 1) >> 1);
+    for (int k = 0; gray; k++, gray >>= 1)
+        if (gray & 1)
+            xor_block(offset, job->l[k]);
+
+    memset(job->sigma, 0, 16);
+    for (uint64_t i = job->first; i <= job->last; ) {
+        uint64_t remaining = job->last - i + 1;
+        int lanes = remaining >= AES_INTERLEAVE_MAX ? AES_INTERLEAVE_MAX : (int)remaining;
+
+        for (int l = 0; l < lanes; l++) {
+            xor_block(offset, job->l[__builtin_ctzll(i + l)]);
+            memcpy(buf + l*16, job->msg + (i + l - 1)*16, 16);
+            xor_block(buf + l*16, offset);
+        }
+        aes_blocks(buf, lanes, job->ekey, job->len_key, true);
+        for (int l = 0; l < lanes; l++)
+            xor_block(job->sigma, buf + l*16);
+
+        i += lanes;
+    }
+    return NULL;
+}
+
+/**
+ * @brief PMAC1 of a complete message. The blocks are split across
+ *        num_threads threads (0 for one per online CPU) when the message is
+ *        large enough to be worth it.
+ */
+void aes_pmac(const uint8_t* msg, uint64_t len, uint8_t* ekey, int len_key, uint8_t* tag,
+        int num_threads) {
+    uint8_t l[64][16];
+    memset(l[0], 0, 16);
+    aes(l[0], ekey, len_key, true);
+    for (int k = 1; k < 64; k++) {
+        memcpy(l[k], l[k - 1], 16);
+        gf128_double(l[k]);
+    }
+
+    // Every block but the last goes through the offset path
+    uint64_t num_blocks = len == 0 ? 1 : (len + 15) / 16;
+    uint64_t body = num_blocks - 1;
+
+    if (num_threads <= 0)
+        num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((uint64_t)num_threads > body / PMAC_MIN_BLOCKS_PER_THREAD)
+        num_threads = (int)(body / PMAC_MIN_BLOCKS_PER_THREAD);
+    if (num_threads < 1)
+        num_threads = 1;
+
+    Pmac_job* jobs = malloc(sizeof(Pmac_job) * num_threads);
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    for (int t = 0; t < num_threads; t++) {
+        jobs[t].msg = msg;
+        jobs[t].first = 1 + body * t / num_threads;
+        jobs[t].last = body * (t + 1) / num_threads;
+        jobs[t].l = l;
+        jobs[t].ekey = ekey;
+        jobs[t].len_key = len_key;
+        if (t > 0)
+            pthread_create(&threads[t], NULL, pmac_range, &jobs[t]);
+    }
+    pmac_range(&jobs[0]);
+
+    uint8_t sigma[16];
+    memcpy(sigma, jobs[0].sigma, 16);
+    for (int t = 1; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+        xor_block(sigma, jobs[t].sigma);
+    }
+    free(jobs);
+    free(threads);
+
+    // A full final block is masked with L(-1), a partial one is 10* padded
+    uint8_t last[16] = {0};
+    uint64_t len_last = len - body*16;
+    if (len_last > 0)
+        memcpy(last, msg + body*16, len_last);
+    if (len_last == 16) {
+        uint8_t l_inv[16];
+        memcpy(l_inv, l[0], 16);
+        gf128_halve(l_inv);
+        xor_block(last, l_inv);
+    } else {
+        last[len_last] = 0x80;
+    }
+    xor_block(sigma, last);
+
+    aes(sigma, ekey, len_key, true);
+    memcpy(tag, sigma, 16);
+}
+
+/* --------------------------------------------------------------------------
+ * Files
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Compute the MAC of a whole file, mapped into memory rather than read.
+ *        Returns 0 on success, -1 on error.
+ */
+int aes_mac_file(char* vector_file, Mac_type mac_type, uint8_t* ekey, int len_key,
+        uint8_t* tag, int num_threads) {
+    int fd = open(vector_file, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: failed to open %s\n", vector_file);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: %s is not a regular file\n", vector_file);
+        close(fd);
+        return -1;
+    }
+
+    uint64_t len = st.st_size;
+    uint8_t* msg = NULL;
+    if (len > 0) {
+        msg = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (msg == MAP_FAILED) {
+            fprintf(stderr, "Error: failed to map %s\n", vector_file);
+            close(fd);
+            return -1;
+        }
+        madvise(msg, len, MADV_SEQUENTIAL);
+    }
+
+    if (mac_type == CMAC)
+        aes_cmac(msg, len, ekey, len_key, tag);
+    else
+        aes_pmac(msg, len, ekey, len_key, tag, num_threads);
+
+    if (msg)
+        munmap(msg, len);
+    close(fd);
+    return 0;
+}
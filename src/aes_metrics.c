@@ -0,0 +1,431 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_metrics.c
+ *
+ * Description:
+ *   Counters, latency histograms and exporters for runtime metrics.
+ *
+ * Details:
+ *   Every mode goes through aes_mode(), which is the single recording point:
+ *   when metrics are enabled it times the call and adds its bytes, blocks and
+ *   latency. The backend a call is counted under is a thread-local tag that
+ *   the file pipeline sets on its threads; everything else counts as memory.
+ *
+ *   Counters are shared relaxed atomics. Latency histograms are per thread:
+ *   each thread registers its own buckets on first use and is their only
+ *   writer, so recording is a plain load and store with no lock and no
+ *   contended cache line. Snapshots walk the registry under a mutex and
+ *   read the buckets atomically. When a thread exits, its buckets are
+ *   folded into a retired total so its samples are not lost.
+ *
+ *   The exporter thread wakes every interval to rewrite the Prometheus file
+ *   (written beside the target and renamed over it, so a scraper never sees
+ *   a partial file) and to redraw the progress line.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_metrics.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* MODE_NAMES[METRICS_NUM_MODES] = { "ECB", "CBC", "CFB", "OFB", "CTR", "CFB8", "CFB1" };
+static const char* BACKEND_NAMES[METRICS_NUM_BACKENDS] = { "memory", "uring", "threads", "afalg" };
+
+atomic_bool metrics_enabled = false;
+
+static _Atomic uint64_t bytes_total[METRICS_NUM_MODES][METRICS_NUM_BACKENDS];
+static _Atomic uint64_t blocks_total[METRICS_NUM_MODES][METRICS_NUM_BACKENDS];
+static _Atomic uint64_t key_expansions;
+static _Atomic uint64_t cache_hits;
+static _Atomic uint64_t cache_misses;
+static _Atomic uint64_t expected_bytes;
+static _Atomic uint64_t start_ns;
+
+static _Thread_local Metrics_backend thread_backend = METRICS_MEMORY;
+
+/* --------------------------------------------------------------------------
+ * Per-Thread Histograms
+ * -------------------------------------------------------------------------- */
+
+typedef struct metrics_hist {
+    _Atomic uint64_t buckets[METRICS_NUM_MODES][METRICS_HIST_BUCKETS];
+    _Atomic uint64_t sum_ns[METRICS_NUM_MODES];
+    _Atomic uint64_t count[METRICS_NUM_MODES];
+    struct metrics_hist* next;
+} Metrics_hist;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static Metrics_hist* registry;
+static Metrics_hist retired;
+static pthread_key_t hist_key;
+static pthread_once_t hist_once = PTHREAD_ONCE_INIT;
+static _Thread_local Metrics_hist* local_hist;
+
+/**
+ * @brief Add every bucket and total of src into dst.
+ */
+static void hist_merge(Metrics_hist* dst, Metrics_hist* src) {
+    for (int m = 0; m < METRICS_NUM_MODES; m++) {
+        for (int b = 0; b < METRICS_HIST_BUCKETS; b++)
+            atomic_fetch_add_explicit(&dst->buckets[m][b],
+                    atomic_load_explicit(&src->buckets[m][b], memory_order_relaxed),
+                    memory_order_relaxed);
+        atomic_fetch_add_explicit(&dst->sum_ns[m],
+                atomic_load_explicit(&src->sum_ns[m], memory_order_relaxed), memory_order_relaxed);
+        atomic_fetch_add_explicit(&dst->count[m],
+                atomic_load_explicit(&src->count[m], memory_order_relaxed), memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Thread-exit destructor: fold the thread's samples into the retired
+ *        total and drop its buckets from the registry.
+ */
+static void hist_retire(void* arg) {
+    Metrics_hist* h = arg;
+
+    pthread_mutex_lock(&registry_lock);
+    for (Metrics_hist** p = &registry; *p; p = &(*p)->next) {
+        if (*p == h) {
+            *p = h->next;
+            break;
+        }
+    }
+    hist_merge(&retired, h);
+    pthread_mutex_unlock(&registry_lock);
+    free(h);
+}
+
+static void hist_key_create() {
+    pthread_key_create(&hist_key, hist_retire);
+}
+
+/**
+ * @brief The calling thread's histogram, registered on first use.
+ */
+static Metrics_hist* thread_hist() {
+    if (local_hist)
+        return local_hist;
+
+    Metrics_hist* h = calloc(1, sizeof(Metrics_hist));
+    if (!h)
+        return NULL;
+    pthread_once(&hist_once, hist_key_create);
+    pthread_mutex_lock(&registry_lock);
+    h->next = registry;
+    registry = h;
+    pthread_mutex_unlock(&registry_lock);
+    pthread_setspecific(hist_key, h);
+    local_hist = h;
+    return h;
+}
+
+/**
+ * @brief Add to a counter that only the calling thread writes.
+ */
+static inline void owner_add(_Atomic uint64_t* counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+            memory_order_relaxed);
+}
+
+/* --------------------------------------------------------------------------
+ * Recording
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ */
+uint64_t metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Start recording. Elapsed time and rates are measured from the first call.
+ */
+void metrics_enable() {
+    uint64_t zero = 0;
+    atomic_compare_exchange_strong(&start_ns, &zero, metrics_now_ns());
+    atomic_store(&metrics_enabled, true);
+}
+
+/**
+ * @brief Set the backend that the calling thread's cipher work is counted under.
+ */
+void metrics_set_backend(Metrics_backend backend) {
+    thread_backend = backend;
+}
+
+Metrics_backend metrics_get_backend() {
+    return thread_backend;
+}
+
+/**
+ * @brief Record one call of op_mode over len bytes that started at start_ns.
+ */
+void metrics_record(Op_mode op_mode, uint64_t len, uint64_t start) {
+    if (!atomic_load_explicit(&metrics_enabled, memory_order_relaxed))
+        return;
+
+    uint64_t ns = metrics_now_ns() - start;
+    atomic_fetch_add_explicit(&bytes_total[op_mode][thread_backend], len, memory_order_relaxed);
+    atomic_fetch_add_explicit(&blocks_total[op_mode][thread_backend], (len + 15) / 16,
+            memory_order_relaxed);
+
+    Metrics_hist* h = thread_hist();
+    if (!h)
+        return;
+    // Prometheus bounds are inclusive: 2^b ns itself belongs in bucket b
+    int bucket = ns <= 1 ? 0 : 64 - __builtin_clzll(ns - 1);
+    if (bucket >= METRICS_HIST_BUCKETS)
+        bucket = METRICS_HIST_BUCKETS - 1;
+    owner_add(&h->buckets[op_mode][bucket], 1);
+    owner_add(&h->sum_ns[op_mode], ns);
+    owner_add(&h->count[op_mode], 1);
+}
+
+void metrics_count_key_expansion() {
+    if (atomic_load_explicit(&metrics_enabled, memory_order_relaxed))
+        atomic_fetch_add_explicit(&key_expansions, 1, memory_order_relaxed);
+}
+
+void metrics_count_cache(bool hit) {
+    if (atomic_load_explicit(&metrics_enabled, memory_order_relaxed))
+        atomic_fetch_add_explicit(hit ? &cache_hits : &cache_misses, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Announce len more bytes of work, for the progress percentage and ETA.
+ */
+void metrics_expect(uint64_t len) {
+    atomic_fetch_add_explicit(&expected_bytes, len, memory_order_relaxed);
+}
+
+/* --------------------------------------------------------------------------
+ * Snapshots
+ * -------------------------------------------------------------------------- */
+
+static void snapshot_add_hist(Metrics_snapshot* snap, Metrics_hist* h) {
+    for (int m = 0; m < METRICS_NUM_MODES; m++) {
+        for (int b = 0; b < METRICS_HIST_BUCKETS; b++)
+            snap->latency[m][b] += atomic_load_explicit(&h->buckets[m][b], memory_order_relaxed);
+        snap->latency_sum_ns[m] += atomic_load_explicit(&h->sum_ns[m], memory_order_relaxed);
+        snap->latency_count[m] += atomic_load_explicit(&h->count[m], memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Copy every counter and the merged histograms of all threads.
+ */
+void metrics_snapshot(Metrics_snapshot* snap) {
+    memset(snap, 0, sizeof(*snap));
+    for (int m = 0; m < METRICS_NUM_MODES; m++) {
+        for (int b = 0; b < METRICS_NUM_BACKENDS; b++) {
+            snap->bytes[m][b] = atomic_load_explicit(&bytes_total[m][b], memory_order_relaxed);
+            snap->blocks[m][b] = atomic_load_explicit(&blocks_total[m][b], memory_order_relaxed);
+        }
+    }
+    snap->key_expansions = atomic_load_explicit(&key_expansions, memory_order_relaxed);
+    snap->cache_hits = atomic_load_explicit(&cache_hits, memory_order_relaxed);
+    snap->cache_misses = atomic_load_explicit(&cache_misses, memory_order_relaxed);
+    snap->expected_bytes = atomic_load_explicit(&expected_bytes, memory_order_relaxed);
+
+    pthread_mutex_lock(&registry_lock);
+    snapshot_add_hist(snap, &retired);
+    for (Metrics_hist* h = registry; h; h = h->next)
+        snapshot_add_hist(snap, h);
+    pthread_mutex_unlock(&registry_lock);
+
+    uint64_t start = atomic_load(&start_ns);
+    snap->elapsed = start ? (metrics_now_ns() - start) / 1e9 : 0.0;
+}
+
+/* --------------------------------------------------------------------------
+ * Exporters
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Write a snapshot in Prometheus text exposition format, replacing
+ *        path atomically. Returns 0 on success, -1 on error.
+ */
+int metrics_write_prometheus(const char* path) {
+    Metrics_snapshot snap;
+    metrics_snapshot(&snap);
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: failed to open %s\n", tmp_path);
+        return -1;
+    }
+
+    fprintf(f, "# HELP aes_bytes_total Bytes processed by the block cipher modes.\n");
+    fprintf(f, "# TYPE aes_bytes_total counter\n");
+    for (int m = 0; m < METRICS_NUM_MODES; m++)
+        for (int b = 0; b < METRICS_NUM_BACKENDS; b++)
+            fprintf(f, "aes_bytes_total{mode=\"%s\",backend=\"%s\"} %lu\n",
+                    MODE_NAMES[m], BACKEND_NAMES[b], snap.bytes[m][b]);
+
+    fprintf(f, "# HELP aes_blocks_total 16-byte blocks processed by the block cipher modes.\n");
+    fprintf(f, "# TYPE aes_blocks_total counter\n");
+    for (int m = 0; m < METRICS_NUM_MODES; m++)
+        for (int b = 0; b < METRICS_NUM_BACKENDS; b++)
+            fprintf(f, "aes_blocks_total{mode=\"%s\",backend=\"%s\"} %lu\n",
+                    MODE_NAMES[m], BACKEND_NAMES[b], snap.blocks[m][b]);
+
+    fprintf(f, "# HELP aes_key_expansions_total Key schedules expanded.\n");
+    fprintf(f, "# TYPE aes_key_expansions_total counter\n");
+    fprintf(f, "aes_key_expansions_total %lu\n", snap.key_expansions);
+    fprintf(f, "# HELP aes_key_cache_lookups_total Key cache lookups by result.\n");
+    fprintf(f, "# TYPE aes_key_cache_lookups_total counter\n");
+    fprintf(f, "aes_key_cache_lookups_total{result=\"hit\"} %lu\n", snap.cache_hits);
+    fprintf(f, "aes_key_cache_lookups_total{result=\"miss\"} %lu\n", snap.cache_misses);
+
+    fprintf(f, "# HELP aes_request_duration_seconds Duration of each call into a mode.\n");
+    fprintf(f, "# TYPE aes_request_duration_seconds histogram\n");
+    for (int m = 0; m < METRICS_NUM_MODES; m++) {
+        if (snap.latency_count[m] == 0)
+            continue;
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRICS_HIST_BUCKETS - 1; b++) {
+            cumulative += snap.latency[m][b];
+            fprintf(f, "aes_request_duration_seconds_bucket{mode=\"%s\",le=\"%.9g\"} %lu\n",
+                    MODE_NAMES[m], (double)((uint64_t)1 << b) / 1e9, cumulative);
+        }
+        fprintf(f, "aes_request_duration_seconds_bucket{mode=\"%s\",le=\"+Inf\"} %lu\n",
+                MODE_NAMES[m], snap.latency_count[m]);
+        fprintf(f, "aes_request_duration_seconds_sum{mode=\"%s\"} %.9f\n",
+                MODE_NAMES[m], snap.latency_sum_ns[m] / 1e9);
+        fprintf(f, "aes_request_duration_seconds_count{mode=\"%s\"} %lu\n",
+                MODE_NAMES[m], snap.latency_count[m]);
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Error: failed to write %s\n", path);
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void format_size(double bytes, char* out, size_t size) {
+    static const char* UNITS[5] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    int u = 0;
+    for (; bytes >= 1024 && u < 4; u++)
+        bytes /= 1024;
+    snprintf(out, size, "%.1f %s", bytes, UNITS[u]);
+}
+
+/**
+ * @brief Format a one-line summary of a snapshot: bytes done, percentage of
+ *        the expected total, average rate and estimated time remaining.
+ */
+void metrics_format_progress(Metrics_snapshot* snap, char* line, size_t size) {
+    uint64_t done = 0;
+    for (int m = 0; m < METRICS_NUM_MODES; m++)
+        for (int b = 0; b < METRICS_NUM_BACKENDS; b++)
+            done += snap->bytes[m][b];
+
+    double rate = snap->elapsed > 0 ? done / snap->elapsed : 0.0;
+    char done_str[32], total_str[32], rate_str[32];
+    format_size(done, done_str, sizeof(done_str));
+    format_size(snap->expected_bytes, total_str, sizeof(total_str));
+    format_size(rate, rate_str, sizeof(rate_str));
+
+    if (snap->expected_bytes == 0) {
+        snprintf(line, size, "%s  %s/s", done_str, rate_str);
+        return;
+    }
+
+    uint64_t remaining = done < snap->expected_bytes ? snap->expected_bytes - done : 0;
+    uint64_t eta = rate > 0 ? (uint64_t)(remaining / rate) : 0;
+    snprintf(line, size, "%s / %s (%.1f%%)  %s/s  ETA %lu:%02lu:%02lu", done_str, total_str,
+            100.0 * done / snap->expected_bytes, rate_str, eta / 3600, eta / 60 % 60, eta % 60);
+}
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+    bool stop;
+    const char* path;
+    bool progress;
+    int interval_ms;
+} exporter = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+
+static void export_once(bool final) {
+    if (exporter.path)
+        metrics_write_prometheus(exporter.path);
+    if (exporter.progress) {
+        Metrics_snapshot snap;
+        char line[256];
+        metrics_snapshot(&snap);
+        metrics_format_progress(&snap, line, sizeof(line));
+        fprintf(stderr, "\r\033[K%s%s", line, final ? "\n" : "");
+    }
+}
+
+static void* exporter_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&exporter.lock);
+    while (!exporter.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += exporter.interval_ms / 1000;
+        deadline.tv_nsec += (long)(exporter.interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&exporter.wake, &exporter.lock, &deadline);
+        if (!exporter.stop)
+            export_once(false);
+    }
+    pthread_mutex_unlock(&exporter.lock);
+    return NULL;
+}
+
+/**
+ * @brief Enable metrics and start exporting every interval_ms (0 for the
+ *        default) to a Prometheus file, a stderr progress line, or both.
+ *        Returns 0 on success, -1 on error.
+ */
+int metrics_start_exporter(const char* path, bool progress, int interval_ms) {
+    if (exporter.running)
+        return -1;
+
+    metrics_enable();
+    exporter.path = path;
+    exporter.progress = progress;
+    exporter.interval_ms = interval_ms > 0 ? interval_ms : METRICS_DEFAULT_INTERVAL_MS;
+    exporter.stop = false;
+    if (pthread_create(&exporter.thread, NULL, exporter_main, NULL)) {
+        fprintf(stderr, "Error: failed to start metrics exporter\n");
+        return -1;
+    }
+    exporter.running = true;
+    return 0;
+}
+
+/**
+ * @brief Stop the exporter after one last export, so the file and the
+ *        progress line end on the final totals.
+ */
+void metrics_stop_exporter() {
+    if (!exporter.running)
+        return;
+
+    pthread_mutex_lock(&exporter.lock);
+    exporter.stop = true;
+    pthread_cond_signal(&exporter.wake);
+    pthread_mutex_unlock(&exporter.lock);
+    pthread_join(exporter.thread, NULL);
+    exporter.running = false;
+
+    export_once(true);
+}
@@ -0,0 +1,580 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_modes.c
+ *
+ * Description:
+ *   Interleaved multi-block cipher core and the block cipher modes of
+ *   operation built on top of it.
+ *
+ * Details:
+ *   aes() takes a single block through every round before the next block can
+ *   start, so each table lookup waits on the one before it. aes_x4() and
+ *   aes_x8() instead run each round step over 4 or 8 independent states
+ *   before moving on, giving the CPU several independent dependency chains to
+ *   overlap. The lanes need not share a key: the *_keys variants take one
+ *   key schedule per lane, for callers that interleave independent messages.
+ *   Modes whose blocks are independent (ECB, CTR, CBC decryption and
+ *   CFB decryption) feed the interleaved core; CBC/CFB encryption and OFB are
+ *   inherently serial and use aes() directly. CFB-8 and CFB-1 take one
+ *   cipher call per segment rather than per block, and their shift register
+ *   is always the last 16 bytes (or 128 bits) of IV || ciphertext, so
+ *   decryption can build many registers at once straight from the input.
+ *
+ *   Buffers well beyond the last-level cache go through aes_bulk(), which
+ *   ciphers them a tile at a time in a staging buffer and writes the result
+ *   with non-temporal stores. The round keys and the tables aes() reads
+ *   then stay cached for the whole run.
+ *
+ *   aes_blocks(), aes_blocks_keys(), aes_ctr() and CBC decryption go
+ *   through the kernel table in aes_isa.h; the functions here named
+ *   *_table are its portable entries, and the AES-NI and VAES entries live
+ *   in aes_isa.c.
+ *
+ *   Chaining modes take the IV by pointer and leave the next chaining value
+ *   in it, so a long message can be processed in several calls. CFB, OFB and
+ *   CTR accept a trailing partial block, which is only valid on the final
+ *   call for a message.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_modes.h"
+#include "../include/aes_isa.h"
+#include "../include/aes_metrics.h"
+
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define AES_BULK_TILE 4096                          // Staging tile, kept in L1
+#define AES_BULK_PREFETCH (2*AES_BULK_TILE)         // Prefetch distance ahead of the tile
+#define AES_BULK_LLC_FACTOR 2
+#define AES_BULK_DEFAULT_THRESHOLD (64ull << 20)    // When the LLC size is unknown
+
+/* --------------------------------------------------------------------------
+ * Interleaved Cipher Core
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Run aes() over `lanes` consecutive 16-byte states, one round step at a
+ *        time across all of them, lane l under the key schedule ekeys[l].
+ *        Always inlined with a constant lane count so the inner loops are
+ *        fully unrolled.
+ */
+static inline __attribute__((always_inline))
+void aes_lanes(uint8_t* states, int lanes, uint8_t* const* ekeys, int len_key, bool is_encrypt) {
+    int round_num = 0;
+    int num_rounds = len_key/4 + 6;
+
+    if (is_encrypt) {
+        for (int l = 0; l < lanes; l++)
+            add_round_key(states + l*16, ekeys[l], round_num);
+        for (; round_num < num_rounds - 1; round_num++) {
+            for (int l = 0; l < lanes; l++)
+                byte_sub(states + l*16, is_encrypt);
+            for (int l = 0; l < lanes; l++)
+                shift_row(states + l*16, is_encrypt);
+            for (int l = 0; l < lanes; l++)
+                mix_column(states + l*16, is_encrypt);
+            for (int l = 0; l < lanes; l++)
+                add_round_key(states + l*16, ekeys[l], round_num + 1);
+        }
+        for (int l = 0; l < lanes; l++) {
+            byte_sub(states + l*16, is_encrypt);
+            shift_row(states + l*16, is_encrypt);
+            add_round_key(states + l*16, ekeys[l], round_num + 1);
+        }
+
+    } else {
+        round_num = num_rounds - 1;
+        for (int l = 0; l < lanes; l++)
+            add_round_key(states + l*16, ekeys[l], round_num + 1);
+        for (; round_num > 0; round_num--) {
+            for (int l = 0; l < lanes; l++)
+                shift_row(states + l*16, is_encrypt);
+            for (int l = 0; l < lanes; l++)
+                byte_sub(states + l*16, is_encrypt);
+            for (int l = 0; l < lanes; l++)
+                add_round_key(states + l*16, ekeys[l], round_num);
+            for (int l = 0; l < lanes; l++)
+                mix_column(states + l*16, is_encrypt);
+        }
+        for (int l = 0; l < lanes; l++) {
+            shift_row(states + l*16, is_encrypt);
+            byte_sub(states + l*16, is_encrypt);
+            add_round_key(states + l*16, ekeys[l], round_num);
+        }
+    }
+}
+
+/**
+ * @brief Encrypt or decrypt 4 consecutive blocks in place, interleaved.
+ */
+void aes_x4(uint8_t* states, uint8_t* ekey, int len_key, bool is_encrypt) {
+    uint8_t* const ekeys[4] = { ekey, ekey, ekey, ekey };
+    aes_lanes(states, 4, ekeys, len_key, is_encrypt);
+}
+
+/**
+ * @brief Encrypt or decrypt 8 consecutive blocks in place, interleaved.
+ */
+void aes_x8(uint8_t* states, uint8_t* ekey, int len_key, bool is_encrypt) {
+    uint8_t* const ekeys[8] = { ekey, ekey, ekey, ekey, ekey, ekey, ekey, ekey };
+    aes_lanes(states, 8, ekeys, len_key, is_encrypt);
+}
+
+/**
+ * @brief Encrypt or decrypt 4 consecutive blocks in place, interleaved, block l
+ *        under ekeys[l]. All keys must be len_key bytes long.
+ */
+void aes_x4_keys(uint8_t* states, uint8_t* const* ekeys, int len_key, bool is_encrypt) {
+    aes_lanes(states, 4, ekeys, len_key, is_encrypt);
+}
+
+/**
+ * @brief Encrypt or decrypt 8 consecutive blocks in place, interleaved, block l
+ *        under ekeys[l]. All keys must be len_key bytes long.
+ */
+void aes_x8_keys(uint8_t* states, uint8_t* const* ekeys, int len_key, bool is_encrypt) {
+    aes_lanes(states, 8, ekeys, len_key, is_encrypt);
+}
+
+static int interleave_width = AES_INTERLEAVE_MAX;
+
+/**
+ * @brief Set the widest interleaved variant aes_blocks() may use: 1, 4 or 8.
+ *        Some cores run out of registers or load ports before 8 lanes pay
+ *        off. Set it before starting any threads that cipher.
+ */
+void aes_set_interleave(int width) {
+    interleave_width = width >= 8 ? 8 : width >= 4 ? 4 : 1;
+}
+
+int aes_get_interleave() {
+    return interleave_width;
+}
+
+/**
+ * @brief Encrypt or decrypt any number of consecutive blocks in place, using the
+ *        widest interleaved variant allowed for each run.
+ */
+void aes_blocks(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key, bool is_encrypt) {
+    aes_kernels.blocks(states, num_blocks, ekey, len_key, is_encrypt);
+}
+
+void aes_blocks_table(uint8_t* states, uint64_t num_blocks, uint8_t* ekey, int len_key,
+        bool is_encrypt) {
+    if (interleave_width >= 8)
+        for (; num_blocks >= 8; num_blocks -= 8, states += 8*16)
+            aes_x8(states, ekey, len_key, is_encrypt);
+    if (interleave_width >= 4)
+        for (; num_blocks >= 4; num_blocks -= 4, states += 4*16)
+            aes_x4(states, ekey, len_key, is_encrypt);
+    for (; num_blocks > 0; num_blocks--, states += 16)
+        aes_table(states, ekey, len_key, is_encrypt);
+}
+
+/**
+ * @brief Encrypt or decrypt any number of consecutive blocks in place, block i
+ *        under ekeys[i]. All keys must be len_key bytes long.
+ */
+void aes_blocks_keys(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys, int len_key,
+        bool is_encrypt) {
+    aes_kernels.blocks_keys(states, num_blocks, ekeys, len_key, is_encrypt);
+}
+
+void aes_blocks_keys_table(uint8_t* states, uint64_t num_blocks, uint8_t* const* ekeys, int len_key,
+        bool is_encrypt) {
+    if (interleave_width >= 8)
+        for (; num_blocks >= 8; num_blocks -= 8, states += 8*16, ekeys += 8)
+            aes_x8_keys(states, ekeys, len_key, is_encrypt);
+    if (interleave_width >= 4)
+        for (; num_blocks >= 4; num_blocks -= 4, states += 4*16, ekeys += 4)
+            aes_x4_keys(states, ekeys, len_key, is_encrypt);
+    for (; num_blocks > 0; num_blocks--, states += 16, ekeys++)
+        aes_table(states, *ekeys, len_key, is_encrypt);
+}
+
+/* --------------------------------------------------------------------------
+ * Helpers
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Increment a 128-bit big-endian counter block by one.
+ */
+void ctr_increment(uint8_t* counter) {
+    for (int i = 15; i >= 0; i--)
+        if (++counter[i] != 0)
+            break;
+}
+
+/**
+ * @brief Add n to a 128-bit big-endian counter block.
+ */
+void ctr_add(uint8_t* counter, uint64_t n) {
+    for (int i = 15; i >= 0 && n; i--) {
+        uint64_t sum = counter[i] + (n & 0xFF);
+        counter[i] = (uint8_t)sum;
+        n = (n >> 8) + (sum >> 8);
+    }
+}
+
+AES_ISA_CLONES
+static void xor_bytes(uint8_t* dst, const uint8_t* src, uint64_t len) {
+    for (uint64_t i = 0; i < len; i++)
+        dst[i] ^= src[i];
+}
+
+/* --------------------------------------------------------------------------
+ * Modes of Operation
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Electronic codebook. len must be a multiple of 16.
+ */
+void aes_ecb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, bool is_encrypt) {
+    aes_blocks(data, len / 16, ekey, len_key, is_encrypt);
+}
+
+/**
+ * @brief Cipher block chaining. len must be a multiple of 16.
+ *
+ * Encryption is serial through aes(); decryption only depends on the
+ * ciphertext, so it runs through the interleaved core.
+ */
+void aes_cbc(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt) {
+    uint64_t num_blocks = len / 16;
+
+    if (is_encrypt) {
+        for (uint64_t i = 0; i < num_blocks; i++, data += 16) {
+            xor_bytes(data, iv, 16);
+            aes(data, ekey, len_key, true);
+            memcpy(iv, data, 16);
+        }
+        return;
+    }
+
+    aes_kernels.cbc_decrypt(data, len, ekey, len_key, iv);
+}
+
+void aes_cbc_decrypt_table(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    uint64_t num_blocks = len / 16;
+    uint8_t prev[AES_INTERLEAVE_MAX*16];
+    while (num_blocks > 0) {
+        int lanes = num_blocks >= AES_INTERLEAVE_MAX ? AES_INTERLEAVE_MAX : (int)num_blocks;
+
+        // Save the ciphertext before it is overwritten, it is the next block's chaining value
+        memcpy(prev, data, lanes*16);
+        aes_blocks(data, lanes, ekey, len_key, false);
+
+        xor_bytes(data, iv, 16);
+        xor_bytes(data + 16, prev, (lanes - 1)*16);
+        memcpy(iv, prev + (lanes - 1)*16, 16);
+
+        data += lanes*16;
+        num_blocks -= lanes;
+    }
+}
+
+/**
+ * @brief Cipher feedback with 128-bit segments.
+ *
+ * Decryption derives every keystream block from ciphertext that is already
+ * known, so it runs through the interleaved core.
+ */
+void aes_cfb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt) {
+    uint8_t ks[AES_INTERLEAVE_MAX*16];
+
+    if (is_encrypt) {
+        for (; len > 0; data += 16) {
+            uint64_t n = len < 16 ? len : 16;
+            memcpy(ks, iv, 16);
+            aes(ks, ekey, len_key, true);
+            xor_bytes(data, ks, n);
+            memcpy(iv, data, n);
+            len -= n;
+        }
+        return;
+    }
+
+    while (len > 0) {
+        uint64_t num_blocks = (len + 15) / 16;
+        int lanes = num_blocks >= AES_INTERLEAVE_MAX ? AES_INTERLEAVE_MAX : (int)num_blocks;
+        uint64_t n = len < (uint64_t)lanes*16 ? len : (uint64_t)lanes*16;
+
+        // Keystream inputs are the IV followed by the preceding ciphertext blocks
+        memcpy(ks, iv, 16);
+        memcpy(ks + 16, data, (lanes - 1)*16);
+        if (n >= (uint64_t)lanes*16)
+            memcpy(iv, data + (lanes - 1)*16, 16);
+
+        aes_blocks(ks, lanes, ekey, len_key, true);
+        xor_bytes(data, ks, n);
+
+        data += n;
+        len -= n;
+    }
+}
+
+/* Bytes of CFB-8 decryption, or bits of CFB-1, per pass through the core */
+#define CFB_SEGMENT_BATCH (8*AES_INTERLEAVE_MAX)
+
+/**
+ * @brief Cipher feedback with 8-bit segments. The IV holds the shift register,
+ *        the last 16 bytes of IV || ciphertext.
+ *
+ * Encryption reads each register straight from the ciphertext already
+ * written, so nothing is shifted per byte. Decryption knows every register
+ * up front and enciphers CFB_SEGMENT_BATCH of them together.
+ */
+void aes_cfb8(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt) {
+    uint8_t reg[16 + CFB_SEGMENT_BATCH];
+    uint8_t ks[CFB_SEGMENT_BATCH*16];
+    memcpy(reg, iv, 16);
+
+    if (is_encrypt) {
+        // The first 16 registers straddle the IV and the new ciphertext
+        uint64_t head = len < 16 ? len : 16;
+        for (uint64_t i = 0; i < head; i++) {
+            memcpy(ks, reg + i, 16);
+            aes(ks, ekey, len_key, true);
+            data[i] ^= ks[0];
+            reg[16 + i] = data[i];
+        }
+        for (uint64_t i = 16; i < len; i++) {
+            memcpy(ks, data + i - 16, 16);
+            aes(ks, ekey, len_key, true);
+            data[i] ^= ks[0];
+        }
+        memcpy(iv, len >= 16 ? data + len - 16 : reg + len, 16);
+        return;
+    }
+
+    while (len > 0) {
+        int n = len < CFB_SEGMENT_BATCH ? (int)len : CFB_SEGMENT_BATCH;
+
+        // Copy the ciphertext out first, decryption overwrites it in place
+        memcpy(reg + 16, data, n);
+        for (int i = 0; i < n; i++)
+            memcpy(ks + i*16, reg + i, 16);
+        aes_blocks(ks, n, ekey, len_key, true);
+        for (int i = 0; i < n; i++)
+            data[i] ^= ks[i*16];
+
+        memmove(reg, reg + n, 16);
+        data += n;
+        len -= n;
+    }
+    memcpy(iv, reg, 16);
+}
+
+/**
+ * @brief Copy the 128 bits starting `bit` bits into src, which must have a
+ *        17th byte readable when bit is not a multiple of 8.
+ */
+static inline void load_bits(uint8_t* dst, const uint8_t* src, int bit) {
+    int shift = bit % 8;
+    src += bit / 8;
+    if (shift == 0) {
+        memcpy(dst, src, 16);
+        return;
+    }
+    for (int k = 0; k < 16; k++)
+        dst[k] = (uint8_t)((src[k] << shift) | (src[k + 1] >> (8 - shift)));
+}
+
+/**
+ * @brief Cipher feedback with 1-bit segments, most significant bit of each
+ *        byte first. The IV holds the last 128 bits of IV || ciphertext.
+ *
+ * Encryption produces each ciphertext byte a bit at a time in the 17th byte
+ * of a window over the register. Decryption builds the registers for
+ * CFB_SEGMENT_BATCH bits at once and enciphers them together.
+ */
+void aes_cfb1(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv, bool is_encrypt) {
+    uint8_t reg[16 + CFB_SEGMENT_BATCH/8 + 1];
+    uint8_t ks[CFB_SEGMENT_BATCH*16];
+    memcpy(reg, iv, 16);
+
+    if (is_encrypt) {
+        for (uint64_t i = 0; i < len; i++) {
+            reg[16] = 0;
+            for (int b = 0; b < 8; b++) {
+                load_bits(ks, reg, b);
+                aes(ks, ekey, len_key, true);
+                reg[16] |= (uint8_t)(((data[i] << b) ^ ks[0]) & 0x80) >> b;
+            }
+            data[i] = reg[16];
+            memmove(reg, reg + 1, 16);
+        }
+        memcpy(iv, reg, 16);
+        return;
+    }
+
+    while (len > 0) {
+        int n = len < CFB_SEGMENT_BATCH/8 ? (int)len : CFB_SEGMENT_BATCH/8;
+
+        memcpy(reg + 16, data, n);
+        for (int i = 0; i < n; i++)
+            for (int b = 0; b < 8; b++)
+                load_bits(ks + (i*8 + b)*16, reg + i, b);
+        aes_blocks(ks, n*8, ekey, len_key, true);
+        for (int i = 0; i < n; i++) {
+            uint8_t mask = 0;
+            for (int b = 0; b < 8; b++)
+                mask |= (ks[(i*8 + b)*16] & 0x80) >> b;
+            data[i] ^= mask;
+        }
+
+        memmove(reg, reg + n, 16);
+        data += n;
+        len -= n;
+    }
+    memcpy(iv, reg, 16);
+}
+
+/**
+ * @brief Output feedback. The keystream is a serial chain through aes().
+ *        Encryption and decryption are the same operation.
+ */
+void aes_ofb(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    for (; len > 0; data += 16) {
+        uint64_t n = len < 16 ? len : 16;
+        aes(iv, ekey, len_key, true);
+        xor_bytes(data, iv, n);
+        len -= n;
+    }
+}
+
+/**
+ * @brief Counter mode with a 128-bit big-endian counter starting at iv.
+ *        Encryption and decryption are the same operation.
+ */
+void aes_ctr(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    aes_kernels.ctr(data, len, ekey, len_key, iv);
+}
+
+void aes_ctr_table(uint8_t* data, uint64_t len, uint8_t* ekey, int len_key, uint8_t* iv) {
+    uint8_t ks[AES_INTERLEAVE_MAX*16];
+
+    while (len > 0) {
+        uint64_t num_blocks = (len + 15) / 16;
+        int lanes = num_blocks >= AES_INTERLEAVE_MAX ? AES_INTERLEAVE_MAX : (int)num_blocks;
+        uint64_t n = len < (uint64_t)lanes*16 ? len : (uint64_t)lanes*16;
+
+        for (int l = 0; l < lanes; l++) {
+            memcpy(ks + l*16, iv, 16);
+            ctr_increment(iv);
+        }
+        aes_blocks(ks, lanes, ekey, len_key, true);
+        xor_bytes(data, ks, n);
+
+        data += n;
+        len -= n;
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Large Buffers
+ * -------------------------------------------------------------------------- */
+
+static void mode_dispatch(Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt) {
+    switch (op_mode) {
+        case ECB: aes_ecb(data, len, ekey, len_key, is_encrypt); break;
+        case CBC: aes_cbc(data, len, ekey, len_key, iv, is_encrypt); break;
+        case CFB: aes_cfb(data, len, ekey, len_key, iv, is_encrypt); break;
+        case CFB8: aes_cfb8(data, len, ekey, len_key, iv, is_encrypt); break;
+        case CFB1: aes_cfb1(data, len, ekey, len_key, iv, is_encrypt); break;
+        case OFB: aes_ofb(data, len, ekey, len_key, iv); break;
+        case CTR: aes_ctr(data, len, ekey, len_key, iv); break;
+    }
+}
+
+static _Atomic uint64_t bulk_threshold;     // 0 until first use: derived from the LLC size
+
+/**
+ * @brief Buffer size from which aes_mode() switches to the cache-bypassing
+ *        path: AES_BULK_LLC_FACTOR times the last-level cache, unless set
+ *        with aes_bulk_set_threshold().
+ */
+uint64_t aes_bulk_threshold() {
+    uint64_t threshold = atomic_load_explicit(&bulk_threshold, memory_order_relaxed);
+    if (threshold == 0) {
+        long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc <= 0)
+            llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        threshold = llc > 0 ? AES_BULK_LLC_FACTOR * (uint64_t)llc : AES_BULK_DEFAULT_THRESHOLD;
+        atomic_store_explicit(&bulk_threshold, threshold, memory_order_relaxed);
+    }
+    return threshold;
+}
+
+/**
+ * @brief Override the bulk threshold. 0 goes back to deriving it from the
+ *        LLC size, UINT64_MAX disables the bulk path.
+ */
+void aes_bulk_set_threshold(uint64_t threshold) {
+    atomic_store_explicit(&bulk_threshold, threshold, memory_order_relaxed);
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Run a mode over a buffer much larger than the LLC without letting the
+ *        data push the round keys and tables out of the cache.
+ *
+ * Each AES_BULK_TILE of input is copied into an L1-resident staging tile
+ * and ciphered there. The result is written back with non-temporal stores,
+ * which go to memory without allocating cache lines. Input is prefetched
+ * AES_BULK_PREFETCH bytes ahead with the NTA hint, so it arrives before the
+ * cipher needs it and is not kept in the outer cache levels afterwards.
+ * Tiles are whole blocks, so the chaining modes carry their IV across tiles
+ * exactly as across separate calls. data must be 16-byte aligned.
+ */
+static void aes_bulk(Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt) {
+    uint8_t stage[AES_BULK_TILE] __attribute__((aligned(64)));
+
+    while (len > 0) {
+        uint64_t n = len < AES_BULK_TILE ? len : AES_BULK_TILE;
+        for (uint64_t off = AES_BULK_PREFETCH; off < AES_BULK_PREFETCH + n && off < len; off += 64)
+            _mm_prefetch((const char*)data + off, _MM_HINT_NTA);
+
+        memcpy(stage, data, n);
+        mode_dispatch(op_mode, stage, n, ekey, len_key, iv, is_encrypt);
+
+        uint64_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm_stream_si128((__m128i*)(data + i), _mm_load_si128((const __m128i*)(stage + i)));
+        memcpy(data + i, stage + i, n - i);
+
+        data += n;
+        len -= n;
+    }
+
+    // Order the streaming stores before anything that reads the output
+    _mm_sfence();
+}
+#endif
+
+/**
+ * @brief Dispatch to the mode selected on the command line. Buffers from
+ *        aes_bulk_threshold() up take the cache-bypassing path. This is where
+ *        calls are counted and timed when metrics are enabled.
+ */
+void aes_mode(Op_mode op_mode, uint8_t* data, uint64_t len, uint8_t* ekey, int len_key,
+        uint8_t* iv, bool is_encrypt) {
+    bool timed = atomic_load_explicit(&metrics_enabled, memory_order_relaxed);
+    uint64_t start = timed ? metrics_now_ns() : 0;
+
+#ifdef __SSE2__
+    if (len >= aes_bulk_threshold() && (uintptr_t)data % 16 == 0)
+        aes_bulk(op_mode, data, len, ekey, len_key, iv, is_encrypt);
+    else
+#endif
+        mode_dispatch(op_mode, data, len, ekey, len_key, iv, is_encrypt);
+
+    if (timed)
+        metrics_record(op_mode, len, start);
+}
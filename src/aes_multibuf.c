@@ -0,0 +1,102 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_multibuf.c
+ *
+ * Description:
+ *   Multi-buffer scheduler for CBC encryption of many independent messages.
+ *
+ * Details:
+ *   Up to AES_INTERLEAVE_MAX messages are held in lanes. Every pass XORs the
+ *   next plaintext block of each lane with that lane's chaining value, runs
+ *   all of them through aes_blocks_keys() together, and stores the results
+ *   back as ciphertext, which is also the next chaining value. A lane whose
+ *   message is finished is refilled with the next message straight away, so
+ *   short and long messages mix and the core stays full until the batch
+ *   runs dry.
+ *
+ *   Each lane carries its own key schedule, but the rounds are shared, so a
+ *   pass only mixes messages with the same key length. The batch is run
+ *   once per key length, each run picking out the messages that match.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_multibuf.h"
+
+typedef struct cbc_lane {
+    Cbc_msg* msg;
+    uint64_t offset;        // Next block to encrypt
+} Cbc_lane;
+
+static void xor_block(uint8_t* dst, const uint8_t* src) {
+    for (int i = 0; i < 16; i++)
+        dst[i] ^= src[i];
+}
+
+/**
+ * @brief Encrypt every message in the batch whose key is len_key bytes long.
+ */
+static void cbc_run(Cbc_msg* msgs, int num_msgs, int len_key) {
+    Cbc_lane lanes[AES_INTERLEAVE_MAX];
+    uint8_t* ekeys[AES_INTERLEAVE_MAX];
+    uint8_t buf[AES_INTERLEAVE_MAX*16];
+    int active = 0;
+    int next = 0;
+
+    for (;;) {
+        // Refill empty lanes, keeping the active ones packed at the front
+        while (active < AES_INTERLEAVE_MAX && next < num_msgs) {
+            Cbc_msg* msg = &msgs[next++];
+            if (msg->len_key != len_key || msg->len < 16)
+                continue;
+            lanes[active].msg = msg;
+            lanes[active].offset = 0;
+            ekeys[active] = msg->ekey;
+            active++;
+        }
+        if (active == 0)
+            break;
+
+        for (int l = 0; l < active; l++) {
+            Cbc_lane* lane = &lanes[l];
+            uint8_t* chain = lane->offset ? lane->msg->data + lane->offset - 16 : lane->msg->iv;
+            memcpy(buf + l*16, lane->msg->data + lane->offset, 16);
+            xor_block(buf + l*16, chain);
+        }
+
+        aes_blocks_keys(buf, active, ekeys, len_key, true);
+
+        for (int l = 0; l < active; ) {
+            Cbc_lane* lane = &lanes[l];
+            memcpy(lane->msg->data + lane->offset, buf + l*16, 16);
+            lane->offset += 16;
+
+            if (lane->offset + 16 <= lane->msg->len) {
+                l++;
+                continue;
+            }
+            memcpy(lane->msg->iv, buf + l*16, 16);
+
+            // Move the last active lane into this slot
+            active--;
+            if (l != active) {
+                lanes[l] = lanes[active];
+                ekeys[l] = ekeys[active];
+                memcpy(buf + l*16, buf + active*16, 16);
+            }
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Public Interface
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief CBC-encrypt a batch of independent messages in place. Each result is
+ *        the same as aes_cbc() on that message alone.
+ */
+void aes_cbc_encrypt_multi(Cbc_msg* msgs, int num_msgs) {
+    static const int key_lengths[3] = { 16, 24, 32 };
+    for (int k = 0; k < 3; k++)
+        cbc_run(msgs, num_msgs, key_lengths[k]);
+}
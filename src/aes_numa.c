@@ -0,0 +1,143 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_numa.c
+ *
+ * Description:
+ *   NUMA topology discovery and placement helpers.
+ *
+ * Details:
+ *   Linux places an anonymous page on the node of the CPU that first writes
+ *   it. Buffers are therefore mapped with numa_alloc_untouched(), which does
+ *   not write to them, and first touched by a thread already pinned to the
+ *   node that will work on them. Every later read, cipher pass and write of
+ *   that buffer then stays on the local memory controller.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_numa.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11" into a CPU set.
+ *        Returns the number of CPUs, or -1 if the list is malformed.
+ */
+int numa_parse_cpulist(const char* cpulist, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    const char* p = cpulist;
+
+    while (*p && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return -1;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first)
+                return -1;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, cpus);
+        if (*p == ',')
+            p++;
+        else if (*p && *p != '\n')
+            return -1;
+    }
+    return CPU_COUNT(cpus);
+}
+
+/**
+ * @brief Find the NUMA nodes and the CPUs of each that this process may use.
+ */
+void numa_discover(Numa_topology* topo) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        CPU_ZERO(&allowed);
+        for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &allowed);
+    }
+
+    topo->num_nodes = 0;
+    DIR* dir = opendir(NUMA_SYSFS);
+    struct dirent* entry;
+    while (dir && (entry = readdir(dir)) && topo->num_nodes < AES_NUMA_MAX_NODES) {
+        int node;
+        char trailing;
+        if (sscanf(entry->d_name, "node%d%c", &node, &trailing) != 1)
+            continue;
+
+        char path[512];
+        char cpulist[4096];
+        snprintf(path, sizeof(path), NUMA_SYSFS "/%s/cpulist", entry->d_name);
+        FILE* f = fopen(path, "r");
+        if (!f)
+            continue;
+        bool ok = fgets(cpulist, sizeof(cpulist), f) != NULL;
+        fclose(f);
+
+        cpu_set_t* cpus = &topo->cpus[topo->num_nodes];
+        if (!ok || numa_parse_cpulist(cpulist, cpus) <= 0)
+            continue;
+
+        // Memory-only nodes and nodes outside our affinity mask have nothing to run on
+        CPU_AND(cpus, cpus, &allowed);
+        if (CPU_COUNT(cpus) == 0)
+            continue;
+        topo->node_ids[topo->num_nodes++] = node;
+    }
+    if (dir)
+        closedir(dir);
+
+    if (topo->num_nodes == 0) {
+        topo->num_nodes = 1;
+        topo->node_ids[0] = 0;
+        topo->cpus[0] = allowed;
+    }
+}
+
+/**
+ * @brief Restrict the calling thread to the CPUs of one node.
+ *        Returns 0 on success, -1 on error.
+ */
+int numa_pin_to_node(Numa_topology* topo, int node) {
+    if (node < 0 || node >= topo->num_nodes)
+        return -1;
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &topo->cpus[node]) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Map page-aligned memory without touching it, so its pages land on
+ *        the node of whichever thread writes them first. Returns NULL on error.
+ */
+void* numa_alloc_untouched(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+/**
+ * @brief Release memory from numa_alloc_untouched().
+ */
+void numa_free(void* ptr, size_t size) {
+    if (ptr)
+        munmap(ptr, size);
+}
+
+/**
+ * @brief Fault in every page of a buffer from the calling thread.
+ */
+void numa_first_touch(void* ptr, size_t size) {
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < size; i += page)
+        ((volatile uint8_t*)ptr)[i] = 0;
+}
@@ -0,0 +1,505 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_shm.c
+ *
+ * Description:
+ *   Shared-memory request rings, the worker pool that serves them, and the
+ *   client side of the local encryption service.
+ *
+ * Details:
+ *   Each ring is a bounded array of cells with a sequence number per cell.
+ *   A cell at index pos % size is free for position pos when its sequence
+ *   equals pos, and holds the request for position pos when it equals
+ *   pos + 1. Producers claim a position by advancing tail with a
+ *   compare-and-swap, fill the cell and publish it by storing pos + 1; the
+ *   single consumer takes the cell at head once its sequence reads
+ *   head + 1 and hands it back for the next lap by storing head + size.
+ *   Producers therefore never wait on each other beyond a failed CAS, and
+ *   a slow producer holds up only its own cell.
+ *
+ *   Every push bumps the ring's doorbell. A consumer that runs out of polls
+ *   and yields registers as a sleeper, reads the doorbell, checks the ring
+ *   once more and sleeps on the doorbell with FUTEX_WAIT (not the private
+ *   variant, as the waker may be another process). A producer only makes
+ *   the wake syscall when it sees a sleeper. Sleeps are bounded so that a
+ *   service that goes away is noticed.
+ *
+ *   Requests are copied out of the ring before they are checked, so a
+ *   client cannot change them after validation, and the checks keep every
+ *   range inside the region. They do not keep a client to its own area:
+ *   every client maps the whole region read-write and could forge the
+ *   client field of a ring cell, or touch another area directly, so the
+ *   clients of one service have to trust each other.
+ *
+ *   Each slot records the pid of the process holding it, and attach
+ *   reclaims the slots of processes that have exited, so clients that crash
+ *   do not use up the service. A reclaimed slot can still have the dead
+ *   holder's requests in flight. Each attach therefore takes a new
+ *   generation number for the slot, and requests carry it. Workers drop
+ *   completions of an older generation instead of posting them, and the
+ *   client drops any that were posted before it attached. A worker that
+ *   checked the generation just before it changed can still post one
+ *   stale completion, so a client keeps AES_SHM_MAX_WORKERS cells of its
+ *   completion ring spare for them.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* --------------------------------------------------------------------------
+ * Rings
+ * -------------------------------------------------------------------------- */
+
+static void futex_wait(_Atomic uint32_t* word, uint32_t expected) {
+    struct timespec timeout = { 0, AES_SHM_SLEEP_MS * 1000000L };
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void ring_init(Shm_ring* r) {
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->doorbell, 0);
+    atomic_init(&r->sleepers, 0);
+    for (uint64_t i = 0; i < AES_SHM_RING_SIZE; i++)
+        atomic_init(&r->cells[i].seq, i);
+}
+
+static void ring_notify(Shm_ring* r) {
+    atomic_fetch_add(&r->doorbell, 1);
+    if (atomic_load(&r->sleepers))
+        futex_wake(&r->doorbell);
+}
+
+/**
+ * @brief Append a request from any number of producers. Returns false if the
+ *        ring is full.
+ */
+static bool ring_push(Shm_ring* r, const Aes_shm_request* req) {
+    uint64_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (;;) {
+        Shm_cell* cell = &r->cells[pos % AES_SHM_RING_SIZE];
+        int64_t diff = (int64_t)(atomic_load_explicit(&cell->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                cell->req = *req;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                ring_notify(r);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Take the oldest request; only the ring's one consumer may call this.
+ *        Returns false if the ring is empty.
+ */
+static bool ring_pop(Shm_ring* r, Aes_shm_request* out) {
+    uint64_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    Shm_cell* cell = &r->cells[pos % AES_SHM_RING_SIZE];
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1)
+        return false;
+    *out = cell->req;
+    atomic_store_explicit(&cell->seq, pos + AES_SHM_RING_SIZE, memory_order_release);
+    atomic_store_explicit(&r->head, pos + 1, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Take the next request, polling, then yielding, then sleeping until
+ *        one arrives. Returns false once running drops with the ring empty.
+ */
+static bool ring_wait(Shm_ring* r, Aes_shm_request* out, _Atomic uint32_t* running) {
+    for (int polls = 0; ; polls++) {
+        if (ring_pop(r, out))
+            return true;
+        if (!atomic_load(running))
+            return false;
+
+        if (polls < AES_SHM_SPIN) {
+#ifdef __SSE2__
+            _mm_pause();
+#endif
+        } else if (polls < AES_SHM_SPIN + AES_SHM_YIELD) {
+            sched_yield();
+        } else {
+            atomic_fetch_add(&r->sleepers, 1);
+            uint32_t bell = atomic_load(&r->doorbell);
+            bool ready = ring_pop(r, out);
+            if (!ready && atomic_load(running))
+                futex_wait(&r->doorbell, bell);
+            atomic_fetch_sub(&r->sleepers, 1);
+            if (ready)
+                return true;
+            polls = 0;      // Work tends to arrive in bursts: poll again first
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Region Layout
+ * -------------------------------------------------------------------------- */
+
+static uint64_t header_size() {
+    return (sizeof(Aes_shm_region) + 4095) & ~(uint64_t)4095;
+}
+
+static uint8_t* client_area(Aes_shm_region* region, uint16_t client) {
+    return (uint8_t*)region + header_size() + (uint64_t)client * region->area_size;
+}
+
+/* --------------------------------------------------------------------------
+ * Service
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Returns 0 if a request names a loaded key, a mode, and a range of
+ *        its client's area that the mode can process, otherwise -1.
+ */
+static int check_request(Aes_shm_service* svc, const Aes_shm_request* req) {
+    uint64_t area = svc->region->area_size;
+    if (req->client >= AES_SHM_MAX_CLIENTS || req->key_id >= svc->num_keys || req->op_mode > CFB1)
+        return -1;
+    if (req->offset > area || req->len > area - req->offset)
+        return -1;
+    if ((req->op_mode == ECB || req->op_mode == CBC) && req->len % 16)
+        return -1;
+    return 0;
+}
+
+static void* worker_main(void* arg) {
+    Shm_worker* w = arg;
+    Aes_shm_service* svc = w->svc;
+    Aes_shm_region* region = svc->region;
+    Aes_shm_request req;
+
+    while (ring_wait(&region->submit[w->index], &req, &region->running)) {
+        req.status = check_request(svc, &req);
+        if (req.status == 0) {
+            Shm_key* key = &svc->keys[req.key_id];
+            aes_mode((Op_mode)req.op_mode, client_area(region, req.client) + req.offset, req.len,
+                    key->ekey, key->len_key, req.iv, req.is_encrypt);
+        }
+        // Completions for a slot's earlier holder are dropped. A live client
+        // leaves room in its completion ring for the few stale ones posted
+        // around a reclaim, so the push only fails for a client that
+        // bypassed aes_shm_submit(), and then only its own completion is lost
+        if (req.client < AES_SHM_MAX_CLIENTS &&
+                req.generation == (uint16_t)atomic_load(&region->generations[req.client]))
+            ring_push(&region->complete[req.client], &req);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Create the shared region under name ("/something"), with
+ *        num_workers submission rings (0 for one per online CPU) and
+ *        area_size payload bytes per client (0 for AES_SHM_DEFAULT_AREA).
+ *        Returns 0 on success, -1 on error.
+ */
+int aes_shm_service_init(Aes_shm_service* svc, const char* name, int num_workers,
+        uint64_t area_size) {
+    memset(svc, 0, sizeof(*svc));
+    if (name[0] != '/' || strlen(name) >= sizeof(svc->name)) {
+        fprintf(stderr, "Error: shared memory name must start with / and be under %zu bytes\n",
+                sizeof(svc->name));
+        return -1;
+    }
+    strcpy(svc->name, name);
+
+    if (num_workers <= 0)
+        num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers < 1)
+        num_workers = 1;
+    if (num_workers > AES_SHM_MAX_WORKERS)
+        num_workers = AES_SHM_MAX_WORKERS;
+    svc->num_workers = num_workers;
+
+    if (area_size == 0)
+        area_size = AES_SHM_DEFAULT_AREA;
+    area_size = (area_size + 63) & ~(uint64_t)63;
+    if (area_size > (UINT64_MAX / 2 - header_size()) / AES_SHM_MAX_CLIENTS) {
+        fprintf(stderr, "Error: client area of %lu bytes is too large\n", area_size);
+        return -1;
+    }
+    uint64_t size = header_size() + AES_SHM_MAX_CLIENTS * area_size;
+
+    svc->keys = calloc(AES_SHM_MAX_KEYS, sizeof(Shm_key));
+    if (!svc->keys) {
+        fprintf(stderr, "Error: failed to allocate service keys\n");
+        return -1;
+    }
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Error: %s: %s\n", name, strerror(errno));
+        free(svc->keys);
+        return -1;
+    }
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: failed to map %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        free(svc->keys);
+        return -1;
+    }
+
+    Aes_shm_region* region = svc->region = map;
+    region->version = AES_SHM_VERSION;
+    region->num_workers = (uint32_t)num_workers;
+    region->area_size = area_size;
+    region->size = size;
+    atomic_init(&region->clients, 0);
+    atomic_init(&region->running, 0);
+    for (int i = 0; i < AES_SHM_MAX_WORKERS; i++)
+        ring_init(&region->submit[i]);
+    for (int i = 0; i < AES_SHM_MAX_CLIENTS; i++) {
+        ring_init(&region->complete[i]);
+        atomic_init(&region->generations[i], 0);
+        atomic_init(&region->owners[i], 0);
+    }
+
+    // Clients check the magic first, so it goes in last
+    atomic_thread_fence(memory_order_release);
+    region->magic = AES_SHM_MAGIC;
+    return 0;
+}
+
+/**
+ * @brief Expand a key into the service. Returns its id for requests, or -1.
+ */
+int64_t aes_shm_service_add_key(Aes_shm_service* svc, const uint8_t* key, int len_key) {
+    if (len_key != 16 && len_key != 24 && len_key != 32) {
+        fprintf(stderr, "Error: Invalid key length of %d\n", len_key);
+        return -1;
+    }
+    if (svc->num_keys == AES_SHM_MAX_KEYS) {
+        fprintf(stderr, "Error: the service holds at most %d keys\n", AES_SHM_MAX_KEYS);
+        return -1;
+    }
+    Shm_key* entry = &svc->keys[svc->num_keys];
+    expand_key((uint8_t*)key, len_key, entry->ekey);
+    entry->len_key = len_key;
+    return svc->num_keys++;
+}
+
+/**
+ * @brief Start serving requests. Keys must all be added first.
+ *        Returns 0 on success, -1 on error.
+ */
+int aes_shm_service_start(Aes_shm_service* svc) {
+    atomic_store(&svc->region->running, 1);
+    for (int i = 0; i < svc->num_workers; i++) {
+        svc->workers[i].svc = svc;
+        svc->workers[i].index = i;
+        if (pthread_create(&svc->workers[i].thread, NULL, worker_main, &svc->workers[i])) {
+            fprintf(stderr, "Error: failed to start service worker\n");
+            svc->num_workers = i;
+            svc->started = true;
+            aes_shm_service_stop(svc);
+            return -1;
+        }
+    }
+    svc->started = true;
+    return 0;
+}
+
+/**
+ * @brief Stop the workers, wake any waiting clients, wipe the keys and
+ *        remove the region. Requests still queued are not completed.
+ */
+void aes_shm_service_stop(Aes_shm_service* svc) {
+    Aes_shm_region* region = svc->region;
+    if (!region)
+        return;
+
+    atomic_store(&region->running, 0);
+    for (int i = 0; i < AES_SHM_MAX_WORKERS; i++)
+        ring_notify(&region->submit[i]);
+    for (int i = 0; i < AES_SHM_MAX_CLIENTS; i++)
+        ring_notify(&region->complete[i]);
+    if (svc->started)
+        for (int i = 0; i < svc->num_workers; i++)
+            pthread_join(svc->workers[i].thread, NULL);
+
+    memset(svc->keys, 0, AES_SHM_MAX_KEYS * sizeof(Shm_key));
+    free(svc->keys);
+    munmap(region, region->size);
+    shm_unlink(svc->name);
+    svc->region = NULL;
+    svc->started = false;
+}
+
+/* --------------------------------------------------------------------------
+ * Client
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Release the slots held by processes that no longer exist. A slot
+ *        whose owner is not recorded yet is being attached and is left
+ *        alone. Returns the slots in use afterwards.
+ */
+static uint64_t reclaim_slots(Aes_shm_region* region) {
+    uint64_t used = atomic_load(&region->clients);
+    for (int slot = 0; slot < AES_SHM_MAX_CLIENTS; slot++) {
+        int32_t pid = atomic_load(&region->owners[slot]);
+        if (!(used & (1ULL << slot)) || pid == 0 || kill(pid, 0) == 0 || errno != ESRCH)
+            continue;
+        if (atomic_compare_exchange_strong(&region->owners[slot], &pid, 0))
+            used = atomic_fetch_and(&region->clients, ~(1ULL << slot)) & ~(1ULL << slot);
+    }
+    return used;
+}
+
+/**
+ * @brief Map a running service's region and claim a client slot, with its
+ *        payload area at c->area. Returns 0 on success, -1 on error.
+ */
+int aes_shm_attach(Aes_shm_client* c, const char* name) {
+    memset(c, 0, sizeof(*c));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(Aes_shm_region))
+        map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: failed to map %s\n", name);
+        return -1;
+    }
+
+    Aes_shm_region* region = map;
+    if (region->magic != AES_SHM_MAGIC || region->version != AES_SHM_VERSION ||
+            region->size != (uint64_t)st.st_size || region->num_workers < 1 ||
+            region->num_workers > AES_SHM_MAX_WORKERS) {
+        fprintf(stderr, "Error: %s is not an encryption service region\n", name);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    uint64_t used = reclaim_slots(region);
+    int slot;
+    do {
+        if (used == UINT64_MAX) {
+            fprintf(stderr, "Error: %s already has %d clients\n", name, AES_SHM_MAX_CLIENTS);
+            munmap(map, st.st_size);
+            return -1;
+        }
+        slot = __builtin_ctzll(~used);
+    } while (!atomic_compare_exchange_weak(&region->clients, &used, used | (1ULL << slot)));
+
+    atomic_store(&region->owners[slot], (int32_t)getpid());
+    c->region = region;
+    c->id = (uint16_t)slot;
+    c->area = client_area(region, c->id);
+    c->area_size = region->area_size;
+
+    c->generation = (uint16_t)(atomic_fetch_add(&region->generations[slot], 1) + 1);
+
+    // Drop completions left for a previous holder of the slot; any still in
+    // flight are dropped by generation as they arrive
+    Aes_shm_request stale;
+    while (ring_pop(&region->complete[c->id], &stale))
+        ;
+    return 0;
+}
+
+/**
+ * @brief Queue a request on the next worker's ring. The payload must already
+ *        be in c->area. Returns 0, or -1 if the client has AES_SHM_MAX_IN_FLIGHT
+ *        requests in flight, every ring is full, or the service has stopped;
+ *        after -1 collect some completions and submit again.
+ */
+int aes_shm_submit(Aes_shm_client* c, Aes_shm_request* req) {
+    Aes_shm_region* region = c->region;
+    if (c->in_flight >= AES_SHM_MAX_IN_FLIGHT || !atomic_load(&region->running))
+        return -1;
+
+    req->client = c->id;
+    req->generation = c->generation;
+    for (uint32_t i = 0; i < region->num_workers; i++) {
+        uint32_t w = (c->next_worker + i) % region->num_workers;
+        if (ring_push(&region->submit[w], req)) {
+            c->next_worker = w + 1;
+            c->in_flight++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Collect a completion without waiting. Returns 1 if one was copied
+ *        into done, otherwise 0.
+ */
+int aes_shm_poll(Aes_shm_client* c, Aes_shm_request* done) {
+    do {
+        if (!ring_pop(&c->region->complete[c->id], done))
+            return 0;
+    } while (done->generation != c->generation);
+    c->in_flight--;
+    return 1;
+}
+
+/**
+ * @brief Wait for the next completion, in whatever order the workers finish.
+ *        Returns 0, or -1 if nothing is in flight or the service stopped.
+ */
+int aes_shm_wait(Aes_shm_client* c, Aes_shm_request* done) {
+    if (c->in_flight == 0)
+        return -1;
+    do {
+        if (!ring_wait(&c->region->complete[c->id], done, &c->region->running))
+            return -1;
+    } while (done->generation != c->generation);
+    c->in_flight--;
+    return 0;
+}
+
+/**
+ * @brief Wait for the client's requests still in flight, discarding their
+ *        completions, then release the client slot and unmap the region.
+ */
+void aes_shm_detach(Aes_shm_client* c) {
+    if (!c->region)
+        return;
+    Aes_shm_request done;
+    while (c->in_flight > 0 && aes_shm_wait(c, &done) == 0)
+        ;
+    atomic_store(&c->region->owners[c->id], 0);
+    atomic_fetch_and(&c->region->clients, ~(1ULL << c->id));
+    munmap(c->region, c->region->size);
+    c->region = NULL;
+}
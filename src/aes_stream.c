@@ -0,0 +1,95 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_stream.c
+ *
+ * Description:
+ *   Incremental init/update/final interface to the modes of operation.
+ *
+ * Details:
+ *   Each update joins the buffered tail with the new input, sends the whole
+ *   blocks through aes_mode() in a single call and keeps the rest (at most
+ *   15 bytes) in the context. When decrypting with padding, the last whole
+ *   block is also held back, since only aes_stream_final() knows it is the
+ *   one carrying the padding.
+ *
+ *   Without padding, ECB and CBC need the total length to be a multiple of
+ *   16; CFB, OFB and CTR encrypt a trailing partial block in final.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_stream.h"
+
+/**
+ * @brief Start a stream under an expanded key. iv may be NULL for ECB.
+ */
+void aes_stream_init(Aes_stream* s, Op_mode op_mode, uint8_t* ekey, int len_key,
+        const uint8_t* iv, bool is_encrypt, bool padded) {
+    s->op_mode = op_mode;
+    s->ekey = ekey;
+    s->len_key = len_key;
+    s->is_encrypt = is_encrypt;
+    s->padded = padded;
+    if (iv)
+        memcpy(s->iv, iv, 16);
+    else
+        memset(s->iv, 0, 16);
+    s->len_tail = 0;
+}
+
+/**
+ * @brief Process the next piece of the message into out.
+ *
+ * out must have room for len + 15 bytes and must not overlap in. Returns the
+ * number of bytes written, which may be less than len while data is held
+ * back for the next call.
+ */
+int64_t aes_stream_update(Aes_stream* s, const uint8_t* in, uint64_t len, uint8_t* out) {
+    uint64_t total = s->len_tail + len;
+    uint64_t run = total & ~(uint64_t)15;
+
+    // Keep the block that may hold the padding until final
+    if (s->padded && !s->is_encrypt && run == total && run > 0)
+        run -= 16;
+
+    if (run == 0) {
+        memcpy(s->tail + s->len_tail, in, len);
+        s->len_tail += len;
+        return 0;
+    }
+
+    uint64_t from_in = run - s->len_tail;
+    memcpy(out, s->tail, s->len_tail);
+    memcpy(out + s->len_tail, in, from_in);
+    aes_mode(s->op_mode, out, run, s->ekey, s->len_key, s->iv, s->is_encrypt);
+
+    s->len_tail = total - run;
+    memcpy(s->tail, in + from_in, s->len_tail);
+    return run;
+}
+
+/**
+ * @brief Finish the stream, writing at most 16 bytes to out. Returns the
+ *        number of bytes written, or -1 if the length or padding is invalid.
+ */
+int64_t aes_stream_final(Aes_stream* s, uint8_t* out) {
+    int64_t len = s->len_tail;
+    bool is_block_mode = s->op_mode == ECB || s->op_mode == CBC;
+    s->len_tail = 0;
+
+    if (s->padded && s->is_encrypt) {
+        memcpy(out, s->tail, len);
+        len = pad_vector(out, len);
+    } else if (s->padded || is_block_mode) {
+        if (len != (s->padded ? 16 : 0))
+            return -1;
+        memcpy(out, s->tail, len);
+    } else {
+        memcpy(out, s->tail, len);
+    }
+
+    aes_mode(s->op_mode, out, len, s->ekey, s->len_key, s->iv, s->is_encrypt);
+
+    if (s->padded && !s->is_encrypt)
+        len = unpad_vector(out, len);
+    return len;
+}
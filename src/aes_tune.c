@@ -0,0 +1,386 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: aes_tune.c
+ *
+ * Description:
+ *   Calibration of the pipeline and cipher parameters, and the profile file
+ *   that stores the result.
+ *
+ * Details:
+ *   The parameters are tuned one at a time, each with the others held at
+ *   the best values found so far: interleave width first (in memory),
+ *   then I/O backend, worker threads, chunk size and queue depth. Each
+ *   candidate enciphers a temporary file in CTR mode, the mode that keeps
+ *   every worker busy, and scores the best of two runs. A full search of
+ *   every combination would take minutes; this takes seconds, and every
+ *   parameter is still measured on the host it will run on.
+ *
+ *   Profiles are written under $XDG_CONFIG_HOME/aes (or ~/.config/aes) as
+ *   <hostname>.profile, so a home directory shared by several machines
+ *   keeps a profile for each. Unknown keys are ignored, so older builds can
+ *   still read profiles that newer ones write.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/aes_tune.h"
+#include "../include/aes_afalg.h"
+#include "../include/aes_metrics.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TUNE_MEMORY_SAMPLE (1 << 20)
+
+static const char* BACKEND_NAMES[] = { "auto", "uring", "threads", "afalg" };
+
+/* --------------------------------------------------------------------------
+ * Profile Files
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Fill a profile with the built-in defaults.
+ */
+void aes_profile_defaults(Aes_profile* profile) {
+    aes_io_default_opts(&profile->io);
+    profile->interleave = AES_INTERLEAVE_MAX;
+}
+
+/**
+ * @brief Build the profile path for this host. Returns 0, or -1 if neither
+ *        XDG_CONFIG_HOME nor HOME is set.
+ */
+int aes_profile_default_path(char* path, size_t size) {
+    char host[256];
+    if (gethostname(host, sizeof(host)) < 0)
+        strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+
+    const char* config = getenv("XDG_CONFIG_HOME");
+    const char* home = getenv("HOME");
+    if (config && *config)
+        snprintf(path, size, "%s/aes/%s.profile", config, host);
+    else if (home && *home)
+        snprintf(path, size, "%s/.config/aes/%s.profile", home, host);
+    else
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Read a profile over the values already in *profile. Returns 0 once
+ *        loaded, 1 if there is no profile file, or -1 after printing an
+ *        error if the file cannot be read or is malformed.
+ */
+int aes_profile_load(const char* path, Aes_profile* profile) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        if (errno == ENOENT)
+            return 1;
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    Aes_profile loaded = *profile;
+    char line[256];
+    int line_num = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_num++;
+        char key[64], value[128];
+        strip_whitespace(line);
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        if (sscanf(line, "%63[^=]=%127s", key, value) != 2) {
+            ok = false;
+            break;
+        }
+
+        char* end;
+        long long n = strtoll(value, &end, 10);
+        bool numeric = *end == '\0' && n > 0;
+
+        if (!strcmp(key, "backend")) {
+            ok = false;
+            for (int b = 0; b < 4; b++) {
+                if (!strcmp(value, BACKEND_NAMES[b])) {
+                    loaded.io.backend = (Io_backend)b;
+                    ok = true;
+                }
+            }
+        } else if (!strcmp(key, "chunk")) {
+            ok = numeric && n >= 16 && (uint64_t)n <= AES_IO_MAX_CHUNK;
+            loaded.io.chunk_size = n;
+        } else if (!strcmp(key, "depth")) {
+            ok = numeric && n <= 4096;
+            loaded.io.queue_depth = (int)n;
+        } else if (!strcmp(key, "threads")) {
+            ok = numeric && n <= 4096;
+            loaded.io.num_threads = (int)n;
+        } else if (!strcmp(key, "interleave")) {
+            ok = numeric && (n == 1 || n == 4 || n == 8);
+            loaded.interleave = (int)n;
+        }
+    }
+    fclose(f);
+
+    if (!ok) {
+        fprintf(stderr, "Error: %s:%d: invalid profile entry\n", path, line_num);
+        return -1;
+    }
+    *profile = loaded;
+    return 0;
+}
+
+/**
+ * @brief Write the tuned settings in profile file format.
+ */
+void aes_profile_print(FILE* f, const Aes_profile* profile) {
+    fprintf(f, "backend=%s\n", BACKEND_NAMES[profile->io.backend]);
+    fprintf(f, "chunk=%lu\n", profile->io.chunk_size);
+    fprintf(f, "depth=%d\n", profile->io.queue_depth);
+    if (profile->io.num_threads > 0)
+        fprintf(f, "threads=%d\n", profile->io.num_threads);
+    fprintf(f, "interleave=%d\n", profile->interleave);
+}
+
+/**
+ * @brief Create the directory holding path and every parent it needs.
+ */
+static int make_parents(const char* path) {
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char* slash = strrchr(dir, '/');
+    if (!slash || slash == dir)
+        return 0;
+    *slash = '\0';
+
+    for (char* p = dir + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+    return mkdir(dir, 0755) < 0 && errno != EEXIST ? -1 : 0;
+}
+
+/**
+ * @brief Save a profile, creating its directory if needed. Returns 0 on
+ *        success, -1 after printing an error.
+ */
+int aes_profile_save(const char* path, const Aes_profile* profile) {
+    FILE* f = make_parents(path) == 0 ? fopen(path, "w") : NULL;
+    if (!f) {
+        fprintf(stderr, "Error: failed to write %s\n", path);
+        return -1;
+    }
+    fprintf(f, "# Written by aes --autotune; edit or delete to change\n");
+    aes_profile_print(f, profile);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/* --------------------------------------------------------------------------
+ * Calibration
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Best in-memory CTR throughput of three runs, in bytes per ns.
+ */
+static double time_memory(uint8_t* buf, uint64_t len, uint8_t* ekey) {
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        uint8_t iv[16] = {0};
+        uint64_t start = metrics_now_ns();
+        aes_ctr(buf, len, ekey, 16, iv);
+        double rate = (double)len / (double)(metrics_now_ns() - start + 1);
+        if (rate > best)
+            best = rate;
+    }
+    return best;
+}
+
+/**
+ * @brief Best pipeline throughput of two runs, in bytes per ns, or -1 if
+ *        the settings do not work on this host.
+ */
+static double time_pipeline(char* in_file, char* out_file, uint64_t len, uint8_t* ekey,
+        Aes_io_opts* opts) {
+    double best = 0;
+    for (int run = 0; run < 2; run++) {
+        uint8_t iv[16] = {0};
+        uint64_t start = metrics_now_ns();
+        if (aes_file_pipeline(in_file, out_file, CTR, ekey, 16, iv, true, opts) < 0)
+            return -1;
+        double rate = (double)len / (double)(metrics_now_ns() - start + 1);
+        if (rate > best)
+            best = rate;
+    }
+    return best;
+}
+
+typedef enum tune_param {
+    TUNE_BACKEND, TUNE_THREADS, TUNE_CHUNK, TUNE_DEPTH
+} Tune_param;
+
+static const char* PARAM_NAMES[] = { "backend", "threads", "chunk", "depth" };
+
+static void set_param(Aes_io_opts* io, Tune_param param, long long value) {
+    switch (param) {
+        case TUNE_BACKEND: io->backend = (Io_backend)value; break;
+        case TUNE_THREADS: io->num_threads = (int)value; break;
+        case TUNE_CHUNK:   io->chunk_size = (uint64_t)value; break;
+        case TUNE_DEPTH:   io->queue_depth = (int)value; break;
+    }
+}
+
+/**
+ * @brief Time each candidate value of one pipeline parameter, holding the
+ *        others in io fixed, and leave the fastest in io. Returns its rate in
+ *        bytes per ns, or -1 if no candidate worked.
+ */
+static double tune_param(Aes_io_opts* io, Tune_param param, const long long* candidates,
+        int num_candidates, char* in_file, char* out_file, uint64_t len, uint8_t* ekey,
+        bool verbose) {
+    double best = -1;
+    long long best_value = 0;
+
+    for (int c = 0; c < num_candidates; c++) {
+        set_param(io, param, candidates[c]);
+        double rate = time_pipeline(in_file, out_file, len, ekey, io);
+        if (rate < 0)
+            continue;
+        if (verbose && param == TUNE_BACKEND)
+            fprintf(stderr, "  %-10s %-8s %9.1f MiB/s\n", PARAM_NAMES[param],
+                    BACKEND_NAMES[candidates[c]], rate * 1e9 / (1 << 20));
+        else if (verbose)
+            fprintf(stderr, "  %-10s %-8lld %9.1f MiB/s\n", PARAM_NAMES[param], candidates[c],
+                    rate * 1e9 / (1 << 20));
+        if (rate > best) {
+            best = rate;
+            best_value = candidates[c];
+        }
+    }
+
+    if (best > 0)
+        set_param(io, param, best_value);
+    return best;
+}
+
+/**
+ * @brief Calibrate this host, starting from the built-in defaults, and store
+ *        the fastest settings found in profile. sample_size bytes are
+ *        enciphered per pipeline timing; 0 sizes them from the measured
+ *        cipher rate so each takes about AES_TUNE_RUN_MS. Returns 0, or -1
+ *        on error.
+ */
+int aes_autotune(Aes_profile* profile, uint64_t sample_size, bool verbose) {
+    aes_profile_defaults(profile);
+    profile->io.numa = true;
+
+    uint8_t key[16], ekey[176];
+    for (int i = 0; i < 16; i++)
+        key[i] = (uint8_t)i;
+    expand_key(key, 16, ekey);
+
+    // Interleave width, in memory so the I/O does not drown the difference
+    uint64_t memory_sample = sample_size && sample_size < TUNE_MEMORY_SAMPLE ? sample_size
+            : TUNE_MEMORY_SAMPLE;
+    uint8_t* buf = malloc(memory_sample);
+    memset(buf, 0, memory_sample);
+    int widths[3] = { 1, 4, 8 };
+    double best = 0;
+    for (int w = 0; w < 3; w++) {
+        aes_set_interleave(widths[w]);
+        double rate = time_memory(buf, memory_sample, ekey);
+        if (verbose)
+            fprintf(stderr, "  %-10s %-8d %9.1f MiB/s\n", "interleave", widths[w],
+                    rate * 1e9 / (1 << 20));
+        if (rate > best) {
+            best = rate;
+            profile->interleave = widths[w];
+        }
+    }
+    free(buf);
+    aes_set_interleave(profile->interleave);
+
+    if (sample_size == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        sample_size = (uint64_t)(best * 1e6 * AES_TUNE_RUN_MS) * (cpus > 0 ? cpus : 1);
+        sample_size = sample_size < TUNE_MEMORY_SAMPLE ? TUNE_MEMORY_SAMPLE
+                : sample_size > AES_TUNE_MAX_SAMPLE ? AES_TUNE_MAX_SAMPLE : sample_size;
+    }
+
+    // A sample file in the temporary directory, where bulk jobs usually stage
+    const char* tmp = getenv("TMPDIR");
+    char in_file[4096], out_file[4096 + 8];
+    snprintf(in_file, sizeof(in_file), "%s/aes-tune-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    int fd = mkstemp(in_file);
+    if (fd < 0) {
+        fprintf(stderr, "Error: failed to create a calibration file\n");
+        return -1;
+    }
+    snprintf(out_file, sizeof(out_file), "%s.out", in_file);
+
+    uint8_t block[65536];
+    memset(block, 0xA5, sizeof(block));
+    bool ok = true;
+    for (uint64_t done = 0; ok && done < sample_size; done += sizeof(block)) {
+        uint64_t n = sample_size - done < sizeof(block) ? sample_size - done : sizeof(block);
+        ok = write(fd, block, n) == (ssize_t)n;
+    }
+    close(fd);
+
+    if (ok) {
+        long long backends[3];
+        int num_backends = 0;
+        backends[num_backends++] = IO_THREADS;
+        if (aes_io_uring_available())
+            backends[num_backends++] = IO_URING;
+        if (aes_afalg_available(CTR))
+            backends[num_backends++] = IO_AF_ALG;
+
+        long long threads[16];
+        int num_threads = 0;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long t = 1; t < cpus && num_threads < 15; t *= 2)
+            threads[num_threads++] = t;
+        threads[num_threads++] = cpus > 0 ? cpus : 1;
+
+        long long chunks[5];
+        int num_chunks = 0;
+        for (uint64_t c = 256 << 10; c <= (16 << 20) && num_chunks < 5; c *= 4)
+            if (c * 4 <= sample_size || num_chunks == 0)
+                chunks[num_chunks++] = c;
+
+        long long depths[3] = { 4, 8, 16 };
+
+        if (verbose)
+            fprintf(stderr, "Calibrating with %lu bytes per run:\n", sample_size);
+        Aes_io_opts* io = &profile->io;
+        best = tune_param(io, TUNE_BACKEND, backends, num_backends, in_file, out_file,
+                sample_size, ekey, verbose);
+
+        // AF_ALG does its own threading and queueing; only its chunk size matters
+        if (best > 0 && io->backend != IO_AF_ALG)
+            best = tune_param(io, TUNE_THREADS, threads, num_threads, in_file, out_file,
+                    sample_size, ekey, verbose);
+        if (best > 0)
+            best = tune_param(io, TUNE_CHUNK, chunks, num_chunks, in_file, out_file,
+                    sample_size, ekey, verbose);
+        if (best > 0 && io->backend != IO_AF_ALG)
+            best = tune_param(io, TUNE_DEPTH, depths, 3, in_file, out_file, sample_size, ekey,
+                    verbose);
+        ok = best > 0;
+    }
+
+    unlink(in_file);
+    unlink(out_file);
+    if (!ok) {
+        fprintf(stderr, "Error: calibration failed\n");
+        return -1;
+    }
+    return 0;
+}
@@ -12,7 +12,7 @@
  * Details:
  *   Implements AES-128, AES-192, and AES-256 key schedule variants.
  *   Includes helper functions for:
- *     - Whitespace stripping and hex parsing from text key files
+ *     - Whitespace stripping and hex parsing from text key files (see hex.c)
  *     - S-box substitution (SubWord)
  *     - Word rotation (RotWord)
  *     - Round constant lookup (Rcon)
@@ -29,6 +29,8 @@
  */
 
 #include "../include/expand_key.h"
+#include "../include/hex.h"
+#include "../include/aes_metrics.h"
 
 /* --------------------------------------------------------------------------
  * File Reading Utilities
@@ -50,76 +52,39 @@ void strip_whitespace(char* s) {
 
 /**
  * @brief Convert a single hexadecimal character to its numeric 4-bit value.
- *        Exits on invalid input.
+ *        Returns 0xFF on invalid input.
  */
 uint8_t char_to_hex(char c) {
-    switch (c) {
-        case '0': return 0x00;
-        case '1': return 0x01;
-        case '2': return 0x02;
-        case '3': return 0x03;
-        case '4': return 0x04;
-        case '5': return 0x05;
-        case '6': return 0x06;
-        case '7': return 0x07;
-        case '8': return 0x08;
-        case '9': return 0x09;
-        case 'A': case 'a': return 0x0A;
-        case 'B': case 'b': return 0x0B;
-        case 'C': case 'c': return 0x0C;
-        case 'D': case 'd': return 0x0D;
-        case 'E': case 'e': return 0x0E;
-        case 'F': case 'f': return 0x0F;
-        default:
-            fprintf(stderr, "Error: Invalid character [%c] in key file\n", c);
-            exit(1);
-        }
-
-        return -1;
+    return hex_digit_value(c);
 }
 /* --------------------------------------------------------------------------
  * Key Reading
  * -------------------------------------------------------------------------- */
 
 /**
- * @brief Read an ASCII hex key file, strip whitespace, and load bytes into key[].
+ * @brief Read an ASCII hex key file, skipping whitespace, and load bytes into key[].
  *        Supports AES-128/192/256 key lengths (16/24/32 bytes).
+ *        Returns the key length, or -1 after printing an error.
  */
 int read_key(char* key_file, uint8_t* key) {
+    int err;
+    uint64_t len;
 
-    FILE* f = fopen(key_file, "r");
-    if (!f) {
-        fprintf(stderr, "Error: failed to open %s\n", key_file);
-        free(key);
-        exit(1);
+    uint8_t* bytes = hex_read_file(key_file, &len, &err);
+    if (!bytes) {
+        fprintf(stderr, "Error: %s: %s\n", key_file, hex_strerror(err));
+        return -1;
     }
 
-    char buffer[BUFSIZ];
-
-    int c;
-    int i = 0;
-    while ((c = fgetc(f)) != EOF)
-        buffer[i++] = c;
-
-    fclose(f);
-
-    buffer[i] = '\0';
-    
-    strip_whitespace(buffer);
-
-    i = 0;
-    int i2 = 0;
-    while (buffer[i2] != '\0' && buffer[i2 + 1] != '\0') {
-        key[i++] = (char_to_hex(buffer[i2]) << 4) | char_to_hex(buffer[i2 + 1]);
-        i2 += 2;
-    }
-    
-    if (i != 16 && i != 24 && i != 32) {
-        fprintf(stderr, "Error: Invalid key file length of %d\n", i);
-        exit(1);
+    if (len != 16 && len != 24 && len != 32) {
+        fprintf(stderr, "Error: Invalid key file length of %lu\n", len);
+        free(bytes);
+        return -1;
     }
 
-    return i;
+    memcpy(key, bytes, len);
+    free(bytes);
+    return (int)len;
 }
 /* --------------------------------------------------------------------------
  * Rijndael Word Operations
@@ -212,7 +177,8 @@ void store_ekey(uint8_t* loc, uint32_t store_val) {
  * Expands 16-, 24-, or 32-byte cipher keys into the full round key array.
  */
 void expand_key(uint8_t* key, int len_key, uint8_t* ekey) {
-    
+    metrics_count_key_expansion();
+
     // Key length determines how many rounds to expand the key
     int round_num = 0;
     int num_rounds = len_key + 28;
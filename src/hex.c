@@ -0,0 +1,360 @@
+/*
+ * -----------------------------------------------------------------------------
+ * File: hex.c
+ *
+ * Description:
+ *   Table-driven hexadecimal decoder with whitespace skipping.
+ *
+ * Details:
+ *   Every input character is classified with one lookup into HEX_TABLE,
+ *   which maps hex digits to their value and marks whitespace, so decoding
+ *   and stripping happen in the same pass with no per-character branching
+ *   on the digit itself. On x86-64 runs of 32 digits without whitespace are
+ *   decoded 16 output bytes at a time with SSE2, or runs of 64 digits 32
+ *   bytes at a time with AVX2 when hex_use_avx2() selects it.
+ *
+ *   Hex_decoder carries a half-decoded byte between calls, so a file or
+ *   network stream can be decoded piece by piece with the pieces split at
+ *   any character.
+ * -----------------------------------------------------------------------------
+ */
+
+#include "../include/hex.h"
+
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+#define HEX_AVX2 1
+#include <immintrin.h>
+#endif
+
+#define HEX_READ_CHUNK 65536
+
+/* --------------------------------------------------------------------------
+ * Character Classification Table
+ * --------------------------------------------------------------------------
+ * 0x00-0x0F: value of a hex digit
+ * WS:        whitespace, skipped
+ * XX:        invalid character
+ * -------------------------------------------------------------------------- */
+#define WS 0x10
+#define XX 0xFF
+
+static const uint8_t HEX_TABLE[256] = {
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   WS,   WS,   WS,   WS,   WS,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      WS,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,
+};
+
+/**
+ * @brief Value of a single hex digit, or 0xFF if c is not a hex digit.
+ */
+uint8_t hex_digit_value(char c) {
+    uint8_t v = HEX_TABLE[(uint8_t)c];
+    return v < 0x10 ? v : 0xFF;
+}
+
+/* --------------------------------------------------------------------------
+ * SIMD Fast Paths
+ * -------------------------------------------------------------------------- */
+
+#ifdef __SSE2__
+
+/**
+ * @brief Convert 16 hex characters to their nibble values.
+ *        Returns false if any character is not a hex digit.
+ */
+static inline bool nibbles_sse2(__m128i c, __m128i* nibbles) {
+    __m128i digit  = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+
+    // Unsigned x <= n is min(x, n) == x
+    __m128i is_digit  = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xFFFF)
+        return false;
+
+    *nibbles = _mm_or_si128(_mm_and_si128(digit, is_digit),
+            _mm_and_si128(_mm_add_epi8(letter, _mm_set1_epi8(10)), is_letter));
+    return true;
+}
+
+/**
+ * @brief Decode 32 hex characters into 16 bytes.
+ *        Returns false without writing if the run contains anything else.
+ */
+static inline bool hex_decode_sse2(const uint8_t* in, uint8_t* out) {
+    __m128i lo, hi;
+    if (!nibbles_sse2(_mm_loadu_si128((const __m128i*)in), &lo) ||
+            !nibbles_sse2(_mm_loadu_si128((const __m128i*)(in + 16)), &hi))
+        return false;
+
+    // Each 16-bit lane holds a digit pair: high nibble in the low byte
+    __m128i mask = _mm_set1_epi16(0x00FF);
+    lo = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(lo, mask), 4), _mm_srli_epi16(lo, 8));
+    hi = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(hi, mask), 4), _mm_srli_epi16(hi, 8));
+
+    _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(lo, hi));
+    return true;
+}
+
+/**
+ * @brief Decode whole 32-character runs from the start of in until one holds
+ *        anything but hex digits. Returns the number of characters consumed.
+ */
+static uint64_t hex_runs_sse2(const uint8_t* in, uint64_t len, uint8_t* out) {
+    uint64_t done = 0;
+    while (len - done >= 32 && hex_decode_sse2(in + done, out + done/2))
+        done += 32;
+    return done;
+}
+
+#endif
+
+#ifdef HEX_AVX2
+
+__attribute__((target("avx2")))
+static inline bool nibbles_avx2(__m256i c, __m256i* nibbles) {
+    __m256i digit  = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+
+    __m256i is_digit  = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+
+    if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1)
+        return false;
+
+    *nibbles = _mm256_or_si256(_mm256_and_si256(digit, is_digit),
+            _mm256_and_si256(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), is_letter));
+    return true;
+}
+
+/**
+ * @brief Decode 64 hex characters into 32 bytes, as hex_decode_sse2().
+ */
+__attribute__((target("avx2")))
+static inline bool hex_decode_avx2(const uint8_t* in, uint8_t* out) {
+    __m256i lo, hi;
+    if (!nibbles_avx2(_mm256_loadu_si256((const __m256i*)in), &lo) ||
+            !nibbles_avx2(_mm256_loadu_si256((const __m256i*)(in + 32)), &hi))
+        return false;
+
+    __m256i mask = _mm256_set1_epi16(0x00FF);
+    lo = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(lo, mask), 4), _mm256_srli_epi16(lo, 8));
+    hi = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(hi, mask), 4), _mm256_srli_epi16(hi, 8));
+
+    // The pack works within 128-bit halves, so put the 64-bit quarters back in order
+    __m256i packed = _mm256_packus_epi16(lo, hi);
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute4x64_epi64(packed, 0xD8));
+    return true;
+}
+
+__attribute__((target("avx2")))
+static uint64_t hex_runs_avx2(const uint8_t* in, uint64_t len, uint8_t* out) {
+    uint64_t done = 0;
+    while (len - done >= 64 && hex_decode_avx2(in + done, out + done/2))
+        done += 64;
+    return done + hex_runs_sse2(in + done, len - done, out + done/2);
+}
+
+#endif
+
+#ifdef __SSE2__
+static uint64_t (*hex_runs)(const uint8_t* in, uint64_t len, uint8_t* out) = hex_runs_sse2;
+#endif
+
+/**
+ * @brief Select the AVX2 fast path if enable is set and the CPU has it,
+ *        otherwise SSE2 (or none). Returns whether AVX2 is in use.
+ */
+bool hex_use_avx2(bool enable) {
+#ifdef HEX_AVX2
+    if (enable && __builtin_cpu_supports("avx2")) {
+        hex_runs = hex_runs_avx2;
+        return true;
+    }
+#endif
+#ifdef __SSE2__
+    hex_runs = hex_runs_sse2;
+#endif
+    (void)enable;
+    return false;
+}
+
+/* --------------------------------------------------------------------------
+ * Streaming Decoder
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Reset a streaming decoder.
+ */
+void hex_decoder_init(Hex_decoder* d) {
+    d->pending = 0;
+    d->has_pending = false;
+    d->position = 0;
+    d->bad_char = '\0';
+}
+
+/**
+ * @brief Decode the next piece of a hex stream into out, skipping whitespace.
+ *
+ * out must have room for len/2 + 1 bytes. Returns the number of bytes
+ * written, or HEX_ERR_CHAR with d->position and d->bad_char set to the
+ * offending character.
+ */
+int64_t hex_decode_update(Hex_decoder* d, const char* in, uint64_t len, uint8_t* out) {
+    const uint8_t* p = (const uint8_t*)in;
+    const uint8_t* end = p + len;
+    uint8_t* o = out;
+
+    while (p < end) {
+#ifdef __SSE2__
+        if (!d->has_pending) {
+            uint64_t n = hex_runs(p, end - p, o);
+            p += n;
+            o += n/2;
+        }
+#endif
+        // Whitespace or a half byte blocks the fast path, so step over the
+        // next run one character at a time before trying it again
+        const uint8_t* run_end = end - p > 32 ? p + 32 : end;
+        for (; p < run_end; p++) {
+            uint8_t v = HEX_TABLE[*p];
+            if (v < 0x10) {
+                if (d->has_pending)
+                    *o++ = (uint8_t)(d->pending << 4) | v;
+                else
+                    d->pending = v;
+                d->has_pending = !d->has_pending;
+            } else if (v != WS) {
+                d->position += p - (const uint8_t*)in;
+                d->bad_char = (char)*p;
+                return HEX_ERR_CHAR;
+            }
+        }
+    }
+
+    d->position += len;
+    return o - out;
+}
+
+/**
+ * @brief Finish a stream. Returns HEX_ERR_ODD if a byte was left half decoded.
+ */
+int hex_decode_final(Hex_decoder* d) {
+    return d->has_pending ? HEX_ERR_ODD : HEX_OK;
+}
+
+/**
+ * @brief Decode a complete hex string. Returns the number of bytes written
+ *        to out (at most len/2) or a negative HEX_ERR_* code.
+ */
+int64_t hex_decode(const char* in, uint64_t len, uint8_t* out) {
+    Hex_decoder d;
+    hex_decoder_init(&d);
+    int64_t n = hex_decode_update(&d, in, len, out);
+    if (n < 0)
+        return n;
+    int err = hex_decode_final(&d);
+    return err < 0 ? err : n;
+}
+
+/* --------------------------------------------------------------------------
+ * File Decoding
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Decode a hex text file of any size into a newly allocated buffer.
+ *
+ * The buffer always has at least 16 spare bytes past *size so callers can
+ * pad in place. Returns NULL and sets *err on failure.
+ */
+uint8_t* hex_read_file(char* hex_file, uint64_t* size, int* err) {
+    FILE* f = fopen(hex_file, "r");
+    if (!f) {
+        *err = HEX_ERR_IO;
+        return NULL;
+    }
+
+    char* buffer = malloc(HEX_READ_CHUNK);
+    uint64_t capacity = BUFSIZ;
+    uint8_t* out = malloc(capacity);
+    if (!buffer || !out) {
+        *err = HEX_ERR_NOMEM;
+        goto fail;
+    }
+
+    Hex_decoder d;
+    hex_decoder_init(&d);
+    *size = 0;
+
+    size_t n;
+    while ((n = fread(buffer, 1, HEX_READ_CHUNK, f)) > 0) {
+        while (*size + n/2 + 1 + 16 > capacity) {
+            capacity *= 2;
+            uint8_t* bigger = realloc(out, capacity);
+            if (!bigger) {
+                *err = HEX_ERR_NOMEM;
+                goto fail;
+            }
+            out = bigger;
+        }
+
+        int64_t r = hex_decode_update(&d, buffer, n, out + *size);
+        if (r < 0) {
+            *err = (int)r;
+            goto fail;
+        }
+        *size += r;
+    }
+
+    if (ferror(f)) {
+        *err = HEX_ERR_IO;
+        goto fail;
+    }
+
+    *err = hex_decode_final(&d);
+    if (*err < 0)
+        goto fail;
+
+    free(buffer);
+    fclose(f);
+    return out;
+
+fail:
+    free(buffer);
+    free(out);
+    fclose(f);
+    return NULL;
+}
+
+/**
+ * @brief Describe a HEX_ERR_* code.
+ */
+const char* hex_strerror(int err) {
+    switch (err) {
+        case HEX_OK:        return "success";
+        case HEX_ERR_CHAR:  return "invalid character in hex input";
+        case HEX_ERR_ODD:   return "odd number of hex digits";
+        case HEX_ERR_IO:    return "failed to read file";
+        case HEX_ERR_NOMEM: return "out of memory";
+        default:            return "unknown error";
+    }
+}
@@ -0,0 +1,142 @@
+#include "../../include/aes_cpp_test.h"
+
+#include <type_traits>
+#include <vector>
+
+// The generated tables are usable in constant expressions
+static_assert(caes::tables::sbox[0x00] == 0x63 && caes::tables::sbox[0x53] == 0xED);
+static_assert(caes::tables::inv_sbox[0x63] == 0x00);
+static_assert(caes::tables::rcon[9] == 0x36000000);
+
+static_assert(!std::is_copy_constructible_v<caes::Aes128>);
+static_assert(!std::is_copy_assignable_v<caes::Aes128>);
+static_assert(std::is_nothrow_move_constructible_v<caes::Aes256>);
+static_assert(caes::Aes192::len_ekey == 208);
+
+void test_cpp_tables() {
+    namespace t = caes::tables;
+    assert(!memcmp(t::sbox.data(), AES_SBOX, 256));
+    assert(!memcmp(t::inv_sbox.data(), AES_INV_SBOX, 256));
+    assert(!memcmp(t::exp.data(), AES_E, 256));
+    assert(!memcmp(t::log.data(), AES_L, 256));
+    assert(!memcmp(t::rcon.data(), AES_RCON, sizeof(AES_RCON)));
+    for (int row = 0; row < 4; row++) {
+        assert(!memcmp(t::mul_e[row].data(), AES_MUL_E[row], 4));
+        assert(!memcmp(t::mul_d[row].data(), AES_MUL_D[row], 4));
+    }
+    puts("cpp_tables passed!");
+}
+
+template <int KeyBits>
+static void check_fips197(const std::array<uint8_t, 16>& expected) {
+    // FIPS-197 Appendix C: plaintext 00112233...ff under keys 000102...
+    std::array<uint8_t, KeyBits / 8> key;
+    std::array<uint8_t, 16> block;
+    for (size_t i = 0; i < key.size(); i++)
+        key[i] = (uint8_t)i;
+    for (int i = 0; i < 16; i++)
+        block[i] = (uint8_t)(i * 0x11);
+
+    caes::Aes<KeyBits> cipher(key);
+    cipher.encrypt_block(block);
+    assert(block == expected);
+    cipher.decrypt_block(block);
+    for (int i = 0; i < 16; i++)
+        assert(block[i] == (uint8_t)(i * 0x11));
+}
+
+void test_cpp_blocks() {
+    check_fips197<128>({ 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                         0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a });
+    check_fips197<192>({ 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+                         0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 });
+    check_fips197<256>({ 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+                         0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 });
+    puts("cpp_blocks passed!");
+}
+
+template <Op_mode Mode>
+static void check_mode(caes::Aes256& cipher, uint8_t* ekey, uint64_t len) {
+    std::vector<uint8_t> plain(len), data(len), out(len), expected(len);
+    for (uint64_t i = 0; i < len; i++)
+        plain[i] = data[i] = expected[i] = (uint8_t)(i * 7 + Mode);
+    std::array<uint8_t, 16> iv{}, iv_out{}, expected_iv{};
+    iv[0] = iv_out[0] = expected_iv[0] = 0xA5;
+
+    // In place and out of place both match the C entry point
+    aes_mode(Mode, expected.data(), len, ekey, 32, expected_iv.data(), true);
+    if constexpr (Mode == ECB) {
+        cipher.template encrypt<Mode>(data);
+        cipher.template encrypt<Mode>(plain, out);
+    } else {
+        cipher.template encrypt<Mode>(data, iv);
+        cipher.template encrypt<Mode>(plain, out, iv_out);
+        assert(iv == expected_iv && iv_out == expected_iv);
+    }
+    assert(data == expected && out == expected);
+    for (uint64_t i = 0; i < len; i++)
+        assert(plain[i] == (uint8_t)(i * 7 + Mode));
+
+    iv.fill(0);
+    iv[0] = 0xA5;
+    if constexpr (Mode == ECB)
+        cipher.template decrypt<Mode>(data);
+    else
+        cipher.template decrypt<Mode>(data, iv);
+    assert(data == plain);
+}
+
+void test_cpp_modes() {
+    std::array<uint8_t, 32> key;
+    uint8_t ekey[240];
+    for (int i = 0; i < 32; i++)
+        key[i] = (uint8_t)(0xF0 - i);
+    expand_key(key.data(), 32, ekey);
+    caes::Aes256 cipher(key);
+
+    check_mode<ECB>(cipher, ekey, 160);
+    check_mode<CBC>(cipher, ekey, 160);
+    check_mode<CFB>(cipher, ekey, 157);
+    check_mode<CFB8>(cipher, ekey, 37);
+    check_mode<CFB1>(cipher, ekey, 5);
+    check_mode<OFB>(cipher, ekey, 157);
+    check_mode<CTR>(cipher, ekey, 157);
+    puts("cpp_modes passed!");
+}
+
+void test_cpp_move() {
+    std::array<uint8_t, 16> key{}, block{}, expected{};
+    uint8_t ekey[240], zero[240] = {0};
+    key[15] = 1;
+    expand_key(key.data(), 16, ekey);
+    aes(expected.data(), ekey, 16, true);
+
+    caes::Aes128 first(key);
+    caes::Aes128 second(std::move(first));
+    second.encrypt_block(block);
+    assert(block == expected);
+
+    // The moved-from context keeps nothing of the key: it runs on a zero schedule
+    block.fill(0);
+    expected.fill(0);
+    aes(expected.data(), zero, 16, true);
+    first.encrypt_block(block);
+    assert(block == expected);
+
+    first = std::move(second);
+    block.fill(0);
+    first.encrypt_block(block);
+    std::array<uint8_t, 16> keyed{};
+    aes(keyed.data(), ekey, 16, true);
+    assert(block == keyed);
+
+    puts("cpp_move passed!");
+}
+
+void test_all_aes_cpp() {
+    test_cpp_tables();
+    test_cpp_blocks();
+    test_cpp_modes();
+    test_cpp_move();
+    puts("All aes_cpp tests passed!");
+}
@@ -0,0 +1,201 @@
+#include "../../include/aes_delta_test.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNK 1024
+
+static void write_file(char* path, uint8_t* data, uint64_t len) {
+    FILE* f = fopen(path, "wb");
+    assert(f);
+    assert(fwrite(data, 1, len, f) == len);
+    fclose(f);
+}
+
+static uint8_t* read_file(char* path, uint64_t* len) {
+    *len = 0;
+    return read_vector(path, len, false);
+}
+
+static void delta_key(uint8_t* ekey, uint8_t seed) {
+    uint8_t key[16];
+    for (int i = 0; i < 16; i++)
+        key[i] = (uint8_t)(seed + i);
+    expand_key(key, 16, ekey);
+}
+
+/**
+ * @brief Encrypt plain into the container and check that exactly
+ *        expected_changed chunks were rewritten and that it decrypts back.
+ */
+static void update(char* in_file, char* container, char* out_file, uint8_t* ekey, uint8_t* plain,
+        uint64_t len, uint64_t expected_changed) {
+    Aes_delta_stats stats;
+    write_file(in_file, plain, len);
+    assert(aes_delta_encrypt(in_file, container, ekey, 16, CHUNK, &stats) == 0);
+    assert(stats.num_chunks == (len + CHUNK - 1) / CHUNK);
+    assert(stats.changed == expected_changed);
+
+    uint64_t len_out;
+    assert(aes_delta_decrypt(container, out_file, ekey, 16) == 0);
+    uint8_t* out = read_file(out_file, &len_out);
+    assert(len_out == len && !memcmp(out, plain, len));
+    free(out);
+}
+
+void test_delta_update() {
+    char in_file[] = "/tmp/aes_delta_in_XXXXXX";
+    char container[] = "/tmp/aes_delta_enc_XXXXXX";
+    char out_file[] = "/tmp/aes_delta_out_XXXXXX";
+    close(mkstemp(in_file));
+    close(mkstemp(container));
+    close(mkstemp(out_file));
+
+    uint8_t ekey[240];
+    delta_key(ekey, 0x10);
+    uint64_t len = 8*CHUNK + 100;
+    uint8_t* plain = malloc(len);
+    for (uint64_t i = 0; i < len; i++)
+        plain[i] = (uint8_t)(i * 31 + (i >> 8));
+
+    // A new container encrypts everything, an unchanged file nothing
+    update(in_file, container, out_file, ekey, plain, len, 9);
+    uint64_t len_before, len_after;
+    uint8_t* before = read_file(container, &len_before);
+    update(in_file, container, out_file, ekey, plain, len, 0);
+    uint8_t* after = read_file(container, &len_after);
+    assert(len_before == len_after && !memcmp(before, after, len_before));
+    free(after);
+
+    // Two edited chunks are rewritten under new nonces; the rest stay byte for byte
+    plain[2*CHUNK + 5] ^= 1;
+    plain[8*CHUNK + 99] ^= 1;
+    update(in_file, container, out_file, ekey, plain, len, 2);
+    after = read_file(container, &len_after);
+    assert(len_after == len_before);
+    uint64_t table = AES_DELTA_DATA_OFFSET + 9*CHUNK;
+    for (uint64_t c = 0; c < 9; c++) {
+        bool edited = c == 2 || c == 8;
+        uint64_t chunk = AES_DELTA_DATA_OFFSET + c*CHUNK;
+        assert(!memcmp(before + chunk, after + chunk, c == 8 ? 100 : CHUNK) == !edited);
+        assert(!memcmp(before + table + c*AES_DELTA_ENTRY, after + table + c*AES_DELTA_ENTRY,
+                16) == !edited);
+    }
+
+    // Reverting an edit does not bring back the old nonce
+    plain[2*CHUNK + 5] ^= 1;
+    update(in_file, container, out_file, ekey, plain, len, 1);
+    uint8_t* reverted = read_file(container, &len_after);
+    assert(memcmp(reverted + table + 2*AES_DELTA_ENTRY, before + table + 2*AES_DELTA_ENTRY, 16));
+    assert(memcmp(reverted + table + 2*AES_DELTA_ENTRY, after + table + 2*AES_DELTA_ENTRY, 16));
+
+    free(before);
+    free(after);
+    free(reverted);
+    free(plain);
+    unlink(in_file);
+    unlink(container);
+    unlink(out_file);
+    puts("delta_update passed!");
+}
+
+void test_delta_resize() {
+    char in_file[] = "/tmp/aes_delta_in_XXXXXX";
+    char container[] = "/tmp/aes_delta_enc_XXXXXX";
+    char out_file[] = "/tmp/aes_delta_out_XXXXXX";
+    close(mkstemp(in_file));
+    close(mkstemp(container));
+    close(mkstemp(out_file));
+
+    uint8_t ekey[240];
+    delta_key(ekey, 0x20);
+    uint8_t* plain = malloc(12*CHUNK);
+    for (uint64_t i = 0; i < 12*CHUNK; i++)
+        plain[i] = (uint8_t)(i * 7);
+
+    // Growing rewrites the old short chunk and adds the new ones
+    update(in_file, container, out_file, ekey, plain, 5*CHUNK + 10, 6);
+    update(in_file, container, out_file, ekey, plain, 9*CHUNK + 1, 5);
+
+    // Shrinking to a chunk boundary rewrites nothing, into a chunk only that one
+    update(in_file, container, out_file, ekey, plain, 7*CHUNK, 0);
+    update(in_file, container, out_file, ekey, plain, 3*CHUNK + 500, 1);
+    struct stat st;
+    assert(stat(container, &st) == 0);
+    assert((uint64_t)st.st_size == AES_DELTA_DATA_OFFSET + 4*CHUNK + 4*AES_DELTA_ENTRY);
+
+    update(in_file, container, out_file, ekey, plain, 0, 0);
+
+    free(plain);
+    unlink(in_file);
+    unlink(container);
+    unlink(out_file);
+    puts("delta_resize passed!");
+}
+
+void test_delta_rejects() {
+    char in_file[] = "/tmp/aes_delta_in_XXXXXX";
+    char container[] = "/tmp/aes_delta_enc_XXXXXX";
+    char out_file[] = "/tmp/aes_delta_out_XXXXXX";
+    close(mkstemp(in_file));
+    close(mkstemp(container));
+    close(mkstemp(out_file));
+
+    uint8_t ekey[240], other[240];
+    delta_key(ekey, 0x30);
+    delta_key(other, 0x40);
+    uint8_t plain[3*CHUNK];
+    memset(plain, 0xab, sizeof(plain));
+    Aes_delta_stats stats;
+
+    // Neither an existing plain file nor a bad chunk size is accepted
+    write_file(container, plain, 100);
+    write_file(in_file, plain, sizeof(plain));
+    assert(aes_delta_encrypt(in_file, container, ekey, 16, CHUNK, &stats) == -1);
+    assert(aes_delta_decrypt(container, out_file, ekey, 16) == -1);
+    truncate(container, 0);
+    assert(aes_delta_encrypt(in_file, container, ekey, 16, 1000, &stats) == -1);
+
+    update(in_file, container, out_file, ekey, plain, sizeof(plain), 3);
+
+    // Another key cannot decrypt, and rewrites the whole container
+    assert(aes_delta_decrypt(container, out_file, other, 16) == -1);
+    assert(aes_delta_encrypt(in_file, container, other, 16, CHUNK, &stats) == 0);
+    assert(stats.changed == 3);
+    update(in_file, container, out_file, ekey, plain, sizeof(plain), 3);
+
+    // A container from an older version is refused, then rewritten in full
+    FILE* f = fopen(container, "r+b");
+    fseek(f, 8, SEEK_SET);
+    fputc(1, f);
+    fclose(f);
+    assert(aes_delta_decrypt(container, out_file, ekey, 16) == -1);
+    update(in_file, container, out_file, ekey, plain, sizeof(plain), 3);
+
+    // A corrupt chunk is caught by its digest
+    f = fopen(container, "r+b");
+    fseek(f, AES_DELTA_DATA_OFFSET + CHUNK + 17, SEEK_SET);
+    fputc(0, f);
+    fclose(f);
+    assert(aes_delta_decrypt(container, out_file, ekey, 16) == -1);
+
+    // An interrupted update is refused, then repaired in full
+    f = fopen(container, "r+b");
+    fseek(f, 12, SEEK_SET);
+    fputc(AES_DELTA_DIRTY, f);
+    fclose(f);
+    assert(aes_delta_decrypt(container, out_file, ekey, 16) == -1);
+    update(in_file, container, out_file, ekey, plain, sizeof(plain), 3);
+
+    unlink(in_file);
+    unlink(container);
+    unlink(out_file);
+    puts("delta_rejects passed!");
+}
+
+void test_all_aes_delta() {
+    test_delta_update();
+    test_delta_resize();
+    test_delta_rejects();
+    puts("All aes_delta tests passed!");
+}
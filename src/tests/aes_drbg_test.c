@@ -0,0 +1,143 @@
+#include "../../include/aes_drbg_test.h"
+#include "../../include/hex.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void check_hex(const uint8_t* out, uint64_t len, const char* hex) {
+    uint8_t expected[128];
+    assert(hex_decode(hex, strlen(hex), expected) == (int64_t)len);
+    assert(!memcmp(out, expected, len));
+}
+
+void test_drbg_known_answer() {
+    // Instantiate with personalization, generate with and without additional
+    // input, reseed, generate again; checked against an independent model of
+    // SP 800-90A 10.2.1 over a reference AES
+    uint8_t entropy[48], personal[32], additional[48], reseed[48], small[5];
+    for (int i = 0; i < 48; i++) {
+        entropy[i] = (uint8_t)i;
+        additional[i] = (uint8_t)(0x40 + i);
+        reseed[i] = (uint8_t)(0xA0 + i);
+    }
+    for (int i = 0; i < 32; i++)
+        personal[i] = (uint8_t)(0x80 + i);
+    memset(small, 0x11, 5);
+
+    Aes_drbg drbg;
+    uint8_t out[80];
+    assert(aes_drbg_instantiate(&drbg, entropy, personal, 32) == 0);
+
+    assert(aes_drbg_generate(&drbg, out, 64, NULL, 0) == 0);
+    check_hex(out, 64, "0d20f010696107f750dc860a1fb8a926d2b3df4209daf3c8d206554b757ab603"
+            "b1d5f200ecde6748b78ff38f1060bbcde60e95db36ec0f6107a8b99256ad4221");
+
+    assert(aes_drbg_generate(&drbg, out, 37, additional, 48) == 0);
+    check_hex(out, 37, "7c59d88e6c2cc72ec3ebf4c2bf6151622faa9c40b5bdfa68bd7f78858925ff92"
+            "f12d7ddbab");
+
+    assert(aes_drbg_reseed(&drbg, reseed, small, 5) == 0);
+    assert(aes_drbg_generate(&drbg, out, 80, NULL, 0) == 0);
+    check_hex(out, 80, "98a0e7f2e38a87574f10e82d98a166014d5671a0d3cbdbb66e92fe2b672f7ec5"
+            "4d044b4cea4093654d029b2fc508fae8fa104d556db869d2b12d5a2c721308855b960f576bbfb63c"
+            "149535c83289de7b");
+
+    aes_drbg_uninstantiate(&drbg);
+    puts("drbg_known_answer passed!");
+}
+
+void test_drbg_limits() {
+    uint8_t entropy[48] = {0}, long_input[49] = {0};
+    uint8_t* out = malloc(AES_DRBG_MAX_REQUEST + 1);
+    Aes_drbg drbg;
+
+    assert(aes_drbg_instantiate(&drbg, entropy, long_input, 49) == -1);
+    assert(aes_drbg_instantiate(&drbg, entropy, NULL, 0) == 0);
+    assert(aes_drbg_generate(&drbg, out, AES_DRBG_MAX_REQUEST + 1, NULL, 0) == -1);
+    assert(aes_drbg_generate(&drbg, out, AES_DRBG_MAX_REQUEST, NULL, 0) == 0);
+    assert(aes_drbg_generate(&drbg, out, 16, long_input, 49) == -1);
+    assert(aes_drbg_reseed(&drbg, entropy, long_input, 49) == -1);
+
+    // Past the reseed interval nothing more is generated until a reseed
+    drbg.reseed_counter = AES_DRBG_RESEED_INTERVAL + 1;
+    assert(aes_drbg_generate(&drbg, out, 16, NULL, 0) == AES_DRBG_RESEED);
+    assert(aes_drbg_reseed(&drbg, entropy, NULL, 0) == 0);
+    assert(aes_drbg_generate(&drbg, out, 16, NULL, 0) == 0);
+
+    free(out);
+    puts("drbg_limits passed!");
+}
+
+void test_random_bytes() {
+    // Small requests come from the batch, large ones are generated directly;
+    // neither repeats
+    uint8_t ivs[300][16];
+    for (int i = 0; i < 300; i++)
+        assert(aes_random_iv(ivs[i]) == 0);
+    for (int i = 0; i < 300; i++)
+        for (int j = i + 1; j < 300; j++)
+            assert(memcmp(ivs[i], ivs[j], 16));
+
+    uint64_t len = 3*AES_DRBG_MAX_REQUEST + 5;
+    uint8_t* big = calloc(len, 1);
+    assert(aes_random_bytes(big, len) == 0);
+    int zeros = 0;
+    for (uint64_t i = 0; i < len; i++)
+        zeros += big[i] == 0;
+    assert(zeros < (int)(len / 128));
+    free(big);
+
+    puts("random_bytes passed!");
+}
+
+static void* random_thread(void* arg) {
+    assert(aes_random_bytes(arg, 32) == 0);
+    return NULL;
+}
+
+void test_random_threads() {
+    uint8_t out[4][32];
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++)
+        pthread_create(&threads[t], NULL, random_thread, out[t]);
+    for (int t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+    for (int i = 0; i < 4; i++)
+        for (int j = i + 1; j < 4; j++)
+            assert(memcmp(out[i], out[j], 32));
+    puts("random_threads passed!");
+}
+
+void test_random_fork() {
+    // A forked child must not replay the parent's batch or state
+    uint8_t warm[16], parent[16], child[16];
+    int fds[2];
+    assert(aes_random_iv(warm) == 0);
+    assert(pipe(fds) == 0);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        aes_random_iv(child);
+        _exit(write(fds[1], child, 16) == 16 ? 0 : 1);
+    }
+    assert(aes_random_iv(parent) == 0);
+    assert(read(fds[0], child, 16) == 16);
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(memcmp(parent, child, 16));
+    close(fds[0]);
+    close(fds[1]);
+
+    puts("random_fork passed!");
+}
+
+void test_all_aes_drbg() {
+    test_drbg_known_answer();
+    test_drbg_limits();
+    test_random_bytes();
+    test_random_threads();
+    test_random_fork();
+    puts("All aes_drbg tests passed!");
+}
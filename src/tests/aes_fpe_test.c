@@ -0,0 +1,181 @@
+#include "../../include/aes_fpe_test.h"
+#include "../../include/hex.h"
+
+static void check_fpe(Fpe_type type, const char* key_hex, uint32_t radix, const char* tweak_hex,
+        const char* plain, const char* cipher) {
+    uint8_t key[32], tweak[32], ekey[240];
+    int len_key = (int)strlen(key_hex) / 2;
+    int len_tweak = (int)strlen(tweak_hex) / 2;
+    assert(hex_decode(key_hex, strlen(key_hex), key) == len_key);
+    assert(hex_decode(tweak_hex, strlen(tweak_hex), tweak) == len_tweak);
+    if (type == FF1)
+        expand_key(key, len_key, ekey);
+    else
+        ff3_expand_key(key, len_key, ekey);
+
+    uint16_t in[FPE_MAX_LEN], out[FPE_MAX_LEN];
+    char s[FPE_MAX_LEN + 1];
+    int len = fpe_from_string(plain, in, radix);
+    assert(len == (int)strlen(plain));
+
+    int (*fpe)(const uint16_t*, uint16_t*, int, uint32_t, const uint8_t*, int, uint8_t*, int,
+            bool) = type == FF1 ? aes_ff1 : aes_ff3_1;
+    assert(fpe(in, out, len, radix, tweak, len_tweak, ekey, len_key, true) == 0);
+    fpe_to_string(out, len, s);
+    assert(!strcmp(s, cipher));
+
+    // In place
+    assert(fpe(out, out, len, radix, tweak, len_tweak, ekey, len_key, false) == 0);
+    fpe_to_string(out, len, s);
+    assert(!strcmp(s, plain));
+}
+
+void test_ff1_vectors() {
+    // NIST SP 800-38G FF1 samples
+    const char* k128 = "2B7E151628AED2A6ABF7158809CF4F3C";
+    const char* k192 = "2B7E151628AED2A6ABF7158809CF4F3CEF4359D8D580AA4F";
+    const char* k256 = "2B7E151628AED2A6ABF7158809CF4F3CEF4359D8D580AA4F7F036D6F04FC6A94";
+
+    check_fpe(FF1, k128, 10, "", "0123456789", "2433477484");
+    check_fpe(FF1, k128, 10, "39383736353433323130", "0123456789", "6124200773");
+    check_fpe(FF1, k128, 36, "3737373770717273373737", "0123456789abcdefghi",
+            "a9tv40mll9kdu509eum");
+    check_fpe(FF1, k192, 10, "", "0123456789", "2830668132");
+    check_fpe(FF1, k256, 10, "", "0123456789", "6657667009");
+    check_fpe(FF1, k256, 36, "3737373770717273373737", "0123456789abcdefghi",
+            "xs8a0azh2avyalyzuwd");
+
+    puts("ff1_vectors passed!");
+}
+
+void test_ff3_1_vectors() {
+    const char* key = "EF4359D8D580AA4F7F036D6F04FC6A94";
+
+    // Original FF3 samples, with the 64-bit tweak
+    check_fpe(FF3_1, key, 10, "D8E7920AFA330A73", "890121234567890000", "750918814058654607");
+    check_fpe(FF3_1, key, 10, "9A768A92F60E12D8", "890121234567890000", "018989839189395384");
+
+    // FF3-1, with the 56-bit tweak
+    check_fpe(FF3_1, key, 10, "D8E7920AFA330A", "890121234567890000", "477064185124354662");
+    check_fpe(FF3_1, key, 10, "D8E7920AFA330A", "0123456789", "2170132340");
+    check_fpe(FF3_1, key, 36, "D8E7920AFA330A", "0123456789abcdefghi", "e5z9mdn80vub9u6p52f");
+    check_fpe(FF3_1, "2DE79D232DF5585D68CE47882AE256D6", 10, "CBD09280979564", "3992520240",
+            "8901801106");
+
+    puts("ff3_1_vectors passed!");
+}
+
+void test_fpe_large_radix() {
+    // A 100-numeral value in radix 65536 needs more than one stretching block per round
+    uint8_t key[16], ekey[176];
+    uint8_t tweak[5] = { 0x00, 0x11, 0x22, 0x33, 0x44 };
+    assert(hex_decode("2B7E151628AED2A6ABF7158809CF4F3C", 32, key) == 16);
+    expand_key(key, 16, ekey);
+
+    uint16_t in[100], out[100], back[100];
+    for (int i = 0; i < 100; i++)
+        in[i] = (uint16_t)((i * 7919) % 65536);
+    assert(aes_ff1(in, out, 100, 65536, tweak, 5, ekey, 16, true) == 0);
+
+    uint16_t head[5] = { 22006, 58318, 15438, 2847, 19221 };
+    uint16_t tail[5] = { 45574, 19170, 19625, 12992, 8533 };
+    assert(!memcmp(out, head, sizeof(head)));
+    assert(!memcmp(out + 95, tail, sizeof(tail)));
+
+    assert(aes_ff1(out, back, 100, 65536, tweak, 5, ekey, 16, false) == 0);
+    assert(!memcmp(back, in, sizeof(in)));
+
+    puts("fpe_large_radix passed!");
+}
+
+void test_fpe_batch() {
+    // Values of mixed lengths and tweaks, more than fit in the lanes at once
+    uint8_t key[16], ekey[176], ekey3[176];
+    for (int i = 0; i < 16; i++)
+        key[i] = (uint8_t)(i * 17 + 3);
+    expand_key(key, 16, ekey);
+    ff3_expand_key(key, 16, ekey3);
+
+    enum { N = 21 };
+    uint16_t in[N][40], out[N][40], single[40];
+    uint8_t tweaks[N][8];
+    Fpe_item items[N];
+
+    for (int type = FF1; type <= FF3_1; type++) {
+        uint8_t* k = type == FF1 ? ekey : ekey3;
+        for (int n = 0; n < N; n++) {
+            int len = 6 + (n * 5) % 33;
+            for (int i = 0; i < len; i++)
+                in[n][i] = (uint16_t)((n * 31 + i * 7) % 10);
+            for (int i = 0; i < 8; i++)
+                tweaks[n][i] = (uint8_t)(n + i);
+            Fpe_item item = { in[n], out[n], len, tweaks[n], type == FF1 ? n % 9 : 7, 99 };
+            items[n] = item;
+        }
+        // One value that is too short to encrypt does not disturb the rest
+        items[4].len = 3;
+
+        aes_fpe_batch(type, items, N, 10, k, 16, true);
+
+        for (int n = 0; n < N; n++) {
+            if (n == 4) {
+                assert(items[n].result == FPE_ERR_LENGTH);
+                continue;
+            }
+            assert(items[n].result == 0);
+            int result = type == FF1
+                    ? aes_ff1(in[n], single, items[n].len, 10, tweaks[n], items[n].len_tweak, k,
+                            16, true)
+                    : aes_ff3_1(in[n], single, items[n].len, 10, tweaks[n], items[n].len_tweak,
+                            k, 16, true);
+            assert(result == 0);
+            assert(!memcmp(single, out[n], items[n].len * sizeof(uint16_t)));
+        }
+
+        // Decrypt the batch in place
+        for (int n = 0; n < N; n++)
+            items[n].in = out[n];
+        aes_fpe_batch(type, items, N, 10, k, 16, false);
+        for (int n = 0; n < N; n++)
+            if (n != 4)
+                assert(!memcmp(out[n], in[n], items[n].len * sizeof(uint16_t)));
+    }
+
+    puts("fpe_batch passed!");
+}
+
+void test_fpe_errors() {
+    uint8_t key[16] = {0}, ekey[176], tweak[8] = {0};
+    uint16_t x[FPE_MAX_LEN + 1] = {0}, out[FPE_MAX_LEN + 1];
+    expand_key(key, 16, ekey);
+
+    // radix^len must reach one million
+    assert(aes_ff1(x, out, 5, 10, tweak, 0, ekey, 16, true) == FPE_ERR_LENGTH);
+    assert(aes_ff1(x, out, 6, 10, tweak, 0, ekey, 16, true) == 0);
+    assert(aes_ff1(x, out, 19, 2, tweak, 0, ekey, 16, true) == FPE_ERR_LENGTH);
+    assert(aes_ff1(x, out, FPE_MAX_LEN + 1, 10, tweak, 0, ekey, 16, true) == FPE_ERR_LENGTH);
+
+    // FF3-1 caps the length at 2·floor(log_radix(2^96)), 56 numerals for radix 10
+    assert(aes_ff3_1(x, out, 56, 10, tweak, 7, ekey, 16, true) == 0);
+    assert(aes_ff3_1(x, out, 57, 10, tweak, 7, ekey, 16, true) == FPE_ERR_LENGTH);
+    assert(aes_ff3_1(x, out, 10, 10, tweak, 6, ekey, 16, true) == FPE_ERR_TWEAK);
+    assert(aes_ff1(x, out, 10, 10, tweak, -1, ekey, 16, true) == FPE_ERR_TWEAK);
+
+    // Numerals must be below the radix
+    x[3] = 10;
+    assert(aes_ff1(x, out, 10, 10, tweak, 0, ekey, 16, true) == FPE_ERR_NUMERAL);
+    assert(aes_ff1(x, out, 10, 1, tweak, 0, ekey, 16, true) == FPE_ERR_NUMERAL);
+    assert(fpe_from_string("12a", x, 10) == -1);
+    assert(fpe_from_string("12A", x, 16) == 3 && x[2] == 10);
+
+    puts("fpe_errors passed!");
+}
+
+void test_all_aes_fpe() {
+    test_ff1_vectors();
+    test_ff3_1_vectors();
+    test_fpe_large_radix();
+    test_fpe_batch();
+    test_fpe_errors();
+    puts("All aes_fpe tests passed!");
+}
@@ -0,0 +1,145 @@
+#include "../../include/aes_hash_test.h"
+
+static void fill(uint8_t* buf, uint64_t len, int seed) {
+    for (uint64_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 73 + seed + (i >> 9));
+}
+
+void test_hash_paths_agree() {
+    // The AES-NI and table rounds must give the same digest for every length
+    uint8_t msg[300], key[16], a[16], b[16];
+    fill(msg, sizeof(msg), 1);
+    fill(key, 16, 2);
+
+    bool have_aesni = aes_hash_use_aesni(true);
+    for (uint64_t len = 0; len <= sizeof(msg); len += 13) {
+        aes_hash_use_aesni(true);
+        aes_hash(msg, len, key, a);
+        aes_hash_use_aesni(false);
+        aes_hash(msg, len, key, b);
+        assert(!memcmp(a, b, 16));
+    }
+    aes_hash_use_aesni(true);
+
+    if (!have_aesni)
+        puts("AES-NI not available, checked the table rounds only");
+    puts("hash_paths_agree passed!");
+}
+
+void test_hash_incremental() {
+    uint8_t msg[1000], whole[16], pieces[16];
+    fill(msg, sizeof(msg), 3);
+    aes_hash(msg, sizeof(msg), NULL, whole);
+
+    // Splits that start, end and straddle stripes
+    uint64_t splits[6] = { 1, 63, 64, 65, 200, 607 };
+    for (int s = 0; s < 6; s++) {
+        Aes_hash_ctx ctx;
+        aes_hash_init(&ctx, NULL);
+        uint64_t off = 0;
+        for (uint64_t n = splits[s]; off < sizeof(msg); off += n) {
+            if (n > sizeof(msg) - off)
+                n = sizeof(msg) - off;
+            aes_hash_update(&ctx, msg + off, n);
+        }
+        aes_hash_final(&ctx, pieces);
+        assert(!memcmp(whole, pieces, 16));
+    }
+
+    puts("hash_incremental passed!");
+}
+
+void test_hash_sensitivity() {
+    enum { LEN = 130 };
+    uint8_t msg[LEN + 1], digests[LEN*8 + 1][16];
+    fill(msg, LEN, 4);
+    aes_hash(msg, LEN, NULL, digests[LEN*8]);
+
+    // Every single-bit flip gives a different digest from all the others
+    for (int bit = 0; bit < LEN*8; bit++) {
+        msg[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        aes_hash(msg, LEN, NULL, digests[bit]);
+        msg[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    }
+    for (int i = 0; i <= LEN*8; i++)
+        for (int j = i + 1; j <= LEN*8; j++)
+            assert(memcmp(digests[i], digests[j], 16));
+
+    // Trailing zeros are not padding
+    uint8_t zeros[65] = {0}, a[16], b[16];
+    for (int len = 0; len < 65; len++) {
+        aes_hash(zeros, len, NULL, a);
+        aes_hash(zeros, len + 1, NULL, b);
+        assert(memcmp(a, b, 16));
+    }
+
+    puts("hash_sensitivity passed!");
+}
+
+void test_hash_keyed() {
+    uint8_t msg[100], key1[16] = {0}, key2[16] = {0}, a[16], b[16], c[16];
+    fill(msg, sizeof(msg), 5);
+    key2[15] = 1;
+
+    aes_hash(msg, sizeof(msg), NULL, a);
+    aes_hash(msg, sizeof(msg), key1, b);
+    aes_hash(msg, sizeof(msg), key2, c);
+    assert(memcmp(b, c, 16));
+
+    // An all-zero key is the unkeyed hash
+    assert(!memcmp(a, b, 16));
+
+    aes_hash(msg, sizeof(msg), key2, a);
+    assert(!memcmp(a, c, 16));
+
+    puts("hash_keyed passed!");
+}
+
+void test_mode_hash() {
+    Op_mode modes[5] = {ECB, CBC, CFB, OFB, CTR};
+    uint64_t len = 3*4096 + 48;
+    uint8_t* data = malloc(len);
+    uint8_t* expected = malloc(len);
+    uint8_t key[16], ekey[176], iv[16], iv_expected[16], plain_digest[16];
+    fill(key, 16, 6);
+    expand_key(key, 16, ekey);
+
+    for (int m = 0; m < 5; m++) {
+        fill(data, len, m);
+        memcpy(expected, data, len);
+        aes_hash(data, len, NULL, plain_digest);
+
+        // Encrypting hashes the input
+        Aes_hash_ctx ctx;
+        uint8_t digest[16];
+        memset(iv, 0xAB, 16);
+        memset(iv_expected, 0xAB, 16);
+        aes_hash_init(&ctx, NULL);
+        aes_mode_hash(&ctx, modes[m], data, len, ekey, 16, iv, true);
+        aes_hash_final(&ctx, digest);
+        aes_mode(modes[m], expected, len, ekey, 16, iv_expected, true);
+        assert(!memcmp(data, expected, len));
+        assert(!memcmp(iv, iv_expected, 16));
+        assert(!memcmp(digest, plain_digest, 16));
+
+        // Decrypting hashes the output, so the digest matches
+        memset(iv, 0xAB, 16);
+        aes_hash_init(&ctx, NULL);
+        aes_mode_hash(&ctx, modes[m], data, len, ekey, 16, iv, false);
+        aes_hash_final(&ctx, digest);
+        assert(!memcmp(digest, plain_digest, 16));
+    }
+
+    free(data);
+    free(expected);
+    puts("mode_hash passed!");
+}
+
+void test_all_aes_hash() {
+    test_hash_paths_agree();
+    test_hash_incremental();
+    test_hash_sensitivity();
+    test_hash_keyed();
+    test_mode_hash();
+    puts("All aes_hash tests passed!");
+}
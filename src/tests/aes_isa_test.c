@@ -0,0 +1,145 @@
+#include "../../include/aes_isa_test.h"
+
+#define ISA_TEST_BLOCKS 37
+#define ISA_TEST_LEN (ISA_TEST_BLOCKS*16 + 40)    // Ends in a short group of eight blocks
+
+static void fill(uint8_t* buf, uint64_t len, int seed) {
+    for (uint64_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 89 + seed + (i >> 7));
+}
+
+/*
+ * Everything the kernels compute for one key size, so the tiers can be
+ * compared output for output.
+ */
+typedef struct isa_outputs {
+    uint8_t block[2][16];
+    uint8_t blocks[2][ISA_TEST_BLOCKS*16];
+    uint8_t blocks_keys[2][ISA_TEST_BLOCKS*16];
+    uint8_t ctr[2][ISA_TEST_LEN];
+    uint8_t ctr_iv[2][16];
+    uint8_t cbc[ISA_TEST_BLOCKS*16];
+    uint8_t cbc_iv[16];
+} Isa_outputs;
+
+static void run_kernels(int len_key, Isa_outputs* out) {
+    uint8_t key[3][32], ekey[3][240];
+    uint8_t* block_keys[ISA_TEST_BLOCKS];
+    for (int k = 0; k < 3; k++) {
+        fill(key[k], 32, k);
+        expand_key(key[k], len_key, ekey[k]);
+    }
+    for (int b = 0; b < ISA_TEST_BLOCKS; b++)
+        block_keys[b] = ekey[(b * 2) % 3];
+
+    for (int is_encrypt = 0; is_encrypt < 2; is_encrypt++) {
+        fill(out->block[is_encrypt], 16, 7);
+        aes(out->block[is_encrypt], ekey[0], len_key, is_encrypt);
+        fill(out->blocks[is_encrypt], ISA_TEST_BLOCKS*16, 8);
+        aes_blocks(out->blocks[is_encrypt], ISA_TEST_BLOCKS, ekey[0], len_key, is_encrypt);
+        fill(out->blocks_keys[is_encrypt], ISA_TEST_BLOCKS*16, 9);
+        aes_blocks_keys(out->blocks_keys[is_encrypt], ISA_TEST_BLOCKS, block_keys, len_key, is_encrypt);
+    }
+
+    // The second counter's low half wraps partway through the message
+    fill(out->ctr_iv[0], 16, 11);
+    memset(out->ctr_iv[1], 0xFF, 16);
+    out->ctr_iv[1][0] = 0x12;
+    out->ctr_iv[1][15] = 0xF0;
+    for (int c = 0; c < 2; c++) {
+        fill(out->ctr[c], ISA_TEST_LEN, 10);
+        aes_ctr(out->ctr[c], ISA_TEST_LEN, ekey[1], len_key, out->ctr_iv[c]);
+    }
+
+    fill(out->cbc_iv, 16, 12);
+    fill(out->cbc, ISA_TEST_BLOCKS*16, 13);
+    aes_cbc(out->cbc, ISA_TEST_BLOCKS*16, ekey[2], len_key, out->cbc_iv, false);
+}
+
+void test_isa_names() {
+    for (int i = AES_ISA_BASELINE; i <= AES_ISA_AVX512; i++)
+        assert(aes_isa_parse(aes_isa_name((Aes_isa)i)) == i);
+    assert(aes_isa_parse("sse9") == -1);
+
+    // Asking for more than the CPU has binds the best it does have
+    Aes_isa best = aes_isa_detect();
+    assert(aes_isa_select(AES_ISA_AVX512) == best);
+    assert(aes_isa_current() == best);
+    assert(aes_isa_select(AES_ISA_BASELINE) == AES_ISA_BASELINE);
+    assert(aes_kernels.block == aes_table && !strcmp(aes_kernels.name, "table"));
+    aes_isa_select(best);
+
+    puts("isa_names passed!");
+}
+
+void test_isa_kernels_agree() {
+    static Isa_outputs expected, got;
+    int key_lens[3] = { 16, 24, 32 };
+    Aes_isa best = aes_isa_detect();
+
+    for (int k = 0; k < 3; k++) {
+        aes_isa_select(AES_ISA_BASELINE);
+        run_kernels(key_lens[k], &expected);
+
+        for (int isa = AES_ISA_SSSE3; isa <= (int)best; isa++) {
+            assert(aes_isa_select((Aes_isa)isa) == (Aes_isa)isa);
+            memset(&got, 0, sizeof(got));
+            run_kernels(key_lens[k], &got);
+            assert(!memcmp(&got, &expected, sizeof(got)));
+        }
+    }
+    aes_isa_select(best);
+
+    if (best == AES_ISA_BASELINE)
+        puts("No AES-NI, checked the table kernels only");
+    else
+        printf("Checked kernels up to %s\n", aes_kernels.name);
+    puts("isa_kernels_agree passed!");
+}
+
+void test_isa_hex_agree() {
+    enum { DIGITS = 300 };
+    char text[DIGITS + 1];
+    uint8_t expected[DIGITS/2 + 1], got[DIGITS/2 + 1];
+    const char* digits = "0123456789abcdefABCDEF";
+    for (int i = 0; i < DIGITS; i++)
+        text[i] = digits[(i * 7) % 22];
+    Aes_isa best = aes_isa_detect();
+
+    // Whitespace at each position interrupts the wide runs differently
+    for (int ws = 0; ws <= DIGITS; ws += 11) {
+        char spaced[DIGITS + 2];
+        memcpy(spaced, text, ws);
+        spaced[ws] = '\n';
+        memcpy(spaced + ws + 1, text + ws, DIGITS - ws);
+
+        aes_isa_select(AES_ISA_BASELINE);
+        int64_t n = hex_decode(spaced, DIGITS + 1, expected);
+        assert(n == DIGITS/2);
+        for (int isa = AES_ISA_SSSE3; isa <= (int)best; isa++) {
+            aes_isa_select((Aes_isa)isa);
+            assert(hex_decode(spaced, DIGITS + 1, got) == n);
+            assert(!memcmp(got, expected, n));
+        }
+    }
+
+    // A bad character inside a wide run is still found and placed
+    text[150] = 'g';
+    for (int isa = AES_ISA_BASELINE; isa <= (int)best; isa++) {
+        Hex_decoder d;
+        aes_isa_select((Aes_isa)isa);
+        hex_decoder_init(&d);
+        assert(hex_decode_update(&d, text, DIGITS, got) == HEX_ERR_CHAR);
+        assert(d.position == 150 && d.bad_char == 'g');
+    }
+    aes_isa_select(best);
+
+    puts("isa_hex_agree passed!");
+}
+
+void test_all_aes_isa() {
+    test_isa_names();
+    test_isa_kernels_agree();
+    test_isa_hex_agree();
+    puts("All aes_isa tests passed!");
+}
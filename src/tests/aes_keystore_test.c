@@ -0,0 +1,128 @@
+#include "../../include/aes_keystore_test.h"
+
+void test_aes_compact() {
+    // FIPS-197 Appendix C: plaintext 00112233...ff under keys 000102...
+    uint8_t plain[16];
+    uint8_t key[32];
+    for (int i = 0; i < 16; i++)
+        plain[i] = (uint8_t)(i * 0x11);
+    for (int i = 0; i < 32; i++)
+        key[i] = (uint8_t)i;
+
+    uint8_t expected[3][16] = {
+        { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+          0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a },
+        { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+          0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 },
+        { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+          0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 }
+    };
+    int len_keys[3] = { 16, 24, 32 };
+
+    for (int k = 0; k < 3; k++) {
+        uint8_t state[16];
+        memcpy(state, plain, 16);
+        aes_compact(state, key, len_keys[k], true);
+        assert(!memcmp(state, expected[k], 16));
+        aes_compact(state, key, len_keys[k], false);
+        assert(!memcmp(state, plain, 16));
+    }
+
+    puts("aes_compact passed!");
+}
+
+void test_keystore_matches_expanded() {
+    Aes_keystore ks;
+    assert(aes_keystore_init(&ks, 2, 4) == 0);
+    assert(aes_keystore_add(&ks, (uint8_t*)"short", 5) == -1);
+
+    // More keys than the initial capacity, of every length
+    uint8_t keys[12][32];
+    int64_t ids[12];
+    for (int k = 0; k < 12; k++) {
+        for (int i = 0; i < 32; i++)
+            keys[k][i] = (uint8_t)(k * 29 + i * 7);
+        ids[k] = aes_keystore_add(&ks, keys[k], 16 + 8 * (k % 3));
+        assert(ids[k] == k);
+    }
+
+    // Repeated use, so some keys are served from the cache and some are not
+    for (int round = 0; round < 8; round++) {
+        for (int k = 0; k < 12; k++) {
+            int len_key = 16 + 8 * (k % 3);
+            uint8_t ekey[240];
+            expand_key(keys[k], len_key, ekey);
+
+            uint64_t num_blocks = (uint64_t)(round + k) % 7 + 1;
+            uint8_t data[7*16], expected[7*16];
+            for (uint64_t i = 0; i < num_blocks*16; i++)
+                data[i] = expected[i] = (uint8_t)(i + round);
+
+            aes_keystore_ecb(&ks, ids[k], data, num_blocks, true);
+            aes_ecb(expected, num_blocks*16, ekey, len_key, true);
+            assert(!memcmp(data, expected, num_blocks*16));
+            aes_keystore_ecb(&ks, ids[k], data, num_blocks, false);
+            for (uint64_t i = 0; i < num_blocks*16; i++)
+                assert(data[i] == (uint8_t)(i + round));
+
+            uint8_t iv[16] = {0}, expected_iv[16] = {0};
+            memcpy(expected, data, num_blocks*16);
+            aes_keystore_mode(&ks, ids[k], CBC, data, num_blocks*16, iv, true);
+            aes_mode(CBC, expected, num_blocks*16, ekey, len_key, expected_iv, true);
+            assert(!memcmp(data, expected, num_blocks*16));
+            assert(!memcmp(iv, expected_iv, 16));
+        }
+    }
+
+    aes_keystore_free(&ks);
+    puts("keystore_matches_expanded passed!");
+}
+
+void test_keystore_cache() {
+    Aes_keystore ks;
+    uint8_t key[16] = {0};
+    uint8_t block[16] = {0};
+
+    // One cache entry shared by two keys
+    assert(aes_keystore_init(&ks, 0, 1) == 0);
+    int64_t hot = aes_keystore_add(&ks, key, 16);
+    key[0] = 1;
+    int64_t cold = aes_keystore_add(&ks, key, 16);
+
+    // Below the threshold every use is a miss, then the key is admitted
+    for (int i = 0; i < AES_KEYSTORE_HOT_THRESHOLD; i++)
+        aes_keystore_ecb(&ks, hot, block, 1, true);
+    assert(ks.hits == 0);
+    assert(ks.cache[0].id == hot);
+    aes_keystore_ecb(&ks, hot, block, 1, true);
+    assert(ks.hits == 1);
+
+    // A key that is not as hot does not displace it
+    for (int i = 0; i < AES_KEYSTORE_HOT_THRESHOLD; i++)
+        aes_keystore_ecb(&ks, cold, block, 1, true);
+    assert(ks.cache[0].id == hot);
+
+    // Once it is hotter, it does
+    for (int i = 0; i < 4; i++)
+        aes_keystore_ecb(&ks, cold, block, 1, true);
+    assert(ks.cache[0].id == cold);
+
+    aes_keystore_free(&ks);
+
+    // Without a cache every lookup is a miss
+    assert(aes_keystore_init(&ks, 0, 0) == 0);
+    hot = aes_keystore_add(&ks, key, 16);
+    for (int i = 0; i < 10; i++)
+        aes_keystore_ecb(&ks, hot, block, 1, true);
+    assert(ks.hits == 0 && ks.misses == 10);
+    aes_keystore_free(&ks);
+
+    puts("keystore_cache passed!");
+}
+
+void test_all_aes_keystore() {
+    test_aes_compact();
+    test_keystore_matches_expanded();
+    test_keystore_cache();
+    puts("All aes_keystore tests passed!");
+}
@@ -0,0 +1,94 @@
+#include "../../include/aes_keystream_test.h"
+
+static void fill(uint8_t* data, uint64_t len, uint8_t seed) {
+    for (uint64_t i = 0; i < len; i++)
+        data[i] = (uint8_t)(i * seed + (i >> 5));
+}
+
+/*
+ * Consume the keystream in uneven pieces and compare against the one-shot mode.
+ */
+static void check_keystream(Op_mode op_mode, uint64_t capacity, uint64_t len) {
+    uint8_t key[16];
+    uint8_t ekey[240];
+    uint8_t iv[16];
+    for (int i = 0; i < 16; i++) {
+        key[i] = (uint8_t)(0x2B + i * 5);
+        iv[i] = (uint8_t)(0xFF - i);
+    }
+    expand_key(key, 16, ekey);
+
+    uint8_t* data = malloc(len);
+    uint8_t* expected = malloc(len);
+    fill(data, len, 7);
+    memcpy(expected, data, len);
+
+    Aes_keystream ks;
+    assert(aes_keystream_init(&ks, op_mode, ekey, 16, iv, capacity) == 0);
+    if (op_mode == CTR)
+        aes_ctr(expected, len, ekey, 16, iv);
+    else
+        aes_ofb(expected, len, ekey, 16, iv);
+
+    uint64_t piece = 1;
+    for (uint64_t i = 0; i < len; ) {
+        uint64_t n = len - i < piece ? len - i : piece;
+        aes_keystream_xor(&ks, data + i, n);
+        i += n;
+        piece = piece * 3 % 10007 + 1;
+    }
+    aes_keystream_destroy(&ks);
+
+    assert(!memcmp(data, expected, len));
+    free(data);
+    free(expected);
+}
+
+void test_keystream_matches_modes() {
+    // NIST SP 800-38A F.5.1 CTR-AES128.Encrypt, first block
+    uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    uint8_t iv[16]  = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                        0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+    uint8_t block[16] = { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+                          0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a };
+    uint8_t expected[16] = { 0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+                             0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce };
+    uint8_t ekey[240];
+    expand_key(key, 16, ekey);
+
+    Aes_keystream ks;
+    assert(aes_keystream_init(&ks, CTR, ekey, 16, iv, 0) == 0);
+    aes_keystream_xor(&ks, block, 16);
+    aes_keystream_destroy(&ks);
+    assert(!memcmp(block, expected, 16));
+
+    check_keystream(CTR, 0, 100000);
+    check_keystream(OFB, 0, 100000);
+
+    puts("keystream_matches_modes passed!");
+}
+
+void test_keystream_wraparound() {
+    // A ring of two batches, so the producer keeps blocking on a full ring
+    check_keystream(CTR, 1, 3 * 1024 * 1024 + 5);
+    check_keystream(OFB, 1, 1024 * 1024 + 9);
+
+    puts("keystream_wraparound passed!");
+}
+
+void test_keystream_bad_mode() {
+    uint8_t ekey[240] = {0};
+    uint8_t iv[16] = {0};
+    Aes_keystream ks;
+    assert(aes_keystream_init(&ks, CBC, ekey, 16, iv, 0) == -1);
+
+    puts("keystream_bad_mode passed!");
+}
+
+void test_all_aes_keystream() {
+    test_keystream_matches_modes();
+    test_keystream_wraparound();
+    test_keystream_bad_mode();
+    puts("All aes_keystream tests passed!");
+}
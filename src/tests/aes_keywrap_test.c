@@ -0,0 +1,152 @@
+#include "../../include/aes_keywrap_test.h"
+
+void test_key_wrap() {
+    uint8_t kek[32], ekey[240], out[48], back[40];
+    for (int i = 0; i < 32; i++)
+        kek[i] = (uint8_t)i;
+
+    // RFC 3394 4.1: 128-bit key data with a 128-bit KEK
+    uint8_t data[32] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+    };
+    uint8_t wrapped128[24] = {
+        0x1F, 0xA6, 0x8B, 0x0A, 0x81, 0x12, 0xB4, 0x47, 0xAE, 0xF3, 0x4B, 0xD8,
+        0xFB, 0x5A, 0x7B, 0x82, 0x9D, 0x3E, 0x86, 0x23, 0x71, 0xD2, 0xCF, 0xE5
+    };
+    expand_key(kek, 16, ekey);
+    assert(aes_key_wrap(data, 16, ekey, 16, out, false) == 24);
+    assert(!memcmp(out, wrapped128, 24));
+    assert(aes_key_unwrap(out, 24, ekey, 16, back, false) == 16);
+    assert(!memcmp(back, data, 16));
+
+    // RFC 3394 4.6: 256-bit key data with a 256-bit KEK
+    uint8_t wrapped256[40] = {
+        0x28, 0xC9, 0xF4, 0x04, 0xC4, 0xB8, 0x10, 0xF4, 0xCB, 0xCC, 0xB3, 0x5C, 0xFB, 0x87, 0xF8, 0x26,
+        0x3F, 0x57, 0x86, 0xE2, 0xD8, 0x0E, 0xD3, 0x26, 0xCB, 0xC7, 0xF0, 0xE7, 0x1A, 0x99, 0xF4, 0x3B,
+        0xFB, 0x98, 0x8B, 0x9B, 0x7A, 0x02, 0xDD, 0x21
+    };
+    expand_key(kek, 32, ekey);
+    assert(aes_key_wrap(data, 32, ekey, 32, out, false) == 40);
+    assert(!memcmp(out, wrapped256, 40));
+    assert(aes_key_unwrap(out, 40, ekey, 32, back, false) == 32);
+    assert(!memcmp(back, data, 32));
+
+    puts("key_wrap passed!");
+}
+
+void test_key_wrap_pad() {
+    // RFC 5649 section 6
+    uint8_t kek[24] = {
+        0x58, 0x40, 0xdf, 0x6e, 0x29, 0xb0, 0x2a, 0xf1, 0xab, 0x49, 0x3b, 0x70,
+        0x5b, 0xf1, 0x6e, 0xa1, 0xae, 0x83, 0x38, 0xf4, 0xdc, 0xc1, 0x76, 0xa8
+    };
+    uint8_t data20[20] = {
+        0xc3, 0x7b, 0x7e, 0x64, 0x92, 0x58, 0x43, 0x40, 0xbe, 0xd1,
+        0x22, 0x07, 0x80, 0x89, 0x41, 0x15, 0x50, 0x68, 0xf7, 0x38
+    };
+    uint8_t wrapped20[32] = {
+        0x13, 0x8b, 0xde, 0xaa, 0x9b, 0x8f, 0xa7, 0xfc, 0x61, 0xf9, 0x77, 0x42, 0xe7, 0x22, 0x48, 0xee,
+        0x5a, 0xe6, 0xae, 0x53, 0x60, 0xd1, 0xae, 0x6a, 0x5f, 0x54, 0xf3, 0x73, 0xfa, 0x54, 0x3b, 0x6a
+    };
+    uint8_t data7[7] = { 0x46, 0x6f, 0x72, 0x50, 0x61, 0x73, 0x69 };
+    uint8_t wrapped7[16] = {
+        0xaf, 0xbe, 0xb0, 0xf0, 0x7d, 0xfb, 0xf5, 0x41, 0x92, 0x00, 0xf2, 0xcc, 0xb5, 0x0b, 0xb2, 0x4f
+    };
+    uint8_t ekey[240], out[32], back[24];
+    expand_key(kek, 24, ekey);
+
+    assert(aes_key_wrap(data20, 20, ekey, 24, out, true) == 32);
+    assert(!memcmp(out, wrapped20, 32));
+    assert(aes_key_unwrap(out, 32, ekey, 24, back, true) == 20);
+    assert(!memcmp(back, data20, 20));
+
+    assert(aes_key_wrap(data7, 7, ekey, 24, out, true) == 16);
+    assert(!memcmp(out, wrapped7, 16));
+    assert(aes_key_unwrap(out, 16, ekey, 24, back, true) == 7);
+    assert(!memcmp(back, data7, 7));
+
+    puts("key_wrap_pad passed!");
+}
+
+void test_key_unwrap_errors() {
+    uint8_t kek[16] = {0}, ekey[240], data[32] = {0}, out[48], back[40];
+    expand_key(kek, 16, ekey);
+
+    assert(aes_key_wrap(data, 12, ekey, 16, out, false) == KW_ERR_LENGTH);
+    assert(aes_key_wrap(data, 8, ekey, 16, out, false) == KW_ERR_LENGTH);
+    assert(aes_key_wrap(data, 0, ekey, 16, out, true) == KW_ERR_LENGTH);
+    assert(aes_key_unwrap(data, 16, ekey, 16, back, false) == KW_ERR_LENGTH);
+
+    // A flipped bit anywhere must fail the integrity check and leave no key behind
+    assert(aes_key_wrap(data, 32, ekey, 16, out, false) == 40);
+    out[20] ^= 0x01;
+    assert(aes_key_unwrap(out, 40, ekey, 16, back, false) == KW_ERR_INTEGRITY);
+    for (int i = 0; i < 32; i++)
+        assert(back[i] == 0);
+
+    assert(aes_key_wrap(data, 20, ekey, 16, out, true) == 32);
+    assert(aes_key_unwrap(out, 32, ekey, 16, back, false) == KW_ERR_INTEGRITY);
+    out[0] ^= 0x80;
+    assert(aes_key_unwrap(out, 32, ekey, 16, back, true) == KW_ERR_INTEGRITY);
+
+    puts("key_unwrap_errors passed!");
+}
+
+void test_key_wrap_batch() {
+    // Mixed lengths, including single-block KWP keys and invalid entries
+    int num_items = 37;
+    uint64_t lens[5] = {16, 24, 32, 5, 40};
+    uint8_t kek[32], ekey[240];
+    for (int i = 0; i < 32; i++)
+        kek[i] = (uint8_t)(0xA0 + i);
+    expand_key(kek, 32, ekey);
+
+    for (int padded = 0; padded < 2; padded++) {
+        Kw_item wrap[37], unwrap[37];
+        uint8_t keys[37][40], wrapped[37][48], single[48], back[37][48];
+
+        for (int i = 0; i < num_items; i++) {
+            for (int j = 0; j < 40; j++)
+                keys[i][j] = (uint8_t)(i * 41 + j);
+            wrap[i].in = keys[i];
+            wrap[i].len_in = lens[i % 5];
+            wrap[i].out = wrapped[i];
+        }
+        aes_key_wrap_batch(wrap, num_items, ekey, 32, padded);
+
+        for (int i = 0; i < num_items; i++) {
+            int64_t expected = aes_key_wrap(keys[i], lens[i % 5], ekey, 32, single, padded);
+            assert(wrap[i].result == expected);
+            if (expected < 0)
+                continue;
+            assert(!memcmp(wrapped[i], single, expected));
+        }
+
+        for (int i = 0; i < num_items; i++) {
+            unwrap[i].in = wrapped[i];
+            unwrap[i].len_in = wrap[i].result < 0 ? 0 : wrap[i].result;
+            unwrap[i].out = back[i];
+        }
+        aes_key_unwrap_batch(unwrap, num_items, ekey, 32, padded);
+
+        for (int i = 0; i < num_items; i++) {
+            if (wrap[i].result < 0) {
+                assert(unwrap[i].result == KW_ERR_LENGTH);
+                continue;
+            }
+            assert(unwrap[i].result == (int64_t)lens[i % 5]);
+            assert(!memcmp(back[i], keys[i], lens[i % 5]));
+        }
+    }
+
+    puts("key_wrap_batch passed!");
+}
+
+void test_all_aes_keywrap() {
+    test_key_wrap();
+    test_key_wrap_pad();
+    test_key_unwrap_errors();
+    test_key_wrap_batch();
+    puts("All aes_keywrap tests passed!");
+}
@@ -0,0 +1,146 @@
+#include "../../include/aes_mac_test.h"
+
+// RFC 4493 key and message
+static uint8_t rfc_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static uint8_t rfc_msg[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static uint8_t* make_message(uint64_t len) {
+    uint8_t* msg = malloc(len + 1);
+    for (uint64_t i = 0; i < len; i++)
+        msg[i] = (uint8_t)(i * 31 + (i >> 8));
+    return msg;
+}
+
+void test_gf128_double() {
+    uint8_t block[16] = {0};
+    block[0] = 0x80;
+    gf128_double(block);
+    assert(block[0] == 0x00 && block[15] == 0x87);
+    gf128_halve(block);
+    assert(block[0] == 0x80 && block[15] == 0x00);
+
+    uint8_t k1[16], k2[16], ekey[240];
+    expand_key(rfc_key, 16, ekey);
+    cmac_subkeys(ekey, 16, k1, k2);
+    assert(k1[0] == 0xfb && k1[1] == 0xee && k1[15] == 0xde);
+    assert(k2[0] == 0xf7 && k2[1] == 0xdd && k2[15] == 0x3b);
+
+    puts("gf128_double passed!");
+}
+
+void test_cmac() {
+    uint8_t ekey[240], tag[16];
+    expand_key(rfc_key, 16, ekey);
+
+    uint8_t tag0[16] = {
+        0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46
+    };
+    uint8_t tag16[16] = {
+        0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c
+    };
+    uint8_t tag40[16] = {
+        0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27
+    };
+    uint8_t tag64[16] = {
+        0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe
+    };
+
+    aes_cmac(rfc_msg, 0, ekey, 16, tag);
+    assert(!memcmp(tag, tag0, 16));
+    aes_cmac(rfc_msg, 16, ekey, 16, tag);
+    assert(!memcmp(tag, tag16, 16));
+    aes_cmac(rfc_msg, 40, ekey, 16, tag);
+    assert(!memcmp(tag, tag40, 16));
+    aes_cmac(rfc_msg, 64, ekey, 16, tag);
+    assert(!memcmp(tag, tag64, 16));
+
+    puts("cmac passed!");
+}
+
+void test_cmac_incremental() {
+    uint8_t ekey[240], whole[16], pieces[16];
+    uint8_t* msg = make_message(1000);
+    expand_key(rfc_key, 16, ekey);
+    aes_cmac(msg, 1000, ekey, 16, whole);
+
+    // Split into ragged pieces, including empty and block-aligned ones
+    uint64_t cuts[8] = {0, 0, 7, 16, 16, 33, 512, 999};
+    Cmac_ctx ctx;
+    cmac_init(&ctx, ekey, 16);
+    uint64_t prev = 0;
+    for (int i = 0; i < 8; i++) {
+        cmac_update(&ctx, msg + prev, cuts[i] - prev);
+        prev = cuts[i];
+    }
+    cmac_update(&ctx, msg + prev, 1000 - prev);
+    cmac_final(&ctx, pieces);
+    assert(!memcmp(whole, pieces, 16));
+
+    free(msg);
+    puts("cmac_incremental passed!");
+}
+
+void test_pmac() {
+    uint8_t key[32], ekey[240], tag[16];
+    for (int i = 0; i < 32; i++)
+        key[i] = (uint8_t)i;
+
+    // PMAC-AES-128 of the empty message
+    uint8_t tag0[16] = {
+        0x43, 0x99, 0x57, 0x2c, 0xd6, 0xea, 0x53, 0x41, 0xb8, 0xd3, 0x58, 0x76, 0xa7, 0x09, 0x8a, 0xf7
+    };
+    expand_key(key, 16, ekey);
+    aes_pmac(NULL, 0, ekey, 16, tag, 1);
+    assert(!memcmp(tag, tag0, 16));
+
+    // PMAC-AES-256 of a ragged message, from a reference implementation
+    uint8_t tag_ragged[16] = {
+        0xc5, 0xd9, 0xdd, 0x36, 0xee, 0xc7, 0x6d, 0xd3, 0xfa, 0x23, 0xd8, 0x1c, 0x01, 0x00, 0xae, 0x0d
+    };
+    uint8_t* msg = make_message(100003);
+    expand_key(key, 32, ekey);
+    aes_pmac(msg, 100003, ekey, 32, tag, 1);
+    assert(!memcmp(tag, tag_ragged, 16));
+
+    free(msg);
+    puts("pmac passed!");
+}
+
+void test_pmac_threads() {
+    uint8_t key[32], ekey[240], serial[16], threaded[16];
+    for (int i = 0; i < 32; i++)
+        key[i] = (uint8_t)i;
+    expand_key(key, 32, ekey);
+
+    uint8_t expected[16] = {
+        0x91, 0xaf, 0x4a, 0xfe, 0x96, 0x57, 0x7f, 0x6d, 0x6e, 0x06, 0x65, 0xd8, 0x9c, 0x64, 0x6e, 0x69
+    };
+    uint64_t len = (1 << 20) | 5;
+    uint8_t* msg = make_message(len);
+
+    aes_pmac(msg, len, ekey, 32, serial, 1);
+    assert(!memcmp(serial, expected, 16));
+    aes_pmac(msg, len, ekey, 32, threaded, 5);
+    assert(!memcmp(serial, threaded, 16));
+
+    free(msg);
+    puts("pmac_threads passed!");
+}
+
+void test_all_aes_mac() {
+    test_gf128_double();
+    test_cmac();
+    test_cmac_incremental();
+    test_pmac();
+    test_pmac_threads();
+    puts("All aes_mac tests passed!");
+}
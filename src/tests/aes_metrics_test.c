@@ -0,0 +1,120 @@
+#include "../../include/aes_metrics_test.h"
+
+#include <unistd.h>
+
+static uint8_t ekey[240];
+
+static uint64_t total_latency_count(Metrics_snapshot* snap, Op_mode op_mode) {
+    uint64_t count = 0;
+    for (int b = 0; b < METRICS_HIST_BUCKETS; b++)
+        count += snap->latency[op_mode][b];
+    return count;
+}
+
+void test_metrics_counters() {
+    uint8_t key[16] = {0};
+    uint8_t data[100] = {0};
+    uint8_t iv[16] = {0};
+    Metrics_snapshot before, after;
+
+    metrics_enable();
+    metrics_snapshot(&before);
+
+    expand_key(key, 16, ekey);
+    aes_mode(CTR, data, 100, ekey, 16, iv, true);
+    aes_mode(CTR, data, 20, ekey, 16, iv, true);
+    aes_mode(ECB, data, 96, ekey, 16, iv, true);
+    metrics_count_cache(true);
+    metrics_count_cache(false);
+    metrics_count_cache(false);
+
+    metrics_snapshot(&after);
+    assert(after.bytes[CTR][METRICS_MEMORY] - before.bytes[CTR][METRICS_MEMORY] == 120);
+    assert(after.blocks[CTR][METRICS_MEMORY] - before.blocks[CTR][METRICS_MEMORY] == 7 + 2);
+    assert(after.bytes[ECB][METRICS_MEMORY] - before.bytes[ECB][METRICS_MEMORY] == 96);
+    assert(after.key_expansions - before.key_expansions == 1);
+    assert(after.cache_hits - before.cache_hits == 1);
+    assert(after.cache_misses - before.cache_misses == 2);
+    assert(after.latency_count[CTR] - before.latency_count[CTR] == 2);
+    assert(total_latency_count(&after, CTR) == after.latency_count[CTR]);
+    assert(after.elapsed >= before.elapsed);
+
+    puts("metrics_counters passed!");
+}
+
+static void* record_cbc(void* arg) {
+    (void)arg;
+    uint8_t data[64] = {0};
+    uint8_t iv[16] = {0};
+    metrics_set_backend(METRICS_THREADS);
+    for (int i = 0; i < 50; i++)
+        aes_mode(CBC, data, 64, ekey, 16, iv, true);
+    return NULL;
+}
+
+void test_metrics_thread_histograms() {
+    Metrics_snapshot before, after;
+    metrics_snapshot(&before);
+
+    // Samples of threads that have exited are kept
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++)
+        pthread_create(&threads[t], NULL, record_cbc, NULL);
+    for (int t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+
+    metrics_snapshot(&after);
+    assert(after.latency_count[CBC] - before.latency_count[CBC] == 200);
+    assert(total_latency_count(&after, CBC) == after.latency_count[CBC]);
+    assert(after.bytes[CBC][METRICS_THREADS] - before.bytes[CBC][METRICS_THREADS] == 200 * 64);
+    assert(after.bytes[CBC][METRICS_MEMORY] == before.bytes[CBC][METRICS_MEMORY]);
+
+    puts("metrics_thread_histograms passed!");
+}
+
+void test_metrics_prometheus() {
+    char path[] = "/tmp/aes_metrics_XXXXXX";
+    close(mkstemp(path));
+    assert(metrics_write_prometheus(path) == 0);
+
+    FILE* f = fopen(path, "r");
+    assert(f);
+    char line[512];
+    bool has_bytes = false, has_inf = false, has_type = false;
+    while (fgets(line, sizeof(line), f)) {
+        has_bytes |= !strncmp(line, "aes_bytes_total{mode=\"CTR\",backend=\"memory\"} ", 45);
+        has_inf |= !strncmp(line, "aes_request_duration_seconds_bucket{mode=\"CBC\",le=\"+Inf\"} ", 58);
+        has_type |= !strcmp(line, "# TYPE aes_request_duration_seconds histogram\n");
+    }
+    fclose(f);
+    unlink(path);
+    assert(has_bytes && has_inf && has_type);
+
+    puts("metrics_prometheus passed!");
+}
+
+void test_metrics_progress() {
+    Metrics_snapshot snap;
+    char line[256];
+    memset(&snap, 0, sizeof(snap));
+    snap.bytes[CTR][METRICS_URING] = 512 * 1024 * 1024;
+    snap.expected_bytes = 2048ULL * 1024 * 1024;
+    snap.elapsed = 2.0;
+
+    metrics_format_progress(&snap, line, sizeof(line));
+    assert(!strcmp(line, "512.0 MiB / 2.0 GiB (25.0%)  256.0 MiB/s  ETA 0:00:06"));
+
+    snap.expected_bytes = 0;
+    metrics_format_progress(&snap, line, sizeof(line));
+    assert(!strcmp(line, "512.0 MiB  256.0 MiB/s"));
+
+    puts("metrics_progress passed!");
+}
+
+void test_all_aes_metrics() {
+    test_metrics_counters();
+    test_metrics_thread_histograms();
+    test_metrics_prometheus();
+    test_metrics_progress();
+    puts("All aes_metrics tests passed!");
+}
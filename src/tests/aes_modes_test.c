@@ -0,0 +1,256 @@
+#include "../../include/aes_modes_test.h"
+
+// NIST SP 800-38A, Appendix F, AES-128 key and plaintext
+static uint8_t sp_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static uint8_t sp_iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+static uint8_t sp_plain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+/*
+ * Encrypt sp_plain with the given mode, check against expected, then decrypt
+ * and check the plaintext comes back. Runs once in a single call and once
+ * block by block to exercise IV chaining across calls.
+ */
+static void check_mode(Op_mode op_mode, uint8_t* iv_init, uint8_t* expected) {
+    uint8_t ekey[240];
+    uint8_t data[64];
+    uint8_t iv[16];
+
+    expand_key(sp_key, 16, ekey);
+
+    memcpy(data, sp_plain, 64);
+    memcpy(iv, iv_init, 16);
+    aes_mode(op_mode, data, 64, ekey, 16, iv, true);
+    assert(!memcmp(data, expected, 64));
+
+    memcpy(iv, iv_init, 16);
+    aes_mode(op_mode, data, 64, ekey, 16, iv, false);
+    assert(!memcmp(data, sp_plain, 64));
+
+    memcpy(data, sp_plain, 64);
+    memcpy(iv, iv_init, 16);
+    for (int i = 0; i < 4; i++)
+        aes_mode(op_mode, data + i*16, 16, ekey, 16, iv, true);
+    assert(!memcmp(data, expected, 64));
+
+    memcpy(iv, iv_init, 16);
+    for (int i = 0; i < 4; i++)
+        aes_mode(op_mode, data + i*16, 16, ekey, 16, iv, false);
+    assert(!memcmp(data, sp_plain, 64));
+}
+
+/*
+ * Encrypt and decrypt sp_plain in uneven pieces, one byte at a time near the
+ * start so the register straddles the IV and the ciphertext.
+ */
+static void check_segments(Op_mode op_mode, uint8_t* expected) {
+    uint8_t ekey[240];
+    uint8_t data[64];
+    uint8_t iv[16];
+    int pieces[7] = { 1, 1, 3, 14, 2, 40, 3 };
+
+    expand_key(sp_key, 16, ekey);
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool is_encrypt = pass == 0;
+        memcpy(data, is_encrypt ? sp_plain : expected, 64);
+        memcpy(iv, sp_iv, 16);
+        for (int i = 0, offset = 0; i < 7; offset += pieces[i++])
+            aes_mode(op_mode, data + offset, pieces[i], ekey, 16, iv, is_encrypt);
+        assert(!memcmp(data, is_encrypt ? expected : sp_plain, 64));
+        assert(!memcmp(iv, expected + 48, 16));
+    }
+}
+
+void test_aes_x8() {
+    uint8_t ekey[240];
+    uint8_t single[13*16];
+    uint8_t multi[13*16];
+
+    for (int i = 0; i < 13*16; i++)
+        single[i] = multi[i] = (uint8_t)(i * 7 + 3);
+
+    int key_lens[3] = {16, 24, 32};
+    for (int k = 0; k < 3; k++) {
+        uint8_t key[32];
+        for (int i = 0; i < 32; i++)
+            key[i] = (uint8_t)i;
+        expand_key(key, key_lens[k], ekey);
+
+        // 13 blocks covers the x8, x4 and single block paths of aes_blocks
+        for (int i = 0; i < 13; i++)
+            aes(single + i*16, ekey, key_lens[k], true);
+        aes_blocks(multi, 13, ekey, key_lens[k], true);
+        assert(!memcmp(single, multi, 13*16));
+
+        for (int i = 0; i < 13; i++)
+            aes(single + i*16, ekey, key_lens[k], false);
+        aes_blocks(multi, 13, ekey, key_lens[k], false);
+        assert(!memcmp(single, multi, 13*16));
+    }
+
+    puts("aes_x8 passed!");
+}
+
+void test_ecb() {
+    uint8_t expected[64] = {
+        0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+        0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+        0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+        0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+    };
+    check_mode(ECB, sp_iv, expected);
+    puts("ecb passed!");
+}
+
+void test_cbc() {
+    uint8_t expected[64] = {
+        0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+        0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+        0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+        0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+    };
+    check_mode(CBC, sp_iv, expected);
+    puts("cbc passed!");
+}
+
+void test_cfb() {
+    uint8_t expected[64] = {
+        0x3b, 0x3f, 0xd9, 0x2e, 0xb7, 0x2d, 0xad, 0x20, 0x33, 0x34, 0x49, 0xf8, 0xe8, 0x3c, 0xfb, 0x4a,
+        0xc8, 0xa6, 0x45, 0x37, 0xa0, 0xb3, 0xa9, 0x3f, 0xcd, 0xe3, 0xcd, 0xad, 0x9f, 0x1c, 0xe5, 0x8b,
+        0x26, 0x75, 0x1f, 0x67, 0xa3, 0xcb, 0xb1, 0x40, 0xb1, 0x80, 0x8c, 0xf1, 0x87, 0xa4, 0xf4, 0xdf,
+        0xc0, 0x4b, 0x05, 0x35, 0x7c, 0x5d, 0x1c, 0x0e, 0xea, 0xc4, 0xc6, 0x6f, 0x9f, 0xf7, 0xf2, 0xe6
+    };
+    check_mode(CFB, sp_iv, expected);
+    puts("cfb passed!");
+}
+
+void test_cfb8() {
+    uint8_t expected[64] = {
+        0x3b, 0x79, 0x42, 0x4c, 0x9c, 0x0d, 0xd4, 0x36, 0xba, 0xce, 0x9e, 0x0e, 0xd4, 0x58, 0x6a, 0x4f,
+        0x32, 0xb9, 0xde, 0xd5, 0x0a, 0xe3, 0xba, 0x69, 0xd4, 0x72, 0xe8, 0x82, 0x67, 0xfb, 0x50, 0x52,
+        0x70, 0xcb, 0xad, 0x1e, 0x25, 0x76, 0x91, 0xf7, 0xc4, 0x7c, 0x50, 0x38, 0x29, 0x7e, 0xdd, 0xa3,
+        0x2f, 0xf2, 0x6d, 0x0e, 0xd1, 0x91, 0x74, 0x09, 0x61, 0x61, 0xec, 0xc1, 0x40, 0x86, 0xdd, 0x62
+    };
+    check_mode(CFB8, sp_iv, expected);
+    check_segments(CFB8, expected);
+    puts("cfb8 passed!");
+}
+
+void test_cfb1() {
+    uint8_t expected[64] = {
+        0x68, 0xb3, 0xa2, 0x64, 0xf8, 0x38, 0xf5, 0xf8, 0xc3, 0x10, 0x10, 0x70, 0xd1, 0xab, 0x4c, 0x2e,
+        0x22, 0xe7, 0xf9, 0x50, 0x38, 0x3a, 0x0b, 0x71, 0xad, 0xe4, 0xfa, 0xd0, 0x09, 0x5c, 0xb1, 0x88,
+        0xa5, 0x79, 0x72, 0xc3, 0xc1, 0x88, 0x26, 0x15, 0xf7, 0x51, 0x14, 0x11, 0xfb, 0xeb, 0xf1, 0x19,
+        0x39, 0x97, 0x06, 0x97, 0x04, 0xfc, 0x1d, 0x1f, 0x27, 0x02, 0x84, 0x34, 0xc9, 0x9e, 0x60, 0xf4
+    };
+    check_mode(CFB1, sp_iv, expected);
+    check_segments(CFB1, expected);
+    puts("cfb1 passed!");
+}
+
+void test_ofb() {
+    uint8_t expected[64] = {
+        0x3b, 0x3f, 0xd9, 0x2e, 0xb7, 0x2d, 0xad, 0x20, 0x33, 0x34, 0x49, 0xf8, 0xe8, 0x3c, 0xfb, 0x4a,
+        0x77, 0x89, 0x50, 0x8d, 0x16, 0x91, 0x8f, 0x03, 0xf5, 0x3c, 0x52, 0xda, 0xc5, 0x4e, 0xd8, 0x25,
+        0x97, 0x40, 0x05, 0x1e, 0x9c, 0x5f, 0xec, 0xf6, 0x43, 0x44, 0xf7, 0xa8, 0x22, 0x60, 0xed, 0xcc,
+        0x30, 0x4c, 0x65, 0x28, 0xf6, 0x59, 0xc7, 0x78, 0x66, 0xa5, 0x10, 0xd9, 0xc1, 0xd6, 0xae, 0x5e
+    };
+    check_mode(OFB, sp_iv, expected);
+    puts("ofb passed!");
+}
+
+void test_ctr() {
+    uint8_t counter[16] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+        0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    uint8_t expected[64] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+    check_mode(CTR, counter, expected);
+
+    // Partial final block with the counter wrapping past 2^128 - 1
+    uint8_t wrap[16];
+    memset(wrap, 0xff, 16);
+    wrap[15] = 0xfe;
+    uint8_t expected_tail[37] = {
+        0xba, 0x76, 0xaa, 0x54, 0xd5, 0xb5, 0x60, 0x67, 0xc1, 0xa7, 0x90, 0x3b, 0x3f, 0xdd, 0xfa, 0x89,
+        0x24, 0xdf, 0x0c, 0x56, 0x5c, 0xf4, 0x2a, 0x68, 0x97, 0x87, 0x13, 0xb6, 0x7a, 0xd1, 0x24, 0xfd,
+        0x4d, 0x3f, 0x77, 0x4a, 0xb9
+    };
+    uint8_t ekey[240];
+    uint8_t data[37];
+    expand_key(sp_key, 16, ekey);
+    memcpy(data, sp_plain, 37);
+    aes_ctr(data, 37, ekey, 16, wrap);
+    assert(!memcmp(data, expected_tail, 37));
+
+    puts("ctr passed!");
+}
+
+void test_bulk() {
+    // The bulk path must give the same output and chaining value as the
+    // plain one, including across staging tiles and with a ragged tail
+    Op_mode modes[7] = {ECB, CBC, CFB, OFB, CTR, CFB8, CFB1};
+    uint64_t len = 3*4096;
+    uint8_t* bulk = aligned_alloc(16, len + 16);
+    uint8_t* plain = aligned_alloc(16, len + 16);
+    uint8_t ekey[240];
+    expand_key(sp_key, 16, ekey);
+
+    for (int m = 0; m < 7; m++) {
+        uint64_t n = modes[m] == ECB || modes[m] == CBC ? len : len + 3;
+        for (int pass = 0; pass < 2; pass++) {
+            bool is_encrypt = pass == 0;
+            uint8_t iv_bulk[16], iv_plain[16];
+            memcpy(iv_bulk, sp_iv, 16);
+            memcpy(iv_plain, sp_iv, 16);
+            for (uint64_t i = 0; i < n; i++)
+                bulk[i] = plain[i] = (uint8_t)(i * 13 + m);
+
+            aes_bulk_set_threshold(1);
+            aes_mode(modes[m], bulk, n, ekey, 16, iv_bulk, is_encrypt);
+            aes_bulk_set_threshold(UINT64_MAX);
+            aes_mode(modes[m], plain, n, ekey, 16, iv_plain, is_encrypt);
+
+            assert(!memcmp(bulk, plain, n));
+            assert(!memcmp(iv_bulk, iv_plain, 16));
+        }
+    }
+
+    aes_bulk_set_threshold(0);
+    assert(aes_bulk_threshold() > 0 && aes_bulk_threshold() < UINT64_MAX);
+
+    free(bulk);
+    free(plain);
+    puts("bulk passed!");
+}
+
+void test_all_aes_modes() {
+    test_aes_x8();
+    test_ecb();
+    test_cbc();
+    test_cfb();
+    test_cfb8();
+    test_cfb1();
+    test_ofb();
+    test_ctr();
+    test_bulk();
+    puts("All aes_modes tests passed!");
+}
@@ -0,0 +1,123 @@
+#include "../../include/aes_multibuf_test.h"
+
+void test_blocks_keys() {
+    uint8_t key[8][32];
+    uint8_t ekey[8][240];
+    uint8_t* ekeys[8];
+    uint8_t blocks[11*16];
+    uint8_t expected[11*16];
+    uint8_t* block_keys[11];
+
+    for (int k = 0; k < 8; k++) {
+        for (int i = 0; i < 32; i++)
+            key[k][i] = (uint8_t)(k * 41 + i);
+        expand_key(key[k], 24, ekey[k]);
+        ekeys[k] = ekey[k];
+    }
+    for (int i = 0; i < 11*16; i++)
+        blocks[i] = (uint8_t)(i * 3);
+    for (int b = 0; b < 11; b++)
+        block_keys[b] = ekeys[(b * 5) % 8];
+
+    for (int is_encrypt = 0; is_encrypt < 2; is_encrypt++) {
+        memcpy(expected, blocks, sizeof(blocks));
+        for (int b = 0; b < 11; b++)
+            aes(expected + b*16, block_keys[b], 24, is_encrypt);
+        aes_blocks_keys(blocks, 11, block_keys, 24, is_encrypt);
+        assert(!memcmp(blocks, expected, sizeof(blocks)));
+    }
+
+    puts("blocks_keys passed!");
+}
+
+void test_cbc_multi_vector() {
+    // NIST SP 800-38A F.2.1 CBC-AES128.Encrypt, the same message in three lanes
+    uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    uint8_t plain[32] = { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+                          0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+                          0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+                          0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51 };
+    uint8_t cipher[32] = { 0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+                           0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+                           0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+                           0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2 };
+    uint8_t ekey[240];
+    expand_key(key, 16, ekey);
+
+    uint8_t data[3][32];
+    uint8_t iv[3][16];
+    Cbc_msg msgs[3];
+    for (int m = 0; m < 3; m++) {
+        memcpy(data[m], plain, 32);
+        for (int i = 0; i < 16; i++)
+            iv[m][i] = (uint8_t)i;
+        msgs[m] = (Cbc_msg){ data[m], 32, ekey, 16, iv[m] };
+    }
+    aes_cbc_encrypt_multi(msgs, 3);
+
+    for (int m = 0; m < 3; m++) {
+        assert(!memcmp(data[m], cipher, 32));
+        assert(!memcmp(iv[m], cipher + 16, 16));
+    }
+
+    puts("cbc_multi_vector passed!");
+}
+
+/*
+ * Many messages of different lengths, IVs, keys and key lengths, against
+ * aes_cbc() on each message alone.
+ */
+void test_cbc_multi_mixed() {
+    enum { NUM_MSGS = 37 };
+    static const int key_lengths[3] = { 16, 24, 32 };
+    uint8_t ekey[6][240];
+    Cbc_msg msgs[NUM_MSGS];
+    uint8_t* expected[NUM_MSGS];
+    uint8_t iv[NUM_MSGS][16];
+    uint8_t expected_iv[NUM_MSGS][16];
+
+    for (int k = 0; k < 6; k++) {
+        uint8_t key[32];
+        for (int i = 0; i < 32; i++)
+            key[i] = (uint8_t)(k * 17 + i * 3);
+        expand_key(key, key_lengths[k % 3], ekey[k]);
+    }
+
+    for (int m = 0; m < NUM_MSGS; m++) {
+        uint64_t len = 16 * (uint64_t)((m * 7) % 23);
+        int k = (m * 5) % 6;
+        msgs[m].data = malloc(len + 1);
+        msgs[m].len = len;
+        msgs[m].ekey = ekey[k];
+        msgs[m].len_key = key_lengths[k % 3];
+        msgs[m].iv = iv[m];
+        for (uint64_t i = 0; i < len; i++)
+            msgs[m].data[i] = (uint8_t)(i + m);
+        for (int i = 0; i < 16; i++)
+            iv[m][i] = (uint8_t)(m * 11 + i);
+
+        expected[m] = malloc(len + 1);
+        memcpy(expected[m], msgs[m].data, len);
+        memcpy(expected_iv[m], iv[m], 16);
+        aes_cbc(expected[m], len, msgs[m].ekey, msgs[m].len_key, expected_iv[m], true);
+    }
+
+    aes_cbc_encrypt_multi(msgs, NUM_MSGS);
+
+    for (int m = 0; m < NUM_MSGS; m++) {
+        assert(!memcmp(msgs[m].data, expected[m], msgs[m].len));
+        assert(!memcmp(iv[m], expected_iv[m], 16));
+        free(msgs[m].data);
+        free(expected[m]);
+    }
+
+    puts("cbc_multi_mixed passed!");
+}
+
+void test_all_aes_multibuf() {
+    test_blocks_keys();
+    test_cbc_multi_vector();
+    test_cbc_multi_mixed();
+    puts("All aes_multibuf tests passed!");
+}
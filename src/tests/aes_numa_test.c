@@ -0,0 +1,114 @@
+#include "../../include/aes_numa_test.h"
+
+#include <unistd.h>
+
+void test_parse_cpulist() {
+    cpu_set_t cpus;
+
+    assert(numa_parse_cpulist("0-3,8,10-11\n", &cpus) == 7);
+    assert(CPU_ISSET(0, &cpus) && CPU_ISSET(3, &cpus) && CPU_ISSET(8, &cpus));
+    assert(CPU_ISSET(11, &cpus) && !CPU_ISSET(4, &cpus) && !CPU_ISSET(9, &cpus));
+    assert(numa_parse_cpulist("5", &cpus) == 1 && CPU_ISSET(5, &cpus));
+    assert(numa_parse_cpulist("", &cpus) == 0);
+
+    assert(numa_parse_cpulist("3-1", &cpus) == -1);
+    assert(numa_parse_cpulist("0-", &cpus) == -1);
+    assert(numa_parse_cpulist("1;2", &cpus) == -1);
+
+    puts("parse_cpulist passed!");
+}
+
+void test_discover() {
+    Numa_topology topo;
+    numa_discover(&topo);
+
+    assert(topo.num_nodes >= 1 && topo.num_nodes <= AES_NUMA_MAX_NODES);
+    for (int n = 0; n < topo.num_nodes; n++) {
+        assert(CPU_COUNT(&topo.cpus[n]) > 0);
+        assert(numa_pin_to_node(&topo, n) == 0);
+    }
+    assert(numa_pin_to_node(&topo, topo.num_nodes) == -1);
+
+    // Leave the test thread free to run anywhere again
+    cpu_set_t all;
+    CPU_ZERO(&all);
+    for (int n = 0; n < topo.num_nodes; n++)
+        CPU_OR(&all, &all, &topo.cpus[n]);
+    pthread_setaffinity_np(pthread_self(), sizeof(all), &all);
+
+    puts("discover passed!");
+}
+
+void test_first_touch() {
+    size_t size = 3 * sysconf(_SC_PAGESIZE) + 100;
+    uint8_t* buf = numa_alloc_untouched(size);
+    assert(buf);
+    numa_first_touch(buf, size);
+    for (size_t i = 0; i < size; i++)
+        assert(buf[i] == 0);
+    memset(buf, 0xAB, size);
+    numa_free(buf, size);
+
+    puts("first_touch passed!");
+}
+
+/*
+ * The pipeline output must not depend on how workers and buffers are placed.
+ */
+void test_numa_pipeline() {
+    char in_file[] = "/tmp/aes_numa_in_XXXXXX";
+    char out_file[2][32] = { "/tmp/aes_numa_a_XXXXXX", "/tmp/aes_numa_b_XXXXXX" };
+    close(mkstemp(in_file));
+    close(mkstemp(out_file[0]));
+    close(mkstemp(out_file[1]));
+
+    uint8_t key[16];
+    uint8_t ekey[240];
+    uint8_t iv[16];
+    for (int i = 0; i < 16; i++)
+        key[i] = (uint8_t)(i * 7 + 3);
+    expand_key(key, 16, ekey);
+
+    uint64_t len = 50001;
+    uint8_t* plain = malloc(len);
+    for (uint64_t i = 0; i < len; i++)
+        plain[i] = (uint8_t)(i ^ (i >> 7));
+    FILE* f = fopen(in_file, "wb");
+    assert(fwrite(plain, 1, len, f) == len);
+    fclose(f);
+
+    uint8_t* out[2];
+    uint64_t len_out[2];
+    for (int numa = 0; numa < 2; numa++) {
+        Aes_io_opts opts;
+        aes_io_default_opts(&opts);
+        opts.backend = IO_THREADS;
+        opts.chunk_size = 4096;
+        opts.num_threads = 3;
+        opts.numa = numa;
+
+        memset(iv, 0x5A, 16);
+        assert(aes_file_pipeline(in_file, out_file[numa], CTR, ekey, 16, iv, true, &opts) == 0);
+        len_out[numa] = 0;
+        out[numa] = read_vector(out_file[numa], &len_out[numa], false);
+    }
+    assert(len_out[0] == len_out[1]);
+    assert(!memcmp(out[0], out[1], len_out[0]));
+
+    free(plain);
+    free(out[0]);
+    free(out[1]);
+    unlink(in_file);
+    unlink(out_file[0]);
+    unlink(out_file[1]);
+
+    puts("numa_pipeline passed!");
+}
+
+void test_all_aes_numa() {
+    test_parse_cpulist();
+    test_discover();
+    test_first_touch();
+    test_numa_pipeline();
+    puts("All aes_numa tests passed!");
+}
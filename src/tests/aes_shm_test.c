@@ -0,0 +1,266 @@
+#include "../../include/aes_shm_test.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const uint8_t shm_keys[2][32] = {
+    { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+    { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+      0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 }
+};
+static const int shm_len_keys[2] = { 16, 32 };
+
+static void start_service(Aes_shm_service* svc, char* name, int num_workers) {
+    sprintf(name, "/aes-shm-test-%d", (int)getpid());
+    assert(aes_shm_service_init(svc, name, num_workers, 64 * 1024) == 0);
+    assert(aes_shm_service_add_key(svc, shm_keys[0], 16) == 0);
+    assert(aes_shm_service_add_key(svc, shm_keys[1], 32) == 1);
+    assert(aes_shm_service_start(svc) == 0);
+}
+
+/**
+ * @brief Check a completed request against the C entry point, given the
+ *        plaintext it started from.
+ */
+static void check_done(const Aes_shm_request* done, const uint8_t* area, const uint8_t* plain,
+        const uint8_t* iv) {
+    uint8_t ekey[240], expected_iv[16];
+    uint8_t* expected = malloc(done->len);
+    memcpy(expected, plain, done->len);
+    memcpy(expected_iv, iv, 16);
+    expand_key((uint8_t*)shm_keys[done->key_id], shm_len_keys[done->key_id], ekey);
+    aes_mode((Op_mode)done->op_mode, expected, done->len, ekey, shm_len_keys[done->key_id],
+            expected_iv, done->is_encrypt);
+
+    assert(done->status == 0);
+    assert(!memcmp(area + done->offset, expected, done->len));
+    assert(!memcmp(done->iv, expected_iv, 16));
+    free(expected);
+}
+
+void test_shm_modes() {
+    Aes_shm_service svc;
+    Aes_shm_client c;
+    char name[64];
+    start_service(&svc, name, 2);
+    assert(aes_shm_attach(&c, name) == 0);
+    assert(c.area_size == 64 * 1024);
+
+    // Every mode in both directions, several requests in flight at once
+    Op_mode modes[7] = { ECB, CBC, CFB, OFB, CTR, CFB8, CFB1 };
+    uint64_t lens[7] = { 160, 160, 157, 157, 4099, 37, 5 };
+    uint8_t plain[14][4099];
+    uint8_t iv[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                       0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+    for (int r = 0; r < 14; r++) {
+        Aes_shm_request req = {0};
+        req.tag = r;
+        req.offset = r * 4160;
+        req.len = lens[r % 7];
+        req.key_id = r & 1;
+        req.op_mode = modes[r % 7];
+        req.is_encrypt = r < 7;
+        memcpy(req.iv, iv, 16);
+        for (uint64_t i = 0; i < req.len; i++)
+            plain[r][i] = c.area[req.offset + i] = (uint8_t)(i * 13 + r);
+        assert(aes_shm_submit(&c, &req) == 0);
+    }
+    assert(c.in_flight == 14);
+
+    bool seen[14] = {0};
+    Aes_shm_request done;
+    for (int r = 0; r < 14; r++) {
+        assert(aes_shm_wait(&c, &done) == 0);
+        assert(done.tag < 14 && !seen[done.tag]);
+        seen[done.tag] = true;
+        check_done(&done, c.area, plain[done.tag], iv);
+    }
+    assert(c.in_flight == 0 && aes_shm_poll(&c, &done) == 0);
+
+    aes_shm_detach(&c);
+    aes_shm_service_stop(&svc);
+    puts("shm_modes passed!");
+}
+
+void test_shm_rejects() {
+    Aes_shm_service svc;
+    Aes_shm_client c;
+    char name[64];
+    start_service(&svc, name, 1);
+    assert(aes_shm_attach(&c, name) == 0);
+
+    // Unknown key, ranges outside the area, partial blocks for ECB and CBC
+    Aes_shm_request bad[5] = {
+        { .key_id = 2, .op_mode = CTR, .len = 16 },
+        { .op_mode = CTR, .offset = 64 * 1024 - 8, .len = 16 },
+        { .op_mode = CTR, .offset = UINT64_MAX, .len = 1 },
+        { .op_mode = CBC, .len = 17 },
+        { .op_mode = 7, .len = 16 },
+    };
+    memset(c.area, 0x5a, 64);
+    for (int r = 0; r < 5; r++) {
+        bad[r].tag = r;
+        assert(aes_shm_submit(&c, &bad[r]) == 0);
+    }
+    Aes_shm_request done;
+    for (int r = 0; r < 5; r++) {
+        assert(aes_shm_wait(&c, &done) == 0);
+        assert(done.status == -1);
+    }
+    for (int i = 0; i < 64; i++)
+        assert(c.area[i] == 0x5a);
+    assert(aes_shm_wait(&c, &done) == -1);
+
+    // No more in flight than the completion ring holds
+    Aes_shm_request req = { .op_mode = CTR, .len = 16 };
+    int submitted = 0;
+    while (aes_shm_submit(&c, &req) == 0)
+        submitted++;
+    assert(submitted <= AES_SHM_MAX_IN_FLIGHT);
+    while (aes_shm_wait(&c, &done) == 0)
+        assert(done.status == 0);
+    assert(c.in_flight == 0);
+
+    // A stopped service takes nothing more
+    aes_shm_service_stop(&svc);
+    assert(aes_shm_submit(&c, &req) == -1);
+    aes_shm_detach(&c);
+
+    assert(aes_shm_attach(&c, name) == -1);
+    puts("shm_rejects passed!");
+}
+
+void test_shm_slot_reuse() {
+    Aes_shm_service svc;
+    Aes_shm_client c, next;
+    char name[64];
+    start_service(&svc, name, 2);
+    Aes_shm_request req = { .op_mode = CTR, .len = 4096 }, done;
+
+    // Detaching waits for the requests still in flight
+    assert(aes_shm_attach(&c, name) == 0);
+    for (int r = 0; r < 32; r++)
+        assert(aes_shm_submit(&c, &req) == 0);
+    aes_shm_detach(&c);
+    assert(aes_shm_attach(&c, name) == 0 && c.id == 0);
+    assert(c.in_flight == 0 && aes_shm_poll(&c, &done) == 0);
+
+    // A process that dies with requests in flight leaves its slot behind;
+    // the next attach reclaims it, and its completions are not counted
+    pid_t pid = fork();
+    if (pid == 0) {
+        Aes_shm_client dead;
+        if (aes_shm_attach(&dead, name) != 0 || dead.id != 1)
+            _exit(1);
+        for (int r = 0; r < 32; r++)
+            if (aes_shm_submit(&dead, &req) != 0)
+                _exit(1);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(aes_shm_attach(&next, name) == 0 && next.id == 1);
+    req.tag = 1;
+    assert(aes_shm_submit(&next, &req) == 0);
+    assert(aes_shm_wait(&next, &done) == 0 && done.tag == 1 && done.status == 0);
+    assert(next.in_flight == 0 && aes_shm_poll(&next, &done) == 0);
+    assert(aes_shm_submit(&next, &req) == 0);
+
+    aes_shm_detach(&next);
+    aes_shm_detach(&c);
+    aes_shm_service_stop(&svc);
+    puts("shm_slot_reuse passed!");
+}
+
+typedef struct shm_client_job {
+    const char* name;
+    int index;
+} Shm_client_job;
+
+static void* client_thread(void* arg) {
+    Shm_client_job* job = arg;
+    Aes_shm_client c;
+    assert(aes_shm_attach(&c, job->name) == 0);
+
+    // Keep several requests in flight, reusing each slot once it completes;
+    // completions come back in any order
+    enum { SLOTS = 8, LEN = 1000, REQUESTS = 64 };
+    uint8_t plain[SLOTS][LEN];
+    int free_slots[SLOTS], num_free = SLOTS;
+    for (int s = 0; s < SLOTS; s++)
+        free_slots[s] = s;
+    uint8_t iv[16] = {0};
+    iv[0] = (uint8_t)job->index;
+    int sent = 0, received = 0;
+    while (received < REQUESTS) {
+        while (sent < REQUESTS && num_free > 0) {
+            int slot = free_slots[--num_free];
+            Aes_shm_request req = { .tag = slot, .offset = slot * 1024, .len = LEN,
+                .key_id = sent & 1, .op_mode = CTR, .is_encrypt = 1 };
+            memcpy(req.iv, iv, 16);
+            for (int i = 0; i < LEN; i++)
+                plain[slot][i] = c.area[req.offset + i] = (uint8_t)(i + sent + job->index);
+            assert(aes_shm_submit(&c, &req) == 0);
+            sent++;
+        }
+        Aes_shm_request done;
+        assert(aes_shm_wait(&c, &done) == 0);
+        check_done(&done, c.area, plain[done.tag], iv);
+        free_slots[num_free++] = (int)done.tag;
+        received++;
+    }
+
+    aes_shm_detach(&c);
+    return NULL;
+}
+
+void test_shm_clients() {
+    // Several clients share each worker's submission ring
+    Aes_shm_service svc;
+    char name[64];
+    start_service(&svc, name, 2);
+
+    pthread_t threads[4];
+    Shm_client_job jobs[4];
+    for (int t = 0; t < 4; t++) {
+        jobs[t].name = name;
+        jobs[t].index = t;
+        pthread_create(&threads[t], NULL, client_thread, &jobs[t]);
+    }
+    for (int t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+    assert(atomic_load(&svc.region->clients) == 0);
+
+    aes_shm_service_stop(&svc);
+    puts("shm_clients passed!");
+}
+
+void test_shm_process() {
+    Aes_shm_service svc;
+    char name[64];
+    start_service(&svc, name, 1);
+
+    // The client is another process that only knows the region's name
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        Shm_client_job job = { name, 9 };
+        client_thread(&job);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    aes_shm_service_stop(&svc);
+    puts("shm_process passed!");
+}
+
+void test_all_aes_shm() {
+    test_shm_modes();
+    test_shm_rejects();
+    test_shm_slot_reuse();
+    test_shm_clients();
+    test_shm_process();
+    puts("All aes_shm tests passed!");
+}
@@ -0,0 +1,115 @@
+#include "../../include/aes_stream_test.h"
+
+static uint8_t stream_key[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+};
+
+static uint8_t stream_iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+/*
+ * Feed in through a stream in pieces of pseudo-random size (0 to 40 bytes)
+ * and return the total output length, or -1 if final fails.
+ */
+static int64_t run_stream(Aes_stream* s, uint8_t* in, uint64_t len, uint8_t* out, unsigned seed) {
+    uint64_t pos = 0;
+    int64_t written = 0;
+    while (pos < len) {
+        seed = seed * 1103515245 + 12345;
+        uint64_t n = (seed >> 16) % 41;
+        if (n > len - pos)
+            n = len - pos;
+        written += aes_stream_update(s, in + pos, n, out + written);
+        pos += n;
+    }
+    int64_t last = aes_stream_final(s, out + written);
+    return last < 0 ? -1 : written + last;
+}
+
+/*
+ * Compare a fragmented stream against the whole-buffer mode function,
+ * then decrypt it in different fragments.
+ */
+static void check_stream(Op_mode op_mode, uint64_t len, bool padded) {
+    uint8_t ekey[240], iv[16];
+    uint8_t* plain = malloc(len + 16);
+    uint8_t* expected = malloc(len + 16);
+    uint8_t* enc = malloc(len + 64);
+    uint8_t* dec = malloc(len + 64);
+    expand_key(stream_key, 32, ekey);
+
+    for (uint64_t i = 0; i < len; i++)
+        plain[i] = (uint8_t)(i * 5 + 1);
+
+    memcpy(expected, plain, len);
+    uint64_t len_expected = padded ? pad_vector(expected, len) : len;
+    memcpy(iv, stream_iv, 16);
+    aes_mode(op_mode, expected, len_expected, ekey, 32, iv, true);
+
+    Aes_stream s;
+    aes_stream_init(&s, op_mode, ekey, 32, stream_iv, true, padded);
+    assert(run_stream(&s, plain, len, enc, (unsigned)len) == (int64_t)len_expected);
+    assert(!memcmp(enc, expected, len_expected));
+
+    aes_stream_init(&s, op_mode, ekey, 32, stream_iv, false, padded);
+    assert(run_stream(&s, enc, len_expected, dec, (unsigned)len + 99) == (int64_t)len);
+    assert(!memcmp(dec, plain, len));
+
+    free(plain);
+    free(expected);
+    free(enc);
+    free(dec);
+}
+
+void test_stream_fragments() {
+    Op_mode modes[5] = {ECB, CBC, CFB, OFB, CTR};
+    uint64_t lens[5] = {0, 15, 16, 48, 1001};
+    for (int m = 0; m < 5; m++)
+        for (int l = 0; l < 5; l++)
+            check_stream(modes[m], lens[l], true);
+    puts("stream_fragments passed!");
+}
+
+void test_stream_unpadded() {
+    Op_mode stream_modes[5] = {CFB, OFB, CTR, CFB8, CFB1};
+    for (int m = 0; m < 5; m++) {
+        check_stream(stream_modes[m], 1001, false);
+        check_stream(stream_modes[m], 7, false);
+    }
+    check_stream(ECB, 1024, false);
+    check_stream(CBC, 1024, false);
+    puts("stream_unpadded passed!");
+}
+
+void test_stream_errors() {
+    uint8_t ekey[240], buf[64] = {0}, out[80];
+    expand_key(stream_key, 32, ekey);
+    Aes_stream s;
+
+    // Unpadded block modes need whole blocks
+    aes_stream_init(&s, CBC, ekey, 32, stream_iv, true, false);
+    aes_stream_update(&s, buf, 20, out);
+    assert(aes_stream_final(&s, out) == -1);
+
+    // Padded ciphertext must be whole blocks with valid padding
+    aes_stream_init(&s, CBC, ekey, 32, stream_iv, false, true);
+    aes_stream_update(&s, buf, 20, out);
+    assert(aes_stream_final(&s, out) == -1);
+
+    aes_stream_init(&s, ECB, ekey, 32, NULL, true, false);
+    assert(aes_stream_update(&s, buf, 32, out) == 32);
+    aes_stream_init(&s, ECB, ekey, 32, NULL, false, true);
+    assert(aes_stream_update(&s, out, 32, buf) == 16);
+    assert(aes_stream_final(&s, buf) == -1);
+
+    puts("stream_errors passed!");
+}
+
+void test_all_aes_stream() {
+    test_stream_fragments();
+    test_stream_unpadded();
+    test_stream_errors();
+    puts("All aes_stream tests passed!");
+}
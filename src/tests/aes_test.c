@@ -162,11 +162,13 @@ void test_aes() {
     // AES-128    
 
     uint8_t* key  = malloc(sizeof(uint8_t) * (32 + 1));
+    uint8_t* ekey = malloc(sizeof(uint8_t) * (240 + 1));
 
     char* key_file = "test_keys/key0";
     char* vector_file = "test_vectors/vector0";
 
     int len_key = read_key(key_file, key);
+    expand_key(key, len_key, ekey);
 
     uint8_t *state = malloc(sizeof(uint8_t) * 16);
     uint8_t *vector = malloc(sizeof(uint8_t) * 16);
@@ -177,7 +179,7 @@ void test_aes() {
         vector[i] = state[i];
 
 
-    aes(state, key, len_key, true);
+    aes(state, ekey, len_key, true);
 
     assert(state[0] == 0xC7);
     assert(state[1] == 0xD1);
@@ -199,7 +201,7 @@ void test_aes() {
     assert(state[14] == 0x31);
     assert(state[15] == 0x72);
 
-    aes(state, key, len_key, false);
+    aes(state, ekey, len_key, false);
 
     for (int i = 0; i < 16; i++)
         assert(state[i] == vector[i]);
@@ -210,6 +212,7 @@ void test_aes() {
     char* vector_file1 = "test_vectors/vector192";
 
     len_key = read_key(key_file1, key);
+    expand_key(key, len_key, ekey);
  
     read_key(vector_file1, state);
 
@@ -219,12 +222,12 @@ void test_aes() {
     for (int i = 0; i < 16; i++)
         vector[i] = state[i];
 
-    aes(state, key, len_key, true);
+    aes(state, ekey, len_key, true);
     
     for (int i = 0; i < 16; i++)
         assert(state[i] == enc[i]);
 
-    aes(state, key, len_key, false);
+    aes(state, ekey, len_key, false);
    
     for (int i = 0; i < 16; i++)
         assert(state[i] == vector[i]);
@@ -235,6 +238,7 @@ void test_aes() {
     char* vector_file2 = "test_vectors/vector256";
 
     len_key = read_key(key_file2, key);
+    expand_key(key, len_key, ekey);
  
     read_key(vector_file2, state);
 
@@ -243,17 +247,18 @@ void test_aes() {
     for (int i = 0; i < 16; i++)
         vector[i] = state[i];
 
-    aes(state, key, len_key, true);
+    aes(state, ekey, len_key, true);
     
     for (int i = 0; i < 16; i++)
         assert(state[i] == enc[i]);
 
-    aes(state, key, len_key, false);
+    aes(state, ekey, len_key, false);
    
     for (int i = 0; i < 16; i++)
         assert(state[i] == vector[i]);
 
     free(key);
+    free(ekey);
     free(state);
     free(vector);
     free(enc);
@@ -0,0 +1,127 @@
+#include "../../include/aes_tune_test.h"
+
+#include <unistd.h>
+
+void test_interleave_widths() {
+    // Every width gives the same result, only the grouping differs
+    uint8_t key[16] = {0}, ekey[176];
+    uint8_t expected[13*16], data[13*16];
+    expand_key(key, 16, ekey);
+    for (int i = 0; i < 13*16; i++)
+        expected[i] = (uint8_t)(i * 5);
+    aes_blocks(expected, 13, ekey, 16, true);
+
+    int widths[4] = { 1, 4, 8, 6 };
+    int applied[4] = { 1, 4, 8, 4 };
+    for (int w = 0; w < 4; w++) {
+        aes_set_interleave(widths[w]);
+        assert(aes_get_interleave() == applied[w]);
+        for (int i = 0; i < 13*16; i++)
+            data[i] = (uint8_t)(i * 5);
+        aes_blocks(data, 13, ekey, 16, true);
+        assert(!memcmp(data, expected, 13*16));
+    }
+    aes_set_interleave(AES_INTERLEAVE_MAX);
+
+    puts("interleave_widths passed!");
+}
+
+static void write_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    assert(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+void test_profile_round_trip() {
+    char path[] = "/tmp/aes-profile-test-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    Aes_profile saved, loaded;
+    aes_profile_defaults(&saved);
+    saved.io.backend = IO_THREADS;
+    saved.io.chunk_size = 4 << 20;
+    saved.io.queue_depth = 16;
+    saved.io.num_threads = 3;
+    saved.interleave = 4;
+    assert(aes_profile_save(path, &saved) == 0);
+
+    aes_profile_defaults(&loaded);
+    assert(aes_profile_load(path, &loaded) == 0);
+    assert(loaded.io.backend == IO_THREADS);
+    assert(loaded.io.chunk_size == 4 << 20);
+    assert(loaded.io.queue_depth == 16);
+    assert(loaded.io.num_threads == 3);
+    assert(loaded.interleave == 4);
+    assert(loaded.io.numa);
+
+    // Keys left out keep their current value, unknown keys are skipped
+    write_file(path, "# partial\n\nchunk = 65536\nfuture=1\n");
+    aes_profile_defaults(&loaded);
+    assert(aes_profile_load(path, &loaded) == 0);
+    assert(loaded.io.chunk_size == 65536);
+    assert(loaded.io.backend == IO_AUTO);
+    assert(loaded.interleave == AES_INTERLEAVE_MAX);
+
+    unlink(path);
+    assert(aes_profile_load(path, &loaded) == 1);
+
+    // The default path is per host under the config directory
+    char default_path[4096];
+    setenv("XDG_CONFIG_HOME", "/tmp/aes-config", 1);
+    assert(aes_profile_default_path(default_path, sizeof(default_path)) == 0);
+    assert(!strncmp(default_path, "/tmp/aes-config/aes/", 20));
+    assert(strstr(default_path, ".profile"));
+    unsetenv("XDG_CONFIG_HOME");
+
+    puts("profile_round_trip passed!");
+}
+
+void test_profile_errors() {
+    char path[] = "/tmp/aes-profile-test-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    const char* bad[6] = { "backend=fast\n", "chunk=8\n", "chunk=4294967296\n", "interleave=3\n",
+            "threads=-2\n", "no equals sign\n" };
+    for (int b = 0; b < 6; b++) {
+        Aes_profile profile;
+        aes_profile_defaults(&profile);
+        write_file(path, bad[b]);
+        assert(aes_profile_load(path, &profile) == -1);
+
+        // A bad profile changes nothing
+        assert(profile.io.backend == IO_AUTO && profile.io.chunk_size == AES_IO_DEFAULT_CHUNK);
+    }
+
+    // A profile that cannot be opened for a reason other than not existing
+    Aes_profile profile;
+    aes_profile_defaults(&profile);
+    assert(aes_profile_load("/dev/null/aes.profile", &profile) == -1);
+
+    unlink(path);
+    puts("profile_errors passed!");
+}
+
+void test_autotune() {
+    Aes_profile profile;
+    assert(aes_autotune(&profile, 256 << 10, false) == 0);
+    assert(profile.interleave == 1 || profile.interleave == 4 || profile.interleave == 8);
+    assert(aes_get_interleave() == profile.interleave);
+    assert(profile.io.backend != IO_AUTO);
+    assert(profile.io.chunk_size >= 16);
+    aes_set_interleave(AES_INTERLEAVE_MAX);
+
+    puts("autotune passed!");
+}
+
+void test_all_aes_tune() {
+    test_interleave_widths();
+    test_profile_round_trip();
+    test_profile_errors();
+    test_autotune();
+    puts("All aes_tune tests passed!");
+}
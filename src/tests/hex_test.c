@@ -0,0 +1,107 @@
+#include "../../include/hex_test.h"
+
+void test_hex_digit_value() {
+    assert(hex_digit_value('0') == 0x0);
+    assert(hex_digit_value('9') == 0x9);
+    assert(hex_digit_value('a') == 0xA);
+    assert(hex_digit_value('F') == 0xF);
+    assert(hex_digit_value('g') == 0xFF);
+    assert(hex_digit_value(' ') == 0xFF);
+    puts("hex_digit_value passed!");
+}
+
+void test_hex_decode() {
+    uint8_t out[64];
+
+    assert(hex_decode("", 0, out) == 0);
+
+    char* s = "00 01\n0a0B\tfF";
+    assert(hex_decode(s, strlen(s), out) == 5);
+    assert(out[0] == 0x00 && out[1] == 0x01 && out[2] == 0x0A);
+    assert(out[3] == 0x0B && out[4] == 0xFF);
+
+    // 64 digits with no whitespace take the vector path, with a trailing space the scalar one
+    char* run = "000102030405060708090a0b0c0d0e0f101112131415161718191A1B1C1D1E1F ";
+    assert(hex_decode(run, 64, out) == 32);
+    for (int i = 0; i < 32; i++)
+        assert(out[i] == i);
+    assert(hex_decode(run, 65, out) == 32);
+
+    puts("hex_decode passed!");
+}
+
+void test_hex_decode_errors() {
+    uint8_t out[64];
+    Hex_decoder d;
+
+    assert(hex_decode("abc", 3, out) == HEX_ERR_ODD);
+    assert(hex_decode("0g", 2, out) == HEX_ERR_CHAR);
+
+    // Invalid character inside an otherwise valid 32-digit run
+    char* run = "0001020304050607080900x0b0c0d0e0f";
+    hex_decoder_init(&d);
+    assert(hex_decode_update(&d, run, strlen(run), out) == HEX_ERR_CHAR);
+    assert(d.position == 22);
+    assert(d.bad_char == 'x');
+
+    puts("hex_decode_errors passed!");
+}
+
+void test_hex_decode_stream() {
+    // Random hex with whitespace sprinkled in, decoded whole and then split at every position
+    uint64_t len = 4000;
+    char* text = malloc(len);
+    uint8_t* whole = malloc(len);
+    uint8_t* split = malloc(len);
+    char* digits = "0123456789abcdefABCDEF";
+    unsigned seed = 7;
+    for (uint64_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        text[i] = (seed >> 16) % 61 == 0 ? '\n' : digits[(seed >> 16) % 22];
+    }
+
+    Hex_decoder d;
+    hex_decoder_init(&d);
+    int64_t n = hex_decode_update(&d, text, len, whole);
+    assert(n > 0);
+
+    for (uint64_t cut = 0; cut < 200; cut++) {
+        hex_decoder_init(&d);
+        int64_t a = hex_decode_update(&d, text, cut, split);
+        int64_t b = hex_decode_update(&d, text + cut, len - cut, split + a);
+        assert(a + b == n);
+        assert(!memcmp(whole, split, n));
+    }
+
+    free(text);
+    free(whole);
+    free(split);
+    puts("hex_decode_stream passed!");
+}
+
+void test_hex_read_file() {
+    uint64_t size;
+    int err;
+
+    uint8_t* v = hex_read_file("test_vectors/vector0", &size, &err);
+    assert(v && size == 16);
+    assert(v[0] == 0x00 && v[5] == 0x03 && v[15] == 0x7f);
+    free(v);
+
+    assert(!hex_read_file("test_vectors/vector0bin", &size, &err));
+    assert(err == HEX_ERR_CHAR);
+
+    assert(!hex_read_file("test_vectors/does_not_exist", &size, &err));
+    assert(err == HEX_ERR_IO);
+
+    puts("hex_read_file passed!");
+}
+
+void test_all_hex() {
+    test_hex_digit_value();
+    test_hex_decode();
+    test_hex_decode_errors();
+    test_hex_decode_stream();
+    test_hex_read_file();
+    puts("All hex tests passed!");
+}
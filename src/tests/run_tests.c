@@ -1,8 +1,46 @@
 #include "../../include/aes_test.h"
 #include "../../include/expand_key_test.h"
+#include "../../include/aes_modes_test.h"
+#include "../../include/aes_io_test.h"
+#include "../../include/hex_test.h"
+#include "../../include/aes_mac_test.h"
+#include "../../include/aes_keywrap_test.h"
+#include "../../include/aes_stream_test.h"
+#include "../../include/aes_numa_test.h"
+#include "../../include/aes_keystream_test.h"
+#include "../../include/aes_multibuf_test.h"
+#include "../../include/aes_metrics_test.h"
+#include "../../include/aes_keystore_test.h"
+#include "../../include/aes_fpe_test.h"
+#include "../../include/aes_tune_test.h"
+#include "../../include/aes_hash_test.h"
+#include "../../include/aes_drbg_test.h"
+#include "../../include/aes_shm_test.h"
+#include "../../include/aes_delta_test.h"
+#include "../../include/aes_isa_test.h"
+#include "../../include/aes_cpp_test.h"
 
 int main() {
+    test_all_hex();
     test_all_expand_key();
     test_all_aes();
+    test_all_aes_modes();
+    test_all_aes_io();
+    test_all_aes_mac();
+    test_all_aes_keywrap();
+    test_all_aes_stream();
+    test_all_aes_numa();
+    test_all_aes_keystream();
+    test_all_aes_multibuf();
+    test_all_aes_metrics();
+    test_all_aes_keystore();
+    test_all_aes_fpe();
+    test_all_aes_tune();
+    test_all_aes_hash();
+    test_all_aes_drbg();
+    test_all_aes_shm();
+    test_all_aes_delta();
+    test_all_aes_isa();
+    test_all_aes_cpp();
     return 0;
 }